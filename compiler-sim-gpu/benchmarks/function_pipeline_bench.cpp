@@ -0,0 +1,92 @@
+// Measures the pass pipeline on a transformer-like module whose layers are
+// separate functions, across thread counts, to show how function-local
+// passes scale.
+//
+// Usage: function-pipeline-bench [functions] [layers per function] [repetitions]
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <thread>
+#include "compiler_sim/IRNode.h"
+#include "compiler_sim/IRModule.h"
+#include "compiler_sim/PassManager.h"
+
+using namespace compiler_sim;
+
+using Clock = std::chrono::steady_clock;
+
+// Each function is an attention-style block: q/k/v projections with bias,
+// a score matmul and an output projection, repeated `layers` times
+static void buildFunctions(IRModule& module, int numFunctions, int layers) {
+    for (int f = 0; f < numFunctions; f++) {
+        IRModule& function = module.addFunction("block" + std::to_string(f));
+        IRNode* prev = createTensor(function, "input", {128, 512});
+        function.append(prev);
+        for (int i = 0; i < layers; i++) {
+            std::string suffix = std::to_string(i);
+            IRNode* projections[3];
+            for (int p = 0; p < 3; p++) {
+                std::string name = std::string(1, "qkv"[p]) + suffix;
+                IRNode* weight = createTensor(function, "w_" + name, {512, 512});
+                IRNode* bias = createTensor(function, "b_" + name, {512});
+                IRNode* matmul = createMatmul(function, "mm_" + name, prev, weight);
+                IRNode* add = function.createNode(OpType::ADD, name);
+                add->addInput(matmul).addInput(bias);
+                function.append(weight);
+                function.append(bias);
+                function.append(matmul);
+                function.append(add);
+                projections[p] = add;
+            }
+            IRNode* scores = createMatmul(function, "scores" + suffix,
+                                          projections[0], projections[1]);
+            IRNode* out = createMatmul(function, "out" + suffix, scores, projections[2]);
+            function.append(scores);
+            function.append(out);
+            prev = out;
+        }
+    }
+}
+
+static double runPipeline(int numFunctions, int layers, size_t numThreads) {
+    IRModule module;
+    buildFunctions(module, numFunctions, layers);
+
+    PassManager pm;
+    pm.setNumThreads(numThreads);
+    pm.addPass(createLoopUnrollingPass(4));
+    pm.addPass(createTensorFusionPass());
+    pm.addPass(createMemoryMapPass());
+
+    auto start = Clock::now();
+    pm.runPasses(module);
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    int numFunctions = argc > 1 ? std::stoi(argv[1]) : 48;
+    int layers = argc > 2 ? std::stoi(argv[2]) : 500;
+    int reps = argc > 3 ? std::stoi(argv[3]) : 3;
+
+    size_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << "Function pipeline benchmark: " << numFunctions << " functions x "
+              << layers << " layers (" << (numFunctions * (14 * layers + 1))
+              << " nodes), best of " << reps << "\n\n";
+    std::cout << std::fixed << std::setprecision(2);
+
+    double serial = 0;
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        double best = 1e30;
+        for (int r = 0; r < reps; r++) {
+            best = std::min(best, runPipeline(numFunctions, layers, threads));
+        }
+        if (threads == 1) {
+            serial = best;
+        }
+        std::cout << std::setw(3) << threads << " threads: " << std::setw(10) << best
+                  << " ms  (" << std::setprecision(2) << serial / best << "x)\n";
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,224 @@
+// Compares the arena-backed IRModule against the previous shared_ptr graph
+// representation on a synthetic layer stack (matmul + bias add per layer).
+//
+// Usage: ir-storage-bench [layers] [repetitions]
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "compiler_sim/IRNode.h"
+#include "compiler_sim/IRModule.h"
+#include "compiler_sim/PassManager.h"
+
+using namespace compiler_sim;
+
+namespace legacy {
+
+// Layout of IRNode before arena storage: refcounted edges, one heap
+// allocation per node.
+struct Node {
+    Node(OpType type, const std::string& name) : type(type), name(name) {}
+
+    OpType type;
+    std::string name;
+    std::vector<std::shared_ptr<Node>> inputs;
+    std::vector<std::shared_ptr<Node>> outputs;
+    std::unordered_map<std::string, AttributeValue> attributes;
+    int debug_line = -1;
+    int debug_col = -1;
+};
+
+std::shared_ptr<Node> createTensor(const std::string& name,
+                                   const std::vector<int>& shape) {
+    auto node = std::make_shared<Node>(OpType::ALLOC, name);
+    node->attributes["shape"] = shape;
+    node->attributes["dtype"] = std::string("f32");
+    int size = 1;
+    for (int dim : shape) size *= dim;
+    node->attributes["size"] = size;
+    return node;
+}
+
+} // namespace legacy
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+struct Timings {
+    double buildMs = 0;
+    double walkMs = 0;
+    double destroyMs = 0;
+};
+
+static Timings benchLegacy(int layers, size_t& checksum) {
+    Timings t;
+    auto start = Clock::now();
+
+    auto nodes = std::make_unique<std::vector<std::shared_ptr<legacy::Node>>>();
+    auto prev = legacy::createTensor("input", {512, 768});
+    nodes->push_back(prev);
+    for (int i = 0; i < layers; i++) {
+        std::string suffix = std::to_string(i);
+        auto weight = legacy::createTensor("w" + suffix, {768, 768});
+        auto bias = legacy::createTensor("b" + suffix, {768});
+        auto matmul = std::make_shared<legacy::Node>(OpType::MATMUL, "mm" + suffix);
+        matmul->inputs.push_back(prev);
+        matmul->inputs.push_back(weight);
+        auto add = std::make_shared<legacy::Node>(OpType::ADD, "add" + suffix);
+        add->inputs.push_back(matmul);
+        add->inputs.push_back(bias);
+        nodes->push_back(weight);
+        nodes->push_back(bias);
+        nodes->push_back(matmul);
+        nodes->push_back(add);
+        prev = add;
+    }
+    prev.reset();
+    t.buildMs = elapsedMs(start);
+
+    start = Clock::now();
+    for (const auto& node : *nodes) {
+        for (const auto& input : node->inputs) {
+            checksum += static_cast<size_t>(input->type) + input->inputs.size();
+        }
+    }
+    t.walkMs = elapsedMs(start);
+
+    // Release consumers before producers; dropping the vector front-to-back
+    // would free the whole chain recursively from the last node.
+    start = Clock::now();
+    while (!nodes->empty()) {
+        nodes->pop_back();
+    }
+    t.destroyMs = elapsedMs(start);
+    return t;
+}
+
+static Timings benchArena(int layers, size_t& checksum) {
+    Timings t;
+    auto start = Clock::now();
+
+    auto module = std::make_unique<IRModule>();
+    IRNode* prev = createTensor(*module, "input", {512, 768});
+    module->append(prev);
+    for (int i = 0; i < layers; i++) {
+        std::string suffix = std::to_string(i);
+        IRNode* weight = createTensor(*module, "w" + suffix, {768, 768});
+        IRNode* bias = createTensor(*module, "b" + suffix, {768});
+        IRNode* matmul = createMatmul(*module, "mm" + suffix, prev, weight);
+        IRNode* add = module->createNode(OpType::ADD, "add" + suffix);
+        add->addInput(matmul).addInput(bias);
+        module->append(weight);
+        module->append(bias);
+        module->append(matmul);
+        module->append(add);
+        prev = add;
+    }
+    t.buildMs = elapsedMs(start);
+
+    start = Clock::now();
+    for (ValueId id : module->getBody()) {
+        for (ValueId input : module->getNode(id)->getInputs()) {
+            const IRNode* producer = module->getNode(input);
+            checksum += static_cast<size_t>(producer->getType()) +
+                        producer->getInputs().size();
+        }
+    }
+    t.walkMs = elapsedMs(start);
+
+    start = Clock::now();
+    module.reset();
+    t.destroyMs = elapsedMs(start);
+    return t;
+}
+
+static double benchArenaPipeline(int layers) {
+    IRModule module;
+    IRNode* prev = createTensor(module, "input", {512, 768});
+    module.append(prev);
+    for (int i = 0; i < layers; i++) {
+        std::string suffix = std::to_string(i);
+        IRNode* weight = createTensor(module, "w" + suffix, {768, 768});
+        IRNode* bias = createTensor(module, "b" + suffix, {768});
+        IRNode* matmul = createMatmul(module, "mm" + suffix, prev, weight);
+        IRNode* add = module.createNode(OpType::ADD, "add" + suffix);
+        add->addInput(matmul).addInput(bias);
+        module.append(weight);
+        module.append(bias);
+        module.append(matmul);
+        module.append(add);
+        prev = add;
+    }
+
+    PassManager pm;
+    pm.addPass(createLoopUnrollingPass(4));
+    pm.addPass(createTensorFusionPass());
+    // The stack outgrows any real device; only pass time matters here
+    DeviceInfo device;
+    device.globalMemoryBytes = std::numeric_limits<uint64_t>::max();
+    pm.addPass(createMemoryMapPass(device));
+
+    auto start = Clock::now();
+    pm.runPasses(module);
+    return elapsedMs(start);
+}
+
+static void printRow(const std::string& label, const Timings& t) {
+    std::cout << std::left << std::setw(12) << label << std::right
+              << std::fixed << std::setprecision(2)
+              << std::setw(12) << t.buildMs
+              << std::setw(12) << t.walkMs
+              << std::setw(12) << t.destroyMs
+              << std::setw(12) << (t.buildMs + t.walkMs + t.destroyMs) << "\n";
+}
+
+int main(int argc, char* argv[]) {
+    int layers = argc > 1 ? std::stoi(argv[1]) : 100000;
+    int reps = argc > 2 ? std::stoi(argv[2]) : 3;
+
+    std::cout << "IR storage benchmark: " << layers << " layers ("
+              << (4 * layers + 1) << " nodes), best of " << reps << "\n\n";
+
+    Timings bestLegacy{1e30, 1e30, 1e30};
+    Timings bestArena{1e30, 1e30, 1e30};
+    size_t legacySum = 0;
+    size_t arenaSum = 0;
+
+    for (int r = 0; r < reps; r++) {
+        legacySum = 0;
+        arenaSum = 0;
+        Timings l = benchLegacy(layers, legacySum);
+        Timings a = benchArena(layers, arenaSum);
+        bestLegacy = {std::min(bestLegacy.buildMs, l.buildMs),
+                      std::min(bestLegacy.walkMs, l.walkMs),
+                      std::min(bestLegacy.destroyMs, l.destroyMs)};
+        bestArena = {std::min(bestArena.buildMs, a.buildMs),
+                     std::min(bestArena.walkMs, a.walkMs),
+                     std::min(bestArena.destroyMs, a.destroyMs)};
+    }
+
+    if (legacySum != arenaSum) {
+        std::cerr << "Checksum mismatch: " << legacySum << " vs " << arenaSum << "\n";
+        return 1;
+    }
+
+    std::cout << std::left << std::setw(12) << "(ms)" << std::right
+              << std::setw(12) << "build"
+              << std::setw(12) << "walk"
+              << std::setw(12) << "destroy"
+              << std::setw(12) << "total" << "\n";
+    printRow("shared_ptr", bestLegacy);
+    printRow("arena", bestArena);
+
+    std::cout << "\nArena pass pipeline: " << std::fixed << std::setprecision(2)
+              << benchArenaPipeline(layers) << " ms\n";
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+// Measures the pass pipeline with per-pass IR capture disabled and enabled,
+// to keep the cost of tracing visible as the IR printer changes, and with
+// cost-checked checkpoints (snapshot + rollback check) around every pass.
+//
+// Usage: pipeline-trace-bench [layers] [repetitions]
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <limits>
+#include <string>
+#include "compiler_sim/IRNode.h"
+#include "compiler_sim/IRModule.h"
+#include "compiler_sim/PassManager.h"
+#include "compiler_sim/CostModel.h"
+
+using namespace compiler_sim;
+
+using Clock = std::chrono::steady_clock;
+
+static void buildLayerStack(IRModule& module, int layers) {
+    IRNode* prev = createTensor(module, "input", {512, 768});
+    module.append(prev);
+    for (int i = 0; i < layers; i++) {
+        std::string suffix = std::to_string(i);
+        IRNode* weight = createTensor(module, "w" + suffix, {768, 768});
+        IRNode* bias = createTensor(module, "b" + suffix, {768});
+        IRNode* matmul = createMatmul(module, "mm" + suffix, prev, weight);
+        IRNode* add = module.createNode(OpType::ADD, "add" + suffix);
+        add->addInput(matmul).addInput(bias);
+        module.append(weight);
+        module.append(bias);
+        module.append(matmul);
+        module.append(add);
+        prev = add;
+    }
+}
+
+static double runPipeline(int layers, bool captureIR, bool checkpoint = false) {
+    IRModule module;
+    buildLayerStack(module, layers);
+
+    PassManager pm;
+    pm.setCaptureIR(captureIR);
+    if (checkpoint) {
+        pm.setCostModel([](const IRModule& m) { return estimateModuleCost(m); });
+    }
+    pm.addPass(createLoopUnrollingPass(4));
+    pm.addPass(createTensorFusionPass());
+    // The stack outgrows any real device; only pass time matters here
+    DeviceInfo device;
+    device.globalMemoryBytes = std::numeric_limits<uint64_t>::max();
+    pm.addPass(createMemoryMapPass(device));
+
+    auto start = Clock::now();
+    pm.runPasses(module);
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    int layers = argc > 1 ? std::stoi(argv[1]) : 100000;
+    int reps = argc > 2 ? std::stoi(argv[2]) : 3;
+
+    double bestOff = 1e30;
+    double bestOn = 1e30;
+    double bestCheckpoint = 1e30;
+    for (int r = 0; r < reps; r++) {
+        bestOff = std::min(bestOff, runPipeline(layers, false));
+        bestOn = std::min(bestOn, runPipeline(layers, true));
+        bestCheckpoint = std::min(bestCheckpoint, runPipeline(layers, false, true));
+    }
+
+    std::cout << "Pipeline benchmark: " << layers << " layers ("
+              << (4 * layers + 1) << " nodes), best of " << reps << "\n\n";
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "IR capture off: " << std::setw(10) << bestOff << " ms\n";
+    std::cout << "IR capture on:  " << std::setw(10) << bestOn << " ms\n";
+    std::cout << "Checkpointing:  " << std::setw(10) << bestCheckpoint << " ms\n";
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace compiler_sim {
+
+struct AllocationStats {
+    // Totals since counting was first enabled
+    uint64_t bytesAllocated = 0;
+    uint64_t numAllocations = 0;
+    // Live heap relative to when counting was first enabled; frees of
+    // older blocks can make it negative
+    int64_t liveBytes = 0;
+    // Highest liveBytes since the last resetPeak
+    int64_t peakLiveBytes = 0;
+};
+
+// Process-wide heap accounting through the replaceable global operator new
+// and operator delete. Counting is off until enabled, and while off each
+// allocation costs one extra relaxed atomic load. Enabling nests, so
+// several profilers can share the counters.
+class AllocationCounter {
+public:
+    static void enable();
+    static void disable();
+    static bool isEnabled();
+    
+    static AllocationStats getStats();
+    // Restarts peak tracking from the current live heap
+    static void resetPeak();
+};
+
+} // namespace compiler_sim
\ No newline at end of file
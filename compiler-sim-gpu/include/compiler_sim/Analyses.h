@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "IRNode.h"
+#include "CostModel.h"
+
+namespace compiler_sim {
+
+class IRModule;
+class AnalysisManager;
+
+// Standard analyses for AnalysisManager. All results are indexed by
+// ValueId and describe a single module; a module's functions are analyzed
+// separately.
+
+// Where each value is defined and used, as positions in the module body.
+// Nodes nested in a region take the position of the top-level op that
+// holds them.
+struct DefUseAnalysis {
+    static constexpr uint32_t kNotInBody = std::numeric_limits<uint32_t>::max();
+
+    struct Result {
+        struct Positions {
+            const uint32_t* first;
+            const uint32_t* last;
+            const uint32_t* begin() const { return first; }
+            const uint32_t* end() const { return last; }
+            size_t size() const { return static_cast<size_t>(last - first); }
+            bool empty() const { return first == last; }
+        };
+
+        uint32_t getPosition(ValueId id) const { return position[id]; }
+        // Sorted and deduplicated
+        Positions getUsePositions(ValueId id) const {
+            return {uses.data() + useOffsets[id], uses.data() + useOffsets[id + 1]};
+        }
+        size_t getNumPositions() const { return numPositions; }
+
+        std::vector<uint32_t> position;    // kNotInBody for unreachable nodes
+        std::vector<uint32_t> useOffsets;  // into uses, one past the last ValueId
+        std::vector<uint32_t> uses;
+        size_t numPositions = 0;
+    };
+
+    static const char* name() { return "DefUse"; }
+    Result run(IRModule& module, AnalysisManager& analyses);
+};
+
+// Live range of each value over body positions: from its definition (or
+// first use, if used earlier) to its last use, inclusive.
+struct LivenessAnalysis {
+    struct Interval {
+        uint32_t start = DefUseAnalysis::kNotInBody;
+        uint32_t end = DefUseAnalysis::kNotInBody;
+    };
+
+    struct Result {
+        const Interval& getInterval(ValueId id) const { return intervals[id]; }
+        bool isLiveAt(ValueId id, uint32_t position) const {
+            const Interval& interval = intervals[id];
+            return interval.start != DefUseAnalysis::kNotInBody &&
+                   interval.start <= position && position <= interval.end;
+        }
+        // A value with no uses inside the module
+        bool isDead(ValueId id) const { return deadAfterDef[id]; }
+
+        std::vector<Interval> intervals;
+        std::vector<bool> deadAfterDef;
+    };
+
+    static const char* name() { return "Liveness"; }
+    Result run(IRModule& module, AnalysisManager& analyses);
+};
+
+// Element counts and byte sizes of every typed value
+struct ShapeInfoAnalysis {
+    struct Result {
+        const TensorType* getType(ValueId id) const { return types[id]; }
+        uint64_t getNumElements(ValueId id) const {
+            return types[id] ? types[id]->getNumElements() : 0;
+        }
+        uint64_t getByteSize(ValueId id) const {
+            return types[id] ? types[id]->getByteSize() : 0;
+        }
+        // Sum over typed values in the body
+        uint64_t getTotalBytes() const { return totalBytes; }
+
+        std::vector<const TensorType*> types;  // null for erased or untyped nodes
+        uint64_t totalBytes = 0;
+    };
+
+    static const char* name() { return "ShapeInfo"; }
+    Result run(IRModule& module, AnalysisManager& analyses);
+};
+
+// estimateNodeCost for every node, with default parameters. The total
+// covers this module's body only, not its functions.
+struct CostAnalysis {
+    struct Result {
+        double getNodeCost(ValueId id) const { return nodeCosts[id]; }
+        double getTotal() const { return total; }
+
+        std::vector<double> nodeCosts;
+        double total = 0.0;
+    };
+
+    static const char* name() { return "Cost"; }
+    Result run(IRModule& module, AnalysisManager& analyses);
+};
+
+} // namespace compiler_sim
\ No newline at end of file
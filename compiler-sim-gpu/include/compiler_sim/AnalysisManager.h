@@ -0,0 +1,147 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace compiler_sim {
+
+class IRModule;
+
+// Identifies an analysis type: the address of a per-type static
+using AnalysisKey = const void*;
+
+template<typename AnalysisT>
+AnalysisKey getAnalysisKey() {
+    static const char id = 0;
+    return &id;
+}
+
+// The analyses a pass left valid. A pass returns all() when it did not
+// change the IR, none() when it may have changed anything, and none()
+// followed by preserve<A>() for analyses it kept up to date itself.
+class PreservedAnalyses {
+public:
+    static PreservedAnalyses all() {
+        PreservedAnalyses preserved;
+        preserved.all_ = true;
+        return preserved;
+    }
+    static PreservedAnalyses none() { return PreservedAnalyses(); }
+
+    template<typename AnalysisT>
+    PreservedAnalyses& preserve() { return preserve(getAnalysisKey<AnalysisT>()); }
+    PreservedAnalyses& preserve(AnalysisKey key);
+
+    template<typename AnalysisT>
+    bool isPreserved() const { return isPreserved(getAnalysisKey<AnalysisT>()); }
+    bool isPreserved(AnalysisKey key) const;
+    bool areAllPreserved() const { return all_; }
+
+private:
+    bool all_ = false;
+    std::vector<AnalysisKey> preserved_;
+};
+
+struct AnalysisStats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t invalidations = 0;
+};
+
+// Computes analyses on demand and caches them per module (each function
+// is cached separately). An analysis is a default-constructible class with
+//
+//     using Result = ...;
+//     static const char* name();
+//     Result run(IRModule& module, AnalysisManager& analyses);
+//
+// and may request other analyses from within run(). Results stay cached
+// until invalidate() is called for their module with a set that does not
+// preserve them. Passes running on different functions may query the
+// manager concurrently.
+class AnalysisManager {
+public:
+    AnalysisManager() = default;
+    AnalysisManager(const AnalysisManager&) = delete;
+    AnalysisManager& operator=(const AnalysisManager&) = delete;
+
+    template<typename AnalysisT>
+    const typename AnalysisT::Result& getResult(IRModule& module);
+
+    // Null unless the result is cached; does not count as a hit or miss
+    template<typename AnalysisT>
+    const typename AnalysisT::Result* getCachedResult(const IRModule& module) const;
+
+    // Drops the results for `module` that `preserved` does not cover
+    void invalidate(const IRModule& module, const PreservedAnalyses& preserved);
+    // Drops every cached result; counters are kept
+    void clear();
+    // Zeroes the counters
+    void resetStats();
+
+    // Counters by analysis name, summed over all modules
+    std::map<std::string, AnalysisStats> getStats() const;
+    size_t getNumHits() const;
+    size_t getNumMisses() const;
+
+private:
+    struct ResultConcept {
+        virtual ~ResultConcept() = default;
+    };
+
+    template<typename ResultT>
+    struct ResultModel : ResultConcept {
+        explicit ResultModel(ResultT&& value) : result(std::move(value)) {}
+        ResultT result;
+    };
+
+    struct CachedResult {
+        std::unique_ptr<ResultConcept> result;
+        const char* name;
+    };
+
+    using ModuleResults = std::unordered_map<AnalysisKey, CachedResult>;
+
+    // Both return the cached result, or null after counting a miss
+    const ResultConcept* lookup(const IRModule& module, AnalysisKey key, const char* name);
+    const ResultConcept* insert(const IRModule& module, AnalysisKey key, const char* name,
+                                std::unique_ptr<ResultConcept> result);
+
+    mutable std::mutex mutex_;
+    std::unordered_map<const IRModule*, ModuleResults> results_;
+    std::map<std::string, AnalysisStats> stats_;
+};
+
+template<typename AnalysisT>
+const typename AnalysisT::Result& AnalysisManager::getResult(IRModule& module) {
+    using ResultT = typename AnalysisT::Result;
+    const AnalysisKey key = getAnalysisKey<AnalysisT>();
+    const ResultConcept* cached = lookup(module, key, AnalysisT::name());
+    if (!cached) {
+        // Computed without the lock held, so the analysis can request others
+        auto computed = std::make_unique<ResultModel<ResultT>>(AnalysisT().run(module, *this));
+        cached = insert(module, key, AnalysisT::name(), std::move(computed));
+    }
+    return static_cast<const ResultModel<ResultT>*>(cached)->result;
+}
+
+template<typename AnalysisT>
+const typename AnalysisT::Result* AnalysisManager::getCachedResult(const IRModule& module) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto moduleIt = results_.find(&module);
+    if (moduleIt == results_.end()) {
+        return nullptr;
+    }
+    auto it = moduleIt->second.find(getAnalysisKey<AnalysisT>());
+    if (it == moduleIt->second.end()) {
+        return nullptr;
+    }
+    using ResultT = typename AnalysisT::Result;
+    return &static_cast<const ResultModel<ResultT>*>(it->second.result.get())->result;
+}
+
+} // namespace compiler_sim
\ No newline at end of file
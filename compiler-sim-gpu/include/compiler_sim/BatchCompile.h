@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace compiler_sim {
+
+// Inputs of a batch: the .dsl files of a directory in name order, or the
+// paths listed one per line in a file, skipping blank and '#' lines.
+// Throws if `source` is neither.
+std::vector<std::string> collectBatchInputs(const std::string& source);
+
+// Trace file names from input stems; repeated stems get their input's
+// position appended so no trace overwrites another
+std::vector<std::string> batchTraceNames(const std::vector<std::string>& inputs);
+
+// Nearest-rank percentile `p` (0-100) of ascending `sorted`; 0 if empty
+double nearestRankPercentile(const std::vector<double>& sorted, double p);
+
+} // namespace compiler_sim
\ No newline at end of file
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "DeviceInfo.h"
+
+namespace compiler_sim {
+
+// On-disk cache of pass results. An entry is keyed by a hash of the pass
+// name, its options and the bytecode of the IR entering it, and holds the
+// bytecode of the IR the pass produced along with what it recorded in the
+// trace. The pass manager keys each function separately, so editing one
+// layer of a model only misses for that layer.
+//
+// Entries are files named by their key. They are written to a temporary
+// file and renamed into place, so compilers sharing a directory never read
+// a partial entry. Unreadable entries count as misses.
+class CompileCache {
+public:
+    struct MemoryMapping {
+        std::string tensor;
+        uint64_t offset;
+        uint64_t size;
+        MemorySpace space;
+    };
+
+    struct Entry {
+        std::vector<char> bytecode;
+        std::vector<std::string> transformations;
+        std::vector<MemoryMapping> memoryMappings;
+        // Counters the pass itself recorded
+        std::vector<std::pair<std::string, uint64_t>> counters;
+        // Time the pass took when the entry was made
+        double passTimeMs = 0.0;
+    };
+
+    // Creates the directory if needed
+    explicit CompileCache(std::string directory);
+
+    const std::string& getDirectory() const { return directory_; }
+
+    static uint64_t fingerprint(std::string_view passName, std::string_view options,
+                                const std::vector<char>& bytecode);
+
+    bool lookup(uint64_t key, Entry& entry) const;
+    // False if the entry could not be written; compilation goes on without it
+    bool store(uint64_t key, const Entry& entry) const;
+
+private:
+    std::string pathFor(uint64_t key) const;
+
+    std::string directory_;
+};
+
+} // namespace compiler_sim
\ No newline at end of file
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <json/json.h>
+
+namespace compiler_sim {
+
+// Wire format shared by CompileServer and sendCompileRequest: each message
+// is a JSON object sent as a 4-byte little-endian length and that many
+// bytes of compact JSON. A client sends a request and reads reply messages
+// until one has "type": "done". Connections may carry several requests in
+// turn.
+namespace wire {
+
+// False when the peer has closed the connection; throws on malformed
+// messages or socket errors
+bool readMessage(int fd, Json::Value& message);
+void writeMessage(int fd, const Json::Value& message);
+
+} // namespace wire
+
+// Serves compile requests over a Unix domain socket, one connection per
+// pool thread, so at most numThreads requests run at once and later
+// connections wait their turn.
+class CompileServer {
+public:
+    using Reply = std::function<void(const Json::Value&)>;
+    // Runs on a pool thread once per request. Each call to `reply` streams
+    // one message to the client; "done" is sent after the handler returns,
+    // preceded by {"type": "error", "message": ...} if it threw.
+    using Handler = std::function<void(const Json::Value& request, const Reply& reply)>;
+
+    // 0 threads means one per hardware thread
+    CompileServer(std::string socketPath, size_t numThreads, Handler handler);
+    ~CompileServer();
+
+    CompileServer(const CompileServer&) = delete;
+    CompileServer& operator=(const CompileServer&) = delete;
+
+    // Binds and listens, replacing a stale socket file at the path
+    void listen();
+    // Accepts connections until stop(), then waits for open ones to finish
+    // their current request and removes the socket file
+    void serve();
+    // Safe to call from any thread and from signal handlers
+    void stop();
+
+    const std::string& getSocketPath() const { return socketPath_; }
+
+private:
+    void handleConnection(int fd);
+
+    std::string socketPath_;
+    size_t numThreads_;
+    Handler handler_;
+    int listenFd_ = -1;
+    // stop() writes to wakeFds_[1] to interrupt the accept loop
+    int wakeFds_[2] = {-1, -1};
+    std::atomic<bool> stopping_{false};
+    // Open connections, shut down on stop so idle clients don't hold the
+    // server open
+    std::mutex connectionsMutex_;
+    std::unordered_set<int> connections_;
+};
+
+// Sends one request to the server at `socketPath` and calls `onReply` for
+// each message it streams back, up to and excluding "done"
+void sendCompileRequest(const std::string& socketPath, const Json::Value& request,
+                        const std::function<void(const Json::Value&)>& onReply);
+
+} // namespace compiler_sim
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "IRNode.h"
+
+namespace compiler_sim {
+
+class IRModule;
+
+// Throughput and latency figures of the simulated device, in cycles
+struct CostModelParams {
+    double flopsPerCycle = 1024.0;
+    double bytesPerCycle = 64.0;
+    double launchCycles = 2000.0;
+    // Wait for a dependent global load; a tiled kernel pays it per K step
+    double memoryLatencyCycles = 400.0;
+    // Result latency of an arithmetic op, and branch and counter update of
+    // one loop iteration
+    double aluLatencyCycles = 4.0;
+    double loopOverheadCycles = 4.0;
+};
+
+// Deterministic roofline estimate in simulated cycles. Each compute node is
+// one kernel: launch overhead plus the larger of its compute and memory time.
+// A module's cost includes its functions.
+double estimateNodeCost(const IRNode& node, const CostModelParams& params = {});
+double estimateModuleCost(const IRModule& module, const CostModelParams& params = {});
+
+// Estimate for `consumer` computing `producer` inline rather than reading
+// its result: one launch, the producer's inputs read instead of its result,
+// and its work repeated per element when the consumer broadcasts it
+double estimateFusedCost(const IRNode& producer, const IRNode& consumer,
+                         const CostModelParams& params = {});
+// Global memory traffic removed by fusing `producer` into its consumer: its
+// result is no longer written out and read back
+uint64_t fusionSavedBytes(const IRNode& producer);
+
+} // namespace compiler_sim
\ No newline at end of file
@@ -1,15 +1,20 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <unordered_map>
 #include <memory>
 #include <fstream>
+#include <map>
 #include <json/json.h> // Assuming we use jsoncpp
+#include "AnalysisManager.h"
+#include "DeviceInfo.h"
 
 namespace compiler_sim {
 
-class IRNode;
+class IRModule;
 
 struct DebugLocation {
     int line;
@@ -25,12 +30,39 @@ struct SymbolInfo {
     DebugLocation location;
 };
 
+// Where a tensor or kernel buffer lives. Shared offsets are per block and
+// register offsets per thread.
+struct MemoryRegion {
+    size_t offset = 0;
+    size_t size = 0;
+    MemorySpace space = MemorySpace::GLOBAL;
+};
+
 struct PassTrace {
     std::string passName;
     std::string irBefore;
     std::string irAfter;
     std::vector<std::string> transformations;
     double executionTimeMs;
+    // Analysis cache lookups made while the pass ran
+    size_t analysisHits = 0;
+    size_t analysisMisses = 0;
+    // Compile cache lookups, one per module or function the pass ran on
+    size_t cacheHits = 0;
+    size_t cacheMisses = 0;
+    double cacheTimeSavedMs = 0.0;
+    // Named counters added by instrumentation, e.g. "cycles", or by the pass
+    // itself, in the order they were recorded
+    std::vector<std::pair<std::string, uint64_t>> counters;
+};
+
+// What the current pass has recorded so far, taken by
+// DebugInfo::checkpoint() before a pass that may be rolled back
+struct TraceCheckpoint {
+    size_t transformations = 0;
+    std::vector<std::pair<std::string, uint64_t>> counters;
+    std::unordered_map<std::string, MemoryRegion> memoryMap;
+    std::unordered_map<std::string, SymbolInfo> symbolTable;
 };
 
 class DebugInfo {
@@ -43,17 +75,54 @@ public:
     
     // Pass tracing
     void beginPass(const std::string& passName);
+    void endPass();
     void endPass(const std::string& irAfter);
     void recordTransformation(const std::string& description);
+    // Appends the last pass traced by `function` to the current pass, with
+    // transformations prefixed "@scope: " and memory-map and symbol keys
+    // prefixed "scope/". An empty scope adds no prefix.
+    void mergePassTrace(const DebugInfo& function, const std::string& scope);
+    const std::vector<PassTrace>& getPassTraces() const { return passTraces_; }
+    
+    // Drops the transformations, counters, memory mappings and symbols
+    // recorded since `checkpoint` was taken
+    TraceCheckpoint checkpoint() const;
+    void restore(const TraceCheckpoint& checkpoint);
+    
+    // Per-pass IR capture is off by default; printing the whole module after
+    // every pass costs more than most passes. Enable it only when the trace
+    // will actually be read.
+    void setIRCaptureEnabled(bool enabled) { captureIR_ = enabled; }
+    bool isIRCaptureEnabled() const { return captureIR_; }
+    void recordPassIR(const std::string& irAfter);
+    
+    // Analysis cache counters, per pass and per analysis
+    void recordAnalysisCounts(size_t hits, size_t misses);
+    void recordAnalysisStats(std::map<std::string, AnalysisStats> stats);
+    
+    // Compile cache outcomes for the current pass
+    void recordCacheHit(double timeSavedMs);
+    void recordCacheMiss();
+    
+    // Attaches a counter to the last traced pass, overwriting one with the
+    // same name
+    void recordPassCounter(const std::string& name, uint64_t value);
+    // Adds to a counter of the current pass; merged traces add up too
+    void addPassCounter(const std::string& name, uint64_t value);
     
     // Memory mapping
     void recordMemoryMapping(const std::string& tensor, 
                            size_t offset, 
-                           size_t size);
+                           size_t size,
+                           MemorySpace space = MemorySpace::GLOBAL);
+    
+    const std::unordered_map<std::string, MemoryRegion>& getMemoryMap() const {
+        return memoryMap_;
+    }
     
     // IR evolution tracking
     void recordIRSnapshot(const std::string& stage, 
-                         const std::vector<std::shared_ptr<IRNode>>& nodes);
+                         const IRModule& module);
     
     // Export debug trace
     void exportTrace(const std::string& filename) const;
@@ -64,10 +133,12 @@ private:
     std::vector<PassTrace> passTraces_;
     PassTrace* currentPass_ = nullptr;
     
-    std::unordered_map<std::string, std::pair<size_t, size_t>> memoryMap_;
+    std::unordered_map<std::string, MemoryRegion> memoryMap_;
     std::vector<std::pair<std::string, std::string>> irSnapshots_;
+    std::map<std::string, AnalysisStats> analysisStats_;
     
     std::chrono::steady_clock::time_point passStartTime_;
+    bool captureIR_ = false;
 };
 
 } // namespace compiler_sim
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace compiler_sim {
+
+enum class MemorySpace {
+    GLOBAL,
+    SHARED,
+    REGISTER
+};
+
+// "global", "shared" or "registers", as used in attributes and traces
+const char* getMemorySpaceName(MemorySpace space);
+
+// Resources of the simulated device that memory planning and kernel
+// configuration must fit in
+struct DeviceInfo {
+    std::string name = "mock-gpu";
+    uint64_t globalMemoryBytes = 8ull << 30;
+    uint32_t sharedMemoryPerBlock = 48 * 1024;
+    uint32_t sharedMemoryPerSM = 100 * 1024;
+    uint32_t registersPerSM = 65536;
+    uint32_t maxRegistersPerThread = 255;
+    uint32_t maxThreadsPerBlock = 1024;
+    uint32_t maxThreadsPerSM = 2048;
+    uint32_t maxBlocksPerSM = 32;
+    uint32_t warpSize = 32;
+    uint32_t numSMs = 80;
+
+    // Every field, for cache keys and pass options
+    std::string describe() const;
+};
+
+// Resident blocks per SM for one kernel configuration and what limits it:
+// "threads", "blocks", "shared" or "registers". Zero blocks means the
+// kernel cannot launch at all.
+struct Occupancy {
+    uint32_t blocksPerSM = 0;
+    // Resident warps over the most the SM can hold
+    double occupancy = 0.0;
+    const char* limiter = "";
+};
+
+Occupancy computeOccupancy(const DeviceInfo& device, uint32_t threadsPerBlock,
+                           uint32_t sharedBytesPerBlock, uint32_t registersPerThread);
+
+} // namespace compiler_sim
\ No newline at end of file
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "IRNode.h"
+
+namespace compiler_sim {
+
+class IRModule;
+
+// On-disk layout of the binary IR format. All integers are little-endian
+// and every section starts at an 8-byte aligned offset, so a mapped file
+// can be read in place through these records.
+namespace bc {
+
+constexpr char kMagic[4] = {'C', 'S', 'B', 'C'};
+constexpr uint32_t kVersion = 3;
+constexpr uint32_t kNone = 0xFFFFFFFFu;
+
+struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t numStrings;
+    uint32_t numTypes;
+    uint32_t numDims;
+    uint32_t numNodes;
+    uint32_t numOperands;
+    uint32_t numAttributes;
+    uint32_t numInts;
+    uint32_t numBody;
+    uint32_t numFunctions;
+    uint32_t reserved;
+    uint64_t stringOffsetsOffset;  // uint32_t[numStrings + 1]
+    uint64_t stringDataOffset;
+    uint64_t typesOffset;          // TypeRecord[numTypes]
+    uint64_t dimsOffset;           // int64_t[numDims]
+    uint64_t nodesOffset;          // NodeRecord[numNodes]
+    uint64_t operandsOffset;       // uint32_t[numOperands], node indices
+    uint64_t attributesOffset;     // AttributeRecord[numAttributes]
+    uint64_t intsOffset;           // int32_t[numInts], vector<int> payloads
+    uint64_t bodyOffset;           // uint32_t[numBody], node indices
+    uint64_t functionsOffset;      // FunctionRecord[numFunctions]
+    uint64_t fileSize;
+};
+
+struct TypeRecord {
+    uint32_t dtype;
+    uint32_t layout;
+    uint32_t dimsBegin;
+    uint32_t rank;
+};
+
+struct NodeRecord {
+    uint32_t opType;
+    uint32_t name;        // string id
+    uint32_t type;        // type index or kNone
+    int32_t debugLine;
+    int32_t debugCol;
+    uint32_t inputsBegin;
+    uint32_t numInputs;
+    uint32_t outputsBegin;
+    uint32_t numOutputs;
+    uint32_t attrsBegin;
+    uint32_t numAttrs;
+    uint32_t regionBegin;  // into the operands section
+    uint32_t numRegion;
+    uint32_t reserved;
+};
+
+// A contiguous range of nodes and body entries. Record 0 is the top-level
+// module; the rest are its functions, whose nodes may only reference nodes
+// in their own range.
+struct FunctionRecord {
+    uint32_t name;        // string id, kNone for the top level
+    uint32_t nodesBegin;
+    uint32_t numNodes;
+    uint32_t bodyBegin;
+    uint32_t numBody;
+    uint32_t reserved;
+};
+
+// Matches the alternative order of AttributeValue
+enum class AttrKind : uint32_t {
+    INT,
+    INT64,
+    FLOAT,
+    STRING,
+    INT_VECTOR
+};
+
+struct AttributeRecord {
+    uint32_t key;         // string id
+    AttrKind kind;
+    uint64_t payload;     // value, float bits, string id, or (begin << 32 | count)
+};
+
+} // namespace bc
+
+struct BytecodeWriteOptions {
+    bool includeFunctions = true;
+    // Order each node's attributes by name rather than by AttrKey, so equal
+    // IR gives equal bytes whatever order keys were interned in. Loading
+    // into a fresh context then interns keys in name order.
+    bool canonicalAttributeOrder = false;
+};
+
+// Serializes the live nodes of a module and its functions. Node ids are
+// renumbered densely; use lists are rebuilt on load rather than stored.
+std::vector<char> writeBytecode(const IRModule& module, const BytecodeWriteOptions& options = {});
+void writeBytecodeFile(const IRModule& module, const std::string& path);
+
+template<typename T>
+struct ArrayView {
+    const T* data = nullptr;
+    size_t size = 0;
+
+    const T* begin() const { return data; }
+    const T* end() const { return data + size; }
+    const T& operator[](size_t index) const { return data[index]; }
+};
+
+// Read-only view over a serialized module. Opening a file maps it into
+// memory and checks the header and section bounds; individual records are
+// only touched when accessed.
+class BytecodeReader {
+public:
+    explicit BytecodeReader(const std::string& path);
+    // Views a caller-owned buffer, which must outlive the reader
+    BytecodeReader(const void* data, size_t size);
+    ~BytecodeReader();
+
+    BytecodeReader(const BytecodeReader&) = delete;
+    BytecodeReader& operator=(const BytecodeReader&) = delete;
+
+    const bc::Header& getHeader() const { return *header_; }
+    uint32_t getVersion() const { return header_->version; }
+
+    uint32_t getNumStrings() const { return header_->numStrings; }
+    std::string_view getString(uint32_t id) const;
+
+    uint32_t getNumTypes() const { return header_->numTypes; }
+    const bc::TypeRecord& getTypeRecord(uint32_t index) const { return types_[index]; }
+    ArrayView<int64_t> getTypeDims(const bc::TypeRecord& type) const;
+
+    uint32_t getNumNodes() const { return header_->numNodes; }
+    const bc::NodeRecord& getNodeRecord(uint32_t index) const { return nodes_[index]; }
+    ArrayView<uint32_t> getInputs(const bc::NodeRecord& node) const;
+    ArrayView<uint32_t> getOutputs(const bc::NodeRecord& node) const;
+    ArrayView<uint32_t> getRegion(const bc::NodeRecord& node) const;
+    ArrayView<bc::AttributeRecord> getAttributes(const bc::NodeRecord& node) const;
+    ArrayView<int32_t> getInts(const bc::AttributeRecord& attr) const;
+
+    ArrayView<uint32_t> getBody() const { return {body_, header_->numBody}; }
+    ArrayView<uint32_t> getBody(const bc::FunctionRecord& function) const;
+
+    uint32_t getNumFunctions() const { return header_->numFunctions; }
+    const bc::FunctionRecord& getFunctionRecord(uint32_t index) const { return functions_[index]; }
+
+private:
+    void validate(size_t size);
+
+    const char* base_ = nullptr;
+    size_t mappedSize_ = 0;
+    bool mapped_ = false;
+
+    const bc::Header* header_ = nullptr;
+    const uint32_t* stringOffsets_ = nullptr;
+    const char* stringData_ = nullptr;
+    const bc::TypeRecord* types_ = nullptr;
+    const int64_t* dims_ = nullptr;
+    const bc::NodeRecord* nodes_ = nullptr;
+    const uint32_t* operands_ = nullptr;
+    const bc::AttributeRecord* attributes_ = nullptr;
+    const int32_t* ints_ = nullptr;
+    const uint32_t* body_ = nullptr;
+    const bc::FunctionRecord* functions_ = nullptr;
+};
+
+// Materializes a serialized module into `module`, appending its body and
+// adding its functions
+void readModule(const BytecodeReader& reader, IRModule& module);
+
+} // namespace compiler_sim
\ No newline at end of file
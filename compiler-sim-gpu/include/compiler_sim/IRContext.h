@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "TensorType.h"
+
+namespace compiler_sim {
+
+// Maps strings to dense 32-bit ids. Interned strings are stored once (the
+// hash table keys are views into them) and never move, so references
+// returned by str() stay valid for the lifetime of the interner.
+//
+// Thread-safe: intern() and lookup() synchronize on the table, while str()
+// takes no lock. Strings live in chunks of doubling size behind a fixed
+// directory, so appending never moves anything a reader might touch.
+class StringInterner {
+public:
+    static constexpr uint32_t kNotFound = std::numeric_limits<uint32_t>::max();
+
+    StringInterner() = default;
+    StringInterner(const StringInterner&) = delete;
+    StringInterner& operator=(const StringInterner&) = delete;
+
+    uint32_t intern(std::string_view str);
+    uint32_t lookup(std::string_view str) const;
+    const std::string& str(uint32_t id) const {
+        uint32_t chunk, offset;
+        locate(id, chunk, offset);
+        return chunks_[chunk][offset];
+    }
+    size_t size() const { return size_.load(std::memory_order_acquire); }
+
+private:
+    // Chunk k holds (1 << kFirstChunkShift) << k strings
+    static constexpr uint32_t kFirstChunkShift = 6;
+    static constexpr uint32_t kNumChunks = 32;
+
+    static void locate(uint32_t id, uint32_t& chunk, uint32_t& offset) {
+        uint64_t biased = uint64_t(id) + (uint64_t(1) << kFirstChunkShift);
+        uint32_t msb = 63 - static_cast<uint32_t>(__builtin_clzll(biased));
+        chunk = msb - kFirstChunkShift;
+        offset = static_cast<uint32_t>(biased - (uint64_t(1) << msb));
+    }
+
+    std::unique_ptr<std::string[]> chunks_[kNumChunks];
+    std::atomic<uint32_t> size_{0};
+    mutable std::shared_mutex mutex_;
+    std::unordered_map<std::string_view, uint32_t> ids_;
+};
+
+using AttrKey = uint32_t;
+constexpr AttrKey kInvalidAttrKey = StringInterner::kNotFound;
+
+// Interned node name. Names need not be unique; printers disambiguate.
+using NameId = uint32_t;
+constexpr NameId kInvalidNameId = StringInterner::kNotFound;
+
+// Uniquing tables shared by every module compiled against it. A context
+// must outlive all modules that reference it. All methods are safe to call
+// from several threads, so functions of one module can be compiled in
+// parallel.
+class IRContext {
+public:
+    IRContext() = default;
+
+    IRContext(const IRContext&) = delete;
+    IRContext& operator=(const IRContext&) = delete;
+
+    // Attribute names
+    AttrKey getAttrKey(const std::string& name) { return attributeNames_.intern(name); }
+    AttrKey lookupAttrKey(const std::string& name) const { return attributeNames_.lookup(name); }
+    const std::string& getAttrName(AttrKey key) const { return attributeNames_.str(key); }
+
+    // Node names
+    NameId getIdentifier(std::string_view name) { return identifiers_.intern(name); }
+    NameId lookupIdentifier(std::string_view name) const { return identifiers_.lookup(name); }
+    const std::string& getIdentifierName(NameId id) const { return identifiers_.str(id); }
+    size_t getNumIdentifiers() const { return identifiers_.size(); }
+
+    // Tensor types; the returned pointer is unique per (shape, dtype, layout)
+    const TensorType* getTensorType(const std::vector<int64_t>& shape,
+                                    DataType dtype,
+                                    Layout layout = Layout::ROW_MAJOR);
+    size_t getNumTensorTypes() const;
+
+private:
+    struct TensorTypeKey {
+        std::vector<int64_t> shape;
+        DataType dtype;
+        Layout layout;
+
+        bool operator==(const TensorTypeKey& other) const {
+            return dtype == other.dtype && layout == other.layout && shape == other.shape;
+        }
+    };
+
+    struct TensorTypeKeyHash {
+        size_t operator()(const TensorTypeKey& key) const;
+    };
+
+    StringInterner attributeNames_;
+    StringInterner identifiers_;
+    // Node-based map, so TensorType addresses are stable across rehashing
+    mutable std::shared_mutex tensorTypesMutex_;
+    std::unordered_map<TensorTypeKey, TensorType, TensorTypeKeyHash> tensorTypes_;
+};
+
+} // namespace compiler_sim
\ No newline at end of file
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include "IRContext.h"
+#include "IRNode.h"
+
+namespace compiler_sim {
+
+class IRModule;
+
+// Checkpoint of a module taken by IRModule::snapshot(). Taking one costs a
+// bit per existing node; node state is copied lazily, the first time each
+// node is modified afterwards, and nodes created afterwards are simply
+// dropped on rollback. Destroying the snapshot without restoring it keeps
+// the current state.
+class ModuleSnapshot {
+public:
+    ~ModuleSnapshot();
+
+    ModuleSnapshot(const ModuleSnapshot&) = delete;
+    ModuleSnapshot& operator=(const ModuleSnapshot&) = delete;
+
+    bool isActive() const { return module_ != nullptr; }
+    // Nodes copied so far
+    size_t getNumSavedNodes() const { return savedNodes_.size(); }
+
+private:
+    friend class IRModule;
+    friend class IRNode;
+
+    ModuleSnapshot(IRModule& module, uint32_t numNodes, size_t numErased);
+
+    void save(const IRNode& node) {
+        ValueId id = node.getId();
+        if (id < numNodes_ && !saved_[id]) {
+            saved_[id] = true;
+            savedNodes_.push_back(node);
+        }
+    }
+    void saveBody(const std::vector<ValueId>& body) {
+        if (!bodySaved_) {
+            body_ = body;
+            bodySaved_ = true;
+        }
+    }
+
+    IRModule* module_;
+    uint32_t numNodes_;
+    size_t numErased_;
+    std::vector<bool> saved_;
+    std::deque<IRNode> savedNodes_;
+    bool bodySaved_ = false;
+    std::vector<ValueId> body_;
+};
+
+// Assigns printable names on first request: a node's interned name, or
+// name_N for the N-th later node sharing it. Suffixes that collide with an
+// existing identifier are skipped. Only repeated names allocate.
+class ValueNamer {
+public:
+    explicit ValueNamer(const IRModule& module);
+
+    void appendName(std::string& out, const IRNode* node);
+
+private:
+    static constexpr uint32_t kUnassigned = 0xFFFFFFFFu;
+
+    const IRModule& module_;
+    // Per ValueId: kUnassigned, 0 for the plain name, or the suffix
+    std::vector<uint32_t> suffix_;
+    // Per NameId: 0 while unclaimed, else the next suffix to try
+    std::vector<uint32_t> nextSuffix_;
+};
+
+// Owns every IRNode of a compilation unit. Nodes are placement-constructed
+// into fixed-size slabs, so they stay contiguous in memory, never move once
+// created, and are all released together when the module is destroyed.
+// A ValueId encodes (slab index, slot) directly, making lookup two shifts
+// and a load.
+class IRModule {
+public:
+    // Creates a module with its own private context
+    IRModule();
+    // Creates a module sharing interned data with others built on `context`
+    explicit IRModule(IRContext& context);
+    ~IRModule();
+
+    IRModule(const IRModule&) = delete;
+    IRModule& operator=(const IRModule&) = delete;
+
+    IRContext& getContext() const { return *context_; }
+
+    // Node allocation. Passes deriving many nodes from one should reuse its
+    // NameId rather than build new strings; printing keeps names distinct.
+    IRNode* createNode(OpType type, NameId name);
+    IRNode* createNode(OpType type, std::string_view name) {
+        return createNode(type, context_->getIdentifier(name));
+    }
+
+    IRNode* getNode(ValueId id) const {
+        return slotAt(id);
+    }
+    size_t getNumNodes() const { return numNodes_; }
+
+    // Program order of top-level operations
+    void append(const IRNode* node) { getBody().push_back(node->getId()); }
+    std::vector<ValueId>& getBody() {
+        if (snapshot_) snapshot_->saveBody(body_);
+        return body_;
+    }
+    const std::vector<ValueId>& getBody() const { return body_; }
+
+    // Drops erased nodes from the body. Erasing is O(uses) and only marks
+    // the node, so passes can erase freely and compact once at the end.
+    void compact();
+    size_t getNumErased() const { return numErased_; }
+
+    // Destroys every node and empties the body; functions are kept. Not
+    // allowed while a snapshot is active.
+    void clear();
+
+    // Functions (kernels) of this module. Each function is itself an
+    // IRModule with its own nodes and body, sharing this module's context;
+    // values never cross function boundaries, so functions can be compiled
+    // independently and in parallel.
+    IRModule& addFunction(std::string_view name);
+    const std::vector<std::unique_ptr<IRModule>>& getFunctions() const { return functions_; }
+    IRModule* getFunction(std::string_view name) const;
+    // kInvalidNameId for a top-level module
+    NameId getFunctionName() const { return functionName_; }
+    IRModule* getParent() const { return parent_; }
+
+    // Pretty printing of the body, one node per line, followed by each
+    // function. Repeated names are printed with a _1, _2, ... suffix.
+    void print(std::string& out) const;
+    std::string toString() const;
+
+    // Deep-clones the body into `dest`, appending the clones in order
+    void cloneInto(IRModule& dest, IRMapping& mapping) const;
+
+    // Checkpointing. At most one snapshot is active per module; restore()
+    // rolls the module back to it and deactivates it. Pointers to nodes
+    // created after the snapshot dangle once it is restored.
+    std::unique_ptr<ModuleSnapshot> snapshot();
+    void restore(ModuleSnapshot& snapshot);
+
+    static constexpr uint32_t kSlabShift = 8;
+    static constexpr uint32_t kSlabSize = 1u << kSlabShift;
+
+private:
+    friend class IRNode;
+    friend class ModuleSnapshot;
+
+    struct Slab {
+        alignas(IRNode) unsigned char storage[kSlabSize * sizeof(IRNode)];
+    };
+
+    void printBody(std::string& out, int indent) const;
+
+    IRNode* slotAt(ValueId id) const {
+        auto* base = slabs_[id >> kSlabShift]->storage;
+        return reinterpret_cast<IRNode*>(base) + (id & (kSlabSize - 1));
+    }
+
+    std::unique_ptr<IRContext> ownedContext_;
+    IRContext* context_;
+    std::vector<std::unique_ptr<Slab>> slabs_;
+    uint32_t numNodes_ = 0;
+    std::vector<ValueId> body_;
+    IRModule* parent_ = nullptr;
+    NameId functionName_ = kInvalidNameId;
+    std::vector<std::unique_ptr<IRModule>> functions_;
+    // Erased nodes that may still be listed in body_
+    size_t numErased_ = 0;
+    ModuleSnapshot* snapshot_ = nullptr;
+};
+
+} // namespace compiler_sim
\ No newline at end of file
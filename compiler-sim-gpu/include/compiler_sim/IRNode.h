@@ -3,11 +3,19 @@
 #include <string>
 #include <vector>
 #include <memory>
-#include <unordered_map>
 #include <variant>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include "IRContext.h"
+#include "SmallVector.h"
 
 namespace compiler_sim {
 
+class IRModule;
+class ValueNamer;
+
 enum class OpType {
     MATMUL,
     ADD,
@@ -16,67 +24,239 @@ enum class OpType {
     STORE,
     ALLOC,
     LOOP,
-    BLOCK
+    BLOCK,
+    TRANSPOSE,   // permutes dimensions by `perm`; default swaps the last two
+    SCALE,       // multiplies a tensor by a scalar operand
+    SOFTMAX,     // along the last dimension
+    CONSTANT,    // scalar `value`
+    CAST         // converts its operand to the result's element type
 };
 
-using AttributeValue = std::variant<int, float, std::string, std::vector<int>>;
+// Number of OpType values; keep in sync with the last enumerator
+constexpr size_t kNumOpTypes = static_cast<size_t>(OpType::CAST) + 1;
+
+const char* opTypeName(OpType type);
+
+using AttributeValue = std::variant<int, int64_t, float, std::string, std::vector<int>>;
+
+struct Attribute {
+    AttrKey key;
+    AttributeValue value;
+};
+
+// Attributes are kept sorted by interned key; most nodes carry only a few,
+// which then live inline in the node.
+using AttributeList = SmallVector<Attribute, 2>;
+
+// Compact handle for a node within its owning IRModule. Operands refer to
+// their producers by ValueId rather than by pointer.
+using ValueId = uint32_t;
+constexpr ValueId kInvalidValueId = std::numeric_limits<ValueId>::max();
+
+// One entry per use; a node reading the same value twice appears twice.
+using UserList = SmallVector<ValueId, 2>;
+
+// Maps values of a source graph to their counterparts in a clone
+class IRMapping {
+public:
+    void map(ValueId from, ValueId to) { map_[from] = to; }
+    bool contains(ValueId from) const { return map_.count(from) != 0; }
+
+    // kInvalidValueId if `from` has not been mapped
+    ValueId lookup(ValueId from) const {
+        auto it = map_.find(from);
+        return it != map_.end() ? it->second : kInvalidValueId;
+    }
+    // `from` itself if it has not been mapped
+    ValueId lookupOrDefault(ValueId from) const {
+        auto it = map_.find(from);
+        return it != map_.end() ? it->second : from;
+    }
+
+    size_t size() const { return map_.size(); }
+    void clear() { map_.clear(); }
+
+private:
+    std::unordered_map<ValueId, ValueId> map_;
+};
 
 class IRNode {
 public:
-    IRNode(OpType type, const std::string& name);
-    
+    // Nodes are allocated by IRModule::createNode; see IRModule.h
+    IRNode(IRModule& module, ValueId id, OpType type, NameId name);
+
     // Builder pattern for node construction
-    IRNode& addInput(std::shared_ptr<IRNode> input);
-    IRNode& addOutput(std::shared_ptr<IRNode> output);
+    IRNode& addInput(ValueId input);
+    IRNode& addInput(const IRNode* input) { return addInput(input->getId()); }
+    IRNode& addOutput(ValueId output);
+    IRNode& addOutput(const IRNode* output) { return addOutput(output->getId()); }
+    IRNode& setInput(size_t index, ValueId input);
     IRNode& setAttribute(const std::string& key, AttributeValue value);
-    
+    IRNode& setAttribute(AttrKey key, AttributeValue value);
+
     // Accessors
+    ValueId getId() const { return id_; }
+    IRModule& getModule() const { return *module_; }
+    IRContext& getContext() const;
     OpType getType() const { return type_; }
-    const std::string& getName() const { return name_; }
-    const std::vector<std::shared_ptr<IRNode>>& getInputs() const { return inputs_; }
-    const std::vector<std::shared_ptr<IRNode>>& getOutputs() const { return outputs_; }
-    
+    // Interned name; not necessarily unique within the module
+    const std::string& getName() const;
+    NameId getNameId() const { return name_; }
+    const std::vector<ValueId>& getInputs() const { return inputs_; }
+    const std::vector<ValueId>& getOutputs() const { return outputs_; }
+
+    // Result type; null for nodes that produce no tensor (LOOP, BLOCK)
+    const TensorType* getTensorType() const { return tensorType_; }
+    IRNode& setTensorType(const TensorType* type);
+
+    // Nested operations of LOOP and BLOCK nodes, in program order. Region
+    // members are allocated in the module like any node but are not listed
+    // in its body.
+    const std::vector<ValueId>& getRegion() const { return region_; }
+    IRNode& appendToRegion(const IRNode* node);
+    IRNode& setRegion(std::vector<ValueId> region);
+
+    // Resolve operands through the owning module
+    IRNode* getInput(size_t index) const;
+    IRNode* getOutput(size_t index) const;
+
+    // Use-def chains. A use is an appearance of this node in another node's
+    // inputs or outputs; the builder methods above keep the lists current.
+    const UserList& getUsers() const { return users_; }
+    bool hasOneUse() const { return users_.size() == 1; }
+    bool useEmpty() const { return users_.empty(); }
+
+    // Redirects every use of this node to `replacement`, in O(uses)
+    void replaceAllUsesWith(IRNode* replacement);
+
+    // Detaches this node from its operands and removes it from the module
+    // body on the next IRModule::compact(). The node must have no uses.
+    void erase();
+    bool isErased() const { return erased_; }
+
     // Debug information
     void setDebugLocation(int line, int col);
     std::pair<int, int> getDebugLocation() const { return {debug_line_, debug_col_}; }
-    
-    // Clone for transformation passes
-    std::shared_ptr<IRNode> clone() const;
-    
-    // Pretty printing
+
+    // Clone for transformation passes (allocated in the same module).
+    // Operands are shared with the original; region members are cloned.
+    IRNode* clone() const;
+    // Same-module clone whose operands are remapped through `mapping`;
+    // records this node -> clone, and likewise for each region member, in
+    // the mapping.
+    IRNode* clone(IRMapping& mapping) const;
+    // Deep clone into `dest`, which may use a different context: clones
+    // this node and, transitively, every operand not already in `mapping`.
+    // Each value is cloned once however many paths reach it.
+    IRNode* cloneInto(IRModule& dest, IRMapping& mapping) const;
+
+    // Pretty printing. print() appends to a caller-owned buffer so repeated
+    // dumps can reuse its capacity. Without a ValueNamer, nodes print under
+    // their interned names, which may repeat.
+    void print(std::string& out, int indent = 0) const;
+    void print(std::string& out, int indent, ValueNamer& names) const;
     std::string toString(int indent = 0) const;
-    
-    // Attribute access
+
+    // Attribute access. Returned references stay valid until the node's
+    // attributes are next modified.
+    const AttributeValue* findAttribute(AttrKey key) const {
+        for (const Attribute& attr : attributes_) {
+            if (attr.key == key) return &attr.value;
+            if (attr.key > key) break;
+        }
+        return nullptr;
+    }
+
+    template<typename T>
+    const T& getAttribute(AttrKey key) const {
+        if (const AttributeValue* value = findAttribute(key)) {
+            return std::get<T>(*value);
+        }
+        throw std::runtime_error("Attribute not found: " + getContext().getAttrName(key));
+    }
+
     template<typename T>
-    T getAttribute(const std::string& key) const {
-        auto it = attributes_.find(key);
-        if (it != attributes_.end()) {
-            return std::get<T>(it->second);
+    const T& getAttribute(const std::string& key) const {
+        if (const AttributeValue* value = findAttribute(lookupAttrKey(key))) {
+            return std::get<T>(*value);
         }
         throw std::runtime_error("Attribute not found: " + key);
     }
-    
+
+    bool hasAttribute(AttrKey key) const {
+        return findAttribute(key) != nullptr;
+    }
+
     bool hasAttribute(const std::string& key) const {
-        return attributes_.find(key) != attributes_.end();
+        return findAttribute(lookupAttrKey(key)) != nullptr;
     }
 
+    const AttributeList& getAttributes() const { return attributes_; }
+
 private:
+    AttrKey lookupAttrKey(const std::string& key) const;
+    void removeUser(ValueId user);
+    // Saves this node into the module's active snapshot, if any, before
+    // its first modification
+    void willModify();
+    IRNode* cloneShell(IRModule& dest) const;
+    void printImpl(std::string& out, int indent, ValueNamer* names) const;
+
+    IRModule* module_;
+    ValueId id_;
     OpType type_;
-    std::string name_;
-    std::vector<std::shared_ptr<IRNode>> inputs_;
-    std::vector<std::shared_ptr<IRNode>> outputs_;
-    std::unordered_map<std::string, AttributeValue> attributes_;
+    NameId name_;
+    const TensorType* tensorType_ = nullptr;
+    std::vector<ValueId> inputs_;
+    std::vector<ValueId> outputs_;
+    UserList users_;
+    std::vector<ValueId> region_;
+    AttributeList attributes_;
     int debug_line_ = -1;
     int debug_col_ = -1;
+    bool erased_ = false;
 };
 
-// Helper factory functions
-std::shared_ptr<IRNode> createMatmul(const std::string& name,
-                                     std::shared_ptr<IRNode> a,
-                                     std::shared_ptr<IRNode> b);
+// Helper factory functions. Nodes are allocated in the module's arena but
+// not placed in its body; call IRModule::append to schedule them.
+IRNode* createMatmul(IRModule& module,
+                     const std::string& name,
+                     const IRNode* a,
+                     const IRNode* b);
+
+IRNode* createTensor(IRModule& module,
+                     const std::string& name,
+                     const std::vector<int64_t>& shape,
+                     const std::string& dtype = "f32");
+
+// An empty `perm` swaps the last two dimensions
+IRNode* createTranspose(IRModule& module,
+                        const std::string& name,
+                        const IRNode* input,
+                        const std::vector<int>& perm = {});
+
+IRNode* createScale(IRModule& module,
+                    const std::string& name,
+                    const IRNode* input,
+                    const IRNode* factor);
+
+IRNode* createSoftmax(IRModule& module,
+                      const std::string& name,
+                      const IRNode* input);
+
+IRNode* createConstant(IRModule& module,
+                       const std::string& name,
+                       float value,
+                       const std::string& dtype = "f32");
+
+// Same shape and layout as `input`, elements converted to `dtype`
+IRNode* createCast(IRModule& module,
+                   const std::string& name,
+                   const IRNode* input,
+                   DataType dtype);
 
-std::shared_ptr<IRNode> createTensor(const std::string& name,
-                                     const std::vector<int>& shape,
-                                     const std::string& dtype = "f32");
+// Whether the host fills or reads back the allocation `tensor`: nothing in
+// the module writes it, or nothing reads what is written to it
+bool isHostVisible(const IRNode& tensor);
 
 } // namespace compiler_sim
\ No newline at end of file
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "CostModel.h"
+#include "DeviceInfo.h"
+
+namespace compiler_sim {
+
+// Problem size of a matmul: `batch` independent [m, k] x [k, n] products.
+// An operand is transposed when its storage holds [k, m] or [n, k] rows,
+// because of a transpose_a/transpose_b flag or a col_major layout.
+struct MatmulShape {
+    int64_t batch = 1;
+    int64_t m = 0;
+    int64_t n = 0;
+    int64_t k = 0;
+    bool transposeA = false;
+    bool transposeB = false;
+    // Bytes per accumulator: the `accumulate` element type if the matmul
+    // has one, else f32 or its own element type if wider
+    uint32_t accumulatorSize = 4;
+};
+
+// Reads the shape from the operand and result types, following the
+// transpose_a/transpose_b flags and `accumulate`; false if untyped
+bool getMatmulShape(const IRNode& matmul, MatmulShape& shape);
+
+// Each block computes an m x n output tile, stepping through K k at a time
+struct MatmulTile {
+    uint32_t m = 32;
+    uint32_t n = 32;
+    uint32_t k = 32;
+};
+
+// Launch resources of a tiled matmul. Each block stages an m x k tile of A
+// and a k x n tile of B in shared memory and keeps its accumulators in
+// registers. A transposed B is staged as n rows of k, padded by one
+// element so that threads reading along n hit different banks. An
+// accumulatorSize of 0 means f32, or the element type if wider.
+struct KernelPlan {
+    MatmulTile tile;
+    uint32_t elementSize;
+    uint32_t threadsPerBlock;
+    uint32_t tileABytes;
+    uint32_t tileBBytes;
+    uint32_t tileBOffset;
+    uint32_t sharedBytes;
+    uint32_t accumulatorBytes;     // per thread
+    uint32_t registersPerThread;
+    Occupancy occupancy;
+};
+
+KernelPlan planMatmul(const MatmulTile& tile, size_t elementSize, const DeviceInfo& device,
+                      bool transposeB = false, size_t accumulatorSize = 0);
+
+// Launch configuration of a planned matmul: one block per tile_m x tile_n
+// output tile and one grid layer per batch, with block_threads laid out
+// along n first. Operands stored transposed select the kernel variant
+// (matmul_kernel_nt, _tn or _tt).
+struct MatmulLaunch {
+    std::string kernel;
+    uint32_t grid[3] = {1, 1, 1};
+    uint32_t block[3] = {1, 1, 1};
+    uint64_t sharedBytes = 0;
+};
+
+// False unless LoopTilingPass and MemoryMapPass have planned `matmul`
+bool getMatmulLaunch(const IRNode& matmul, MatmulLaunch& launch);
+
+// "kernel<<<(x, y, z), (x, y, z)>>>"
+std::string formatLaunch(const MatmulLaunch& launch);
+
+// Whether the plan is within the device's per-block limits and can launch
+bool fitsDevice(const KernelPlan& plan, const DeviceInfo& device);
+
+// Simulated cycles of the whole tiled kernel. Work is padded to whole
+// tiles, every block reads its operand tiles from global memory, and
+// blocks run in waves of numSMs x blocksPerSM; a partial last wave leaves
+// SMs idle.
+double estimateMatmulCycles(const MatmulShape& shape, const KernelPlan& plan,
+                            const DeviceInfo& device, const CostModelParams& params = {});
+
+// Tiles worth trying for `shape` that fit the device: power-of-two edges
+// up to the one covering each dimension
+std::vector<MatmulTile> candidateMatmulTiles(const MatmulShape& shape, size_t elementSize,
+                                             const DeviceInfo& device);
+
+// The candidate tile with the lowest estimate among those that fit the
+// device. Throws if none does.
+MatmulTile selectMatmulTile(const MatmulShape& shape, size_t elementSize,
+                            const DeviceInfo& device, const CostModelParams& params = {});
+
+// Simulated cycles of one warp running `loop` unrolled by `unrollFactor`,
+// while the other warps resident on its SM hide its latency. Unrolled
+// copies are independent, so they share one dependency chain's latency,
+// but each keeps its values in registers: past the device limit they
+// spill, and before that they lower occupancy.
+double estimateLoopCycles(const IRNode& loop, int unrollFactor, const DeviceInfo& device,
+                          const CostModelParams& params = {});
+
+} // namespace compiler_sim
\ No newline at end of file
@@ -3,50 +3,194 @@
 #include <memory>
 #include <vector>
 #include <functional>
+#include <set>
 #include <string>
+#include <unordered_map>
 #include "IRNode.h"
+#include "IRModule.h"
 #include "DebugInfo.h"
+#include "AnalysisManager.h"
+#include "CostModel.h"
+#include "DeviceInfo.h"
 
 namespace compiler_sim {
 
+class RewritePatternSet;
+class ThreadPool;
+class CompileCache;
+class TuningDatabase;
+
 class Pass {
 public:
     virtual ~Pass() = default;
     virtual std::string getName() const = 0;
-    virtual void run(std::vector<std::shared_ptr<IRNode>>& nodes,
-                    DebugInfo& debugInfo) = 0;
+    // Passes may erase nodes in place; the manager compacts the module body
+    // after each run. Analyses come from `analyses`; the returned set says
+    // which of them are still valid for `module` afterwards.
+    virtual PreservedAnalyses run(IRModule& module,
+                                  AnalysisManager& analyses,
+                                  DebugInfo& debugInfo) = 0;
+    // A function-local pass only looks at the module it is given, never at
+    // its parent or siblings. The manager then runs it on the top-level body
+    // and on each function separately, with functions in parallel, so run()
+    // must not modify pass state.
+    virtual bool isFunctionLocal() const { return false; }
+    // Everything besides the input IR that decides what run() does, e.g.
+    // "factor=4". Part of the compile cache key.
+    virtual std::string getOptions() const { return {}; }
+    // False for passes that read or update state outside the IR, such as
+    // a tuning database; the compile cache then always runs them
+    virtual bool isCacheable() const { return true; }
+};
+
+// Callbacks around every pass a PassManager runs, e.g. for profiling. They
+// run on the thread calling runPasses, outside the pass's timed region.
+// afterPass is called in reverse registration order once the pass has
+// finished, and its trace is the last one in `debugInfo`; it is skipped
+// if the pass throws.
+class PassInstrumentation {
+public:
+    virtual ~PassInstrumentation() = default;
+    virtual void beforePass(const Pass& /*pass*/, const IRModule& /*module*/) {}
+    virtual void afterPass(const Pass& /*pass*/, const IRModule& /*module*/,
+                           DebugInfo& /*debugInfo*/) {}
 };
 
 class PassManager {
 public:
     PassManager(bool emitIR = false, bool debug = false);
+    ~PassManager();
     
     // Pass registration
     void addPass(std::unique_ptr<Pass> pass);
     
     // Run all passes
-    void runPasses(std::vector<std::shared_ptr<IRNode>>& nodes);
+    void runPasses(IRModule& module);
+    
+    void addInstrumentation(std::unique_ptr<PassInstrumentation> instrumentation);
     
     // Debug output control
     void setEmitIR(bool emit) { emitIR_ = emit; }
     void setDebugMode(bool debug) { debug_ = debug; }
+    // Keep the printed IR after each pass in the debug trace
+    void setCaptureIR(bool capture) { debugInfo_.setIRCaptureEnabled(capture); }
+    
+    // Checkpoint the module before each pass and roll the pass back if it
+    // raises the estimate of `costModel` (e.g. estimateModuleCost). Pass an
+    // empty function to disable.
+    void setCostModel(std::function<double(const IRModule&)> costModel) {
+        costModel_ = std::move(costModel);
+    }
+    
+    // Threads used for function-local passes; 0 means one per hardware
+    // thread and 1 runs functions in order on the calling thread. The trace
+    // is the same either way.
+    void setNumThreads(size_t numThreads);
+    
+    // Reuse pass results stored under `directory` when the IR entering a
+    // pass (per function) matches an earlier run; an empty path disables
+    // the cache. Modules may then have their nodes replaced, so look nodes
+    // up again after runPasses rather than keeping pointers across it.
+    void setCompileCache(const std::string& directory);
     
     // Get debug info
     const DebugInfo& getDebugInfo() const { return debugInfo_; }
+    // Drops the trace of earlier runs, so the manager and its passes can be
+    // reused for another module
+    void resetDebugInfo();
+    // Analyses cached by the last runPasses
+    AnalysisManager& getAnalysisManager() { return analyses_; }
 
 private:
     std::vector<std::unique_ptr<Pass>> passes_;
+    std::vector<std::unique_ptr<PassInstrumentation>> instrumentations_;
     DebugInfo debugInfo_;
+    AnalysisManager analyses_;
     bool emitIR_;
     bool debug_;
+    std::function<double(const IRModule&)> costModel_;
+    // Reused across passes so IR dumps don't reallocate
+    std::string irBuffer_;
+    size_t numThreads_ = 0;
+    // Created on first use by a module with functions
+    std::unique_ptr<ThreadPool> pool_;
+    std::unique_ptr<CompileCache> cache_;
+    // Per module and function while a cached runPasses is in progress
+    struct CachedUnit {
+        // Bytecode of the unit's current IR; empty when not yet known
+        std::vector<char> bytecode;
+        // Set after a cache hit: the IR is only in `bytecode` so far
+        bool pending = false;
+    };
+    std::unordered_map<const IRModule*, CachedUnit> cachedUnits_;
     
+    void runPass(Pass& pass, IRModule& module);
+    void runOnFunctions(Pass& pass, IRModule& module);
+    void runOnUnit(Pass& pass, IRModule& unit, DebugInfo& debugInfo);
+    void runCached(Pass& pass, IRModule& unit, DebugInfo& debugInfo);
+    void runUncached(Pass& pass, IRModule& unit, DebugInfo& debugInfo);
+    void materialize(IRModule& unit);
+    void materializeAll(IRModule& module);
+    void runWithRollback(Pass& pass, IRModule& unit, DebugInfo& debugInfo);
     void emitIRSnapshot(const std::string& passName,
-                       const std::vector<std::shared_ptr<IRNode>>& nodes);
+                       const std::string& ir);
 };
 
 // Standard pass implementations
-std::unique_ptr<Pass> createLoopUnrollingPass(int unrollFactor = 4);
-std::unique_ptr<Pass> createTensorFusionPass();
-std::unique_ptr<Pass> createMemoryMapPass();
+// Checks and derives result types from operand types; see the pass for
+// the rules per op
+std::unique_ptr<Pass> createShapeInferencePass();
+// Folds scalar constant arithmetic, constant scale chains, transpose pairs
+// and redundant casts
+std::unique_ptr<Pass> createConstantFoldingPass();
+// Patterns behind createConstantFoldingPass, for use with applyPatternsGreedily
+void populateConstantFoldingPatterns(RewritePatternSet& patterns);
+// The cast folds among them: casts of constants and of casts
+void populateCastFoldingPatterns(RewritePatternSet& patterns);
+// Replaces pure ops that repeat an earlier one on the same operands and
+// attributes by that op
+std::unique_ptr<Pass> createCSEPass();
+// Erases ops that neither store, write an output tensor, nor feed one that does
+std::unique_ptr<Pass> createDCEPass();
+// What MixedPrecisionPass lowers: top-level f32 ops of the listed types
+// compute in `target`, as do the tensors only they write
+struct PrecisionPolicy {
+    DataType target = DataType::F16;
+    std::set<OpType> ops = {OpType::MATMUL, OpType::ADD, OpType::MUL, OpType::SCALE,
+                            OpType::SOFTMAX, OpType::TRANSPOSE};
+    // Matmuls and softmax accumulate in f32 rather than in `target`
+    bool f32Accumulate = true;
+    // Ops and tensors, by name, that stay f32
+    std::set<std::string> pinned;
+};
+// Lowers f32 compute and the tensors it produces as `policy` allows,
+// casting where lowered and f32 values meet
+std::unique_ptr<Pass> createMixedPrecisionPass(const PrecisionPolicy& policy = PrecisionPolicy());
+// Folds transposes into matmul operand flags and picks a row-major,
+// col-major or tiled layout per tensor, keeping transposes only where a
+// relayout cannot be avoided
+std::unique_ptr<Pass> createLayoutAssignmentPass();
+// Tunes matmul tiles, epilogue fusion and loop unroll factors for `device`,
+// reusing and extending `database`. Candidates are scored on `numThreads`
+// threads (0: all cores).
+std::unique_ptr<Pass> createAutotunePass(TuningDatabase& database,
+                                         const DeviceInfo& device = DeviceInfo(),
+                                         const CostModelParams& params = CostModelParams(),
+                                         size_t numThreads = 0);
+// Loops with at most `fullUnrollThreshold` iterations are unrolled
+// completely; longer ones by `unrollFactor` with a remainder loop.
+std::unique_ptr<Pass> createLoopUnrollingPass(int unrollFactor = 4,
+                                              int fullUnrollThreshold = 16);
+// Fuses elementwise add/mul chains into their producers where `params`
+// estimate the fused kernel to be cheaper
+std::unique_ptr<Pass> createTensorFusionPass(const CostModelParams& params = CostModelParams());
+// Patterns behind createTensorFusionPass, for use with applyPatternsGreedily
+void populateTensorFusionPatterns(RewritePatternSet& patterns, IRContext& context,
+                                  const CostModelParams& params = CostModelParams());
+// Picks matmul tiles and strip-mines top-level loops for `device`
+std::unique_ptr<Pass> createLoopTilingPass(const DeviceInfo& device = DeviceInfo(),
+                                           const CostModelParams& params = CostModelParams());
+// Plans global, shared and register memory within the limits of `device`
+std::unique_ptr<Pass> createMemoryMapPass(const DeviceInfo& device = DeviceInfo());
 
 } // namespace compiler_sim
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include "PassManager.h"
+#include "AllocationCounter.h"
+
+namespace compiler_sim {
+
+// Records hardware and heap counters for each pass in its trace: "cycles",
+// "instructions", "cache_misses" and "branch_misses" from Linux perf
+// events, and "bytes_allocated", "allocations" and "peak_heap_bytes" (peak
+// live heap above the level at pass start) from AllocationCounter.
+// Hardware counters only see the thread calling runPasses, so function
+// passes run on the pool are undercounted; use one thread for complete
+// numbers. Heap counters cover the whole process. Events perf cannot open
+// (no kernel support, perf_event_paranoid, containers) are left out.
+class PassProfiler : public PassInstrumentation {
+public:
+    PassProfiler();
+    ~PassProfiler() override;
+
+    PassProfiler(const PassProfiler&) = delete;
+    PassProfiler& operator=(const PassProfiler&) = delete;
+
+    void beforePass(const Pass& pass, const IRModule& module) override;
+    void afterPass(const Pass& pass, const IRModule& module, DebugInfo& debugInfo) override;
+
+    bool hasHardwareCounters() const;
+    // Why perf could not be used; empty if every event opened
+    const std::string& getUnavailableReason() const { return unavailableReason_; }
+
+private:
+    static constexpr size_t kNumEvents = 4;
+
+    uint64_t readEvent(size_t event) const;
+
+    std::array<int, kNumEvents> fds_;
+    std::array<uint64_t, kNumEvents> start_{};
+    AllocationStats allocStart_;
+    std::string unavailableReason_;
+};
+
+// Prints a table of per-pass time and counters from a trace, as for
+// --time-passes. Counters a pass lacks are shown as "-".
+void printPassTimings(const DebugInfo& debugInfo, std::ostream& os);
+
+} // namespace compiler_sim
\ No newline at end of file
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "IRNode.h"
+
+namespace compiler_sim {
+
+class IRModule;
+class DebugInfo;
+class PatternRewriter;
+
+// A local rewrite rooted at nodes of one OpType. When several patterns
+// share a root type, higher-benefit patterns are tried first.
+class RewritePattern {
+public:
+    RewritePattern(OpType rootType, unsigned benefit = 1)
+        : rootType_(rootType), benefit_(benefit) {}
+    virtual ~RewritePattern() = default;
+
+    OpType getRootType() const { return rootType_; }
+    unsigned getBenefit() const { return benefit_; }
+
+    // Rewrites `op` through `rewriter` and returns true, or returns false
+    // without touching the IR
+    virtual bool matchAndRewrite(IRNode* op, PatternRewriter& rewriter) const = 0;
+
+private:
+    OpType rootType_;
+    unsigned benefit_;
+};
+
+// Patterns indexed by root OpType, each bucket sorted by benefit
+class RewritePatternSet {
+public:
+    void add(std::unique_ptr<RewritePattern> pattern);
+
+    template<typename P, typename... Args>
+    RewritePatternSet& add(Args&&... args) {
+        add(std::make_unique<P>(std::forward<Args>(args)...));
+        return *this;
+    }
+
+    const std::vector<std::unique_ptr<RewritePattern>>& getPatterns(OpType type) const {
+        return byRoot_[static_cast<size_t>(type)];
+    }
+    bool empty() const { return size_ == 0; }
+
+private:
+    std::vector<std::unique_ptr<RewritePattern>> byRoot_[kNumOpTypes];
+    size_t size_ = 0;
+};
+
+struct GreedyRewriteConfig {
+    // Stop after this many rewrites; 0 picks a bound from the module size
+    size_t maxRewrites = 0;
+};
+
+struct GreedyRewriteResult {
+    size_t numRewrites = 0;
+    // False if maxRewrites was hit before the worklist drained
+    bool converged = true;
+};
+
+// All IR changes made by a pattern go through the rewriter, which tells
+// the driver which nodes to revisit and keeps the module body in order.
+class PatternRewriter {
+public:
+    IRModule& getModule() const { return module_; }
+    IRContext& getContext() const;
+
+    // New nodes are queued for matching. A new node takes the body slot of
+    // the op it replaces; otherwise place it with insertBefore.
+    IRNode* create(OpType type, NameId name);
+    IRNode* create(OpType type, std::string_view name) {
+        return create(type, getContext().getIdentifier(name));
+    }
+    void insertBefore(const IRNode* anchor, IRNode* node);
+
+    // Redirects all uses of `op` to `replacement` and erases `op`
+    void replaceOp(IRNode* op, IRNode* replacement);
+    // Erases an op without uses; its operands are revisited
+    void eraseOp(IRNode* op);
+    // Call after changing a node in place so it and its users are revisited
+    void notifyModified(IRNode* op);
+
+    // Records a line in the running pass's trace
+    void notifyTransformation(const std::string& description);
+    // Adds to a counter of the running pass, e.g. bytes a rewrite saved
+    void addPassCounter(const std::string& name, uint64_t value);
+
+private:
+    friend GreedyRewriteResult applyPatternsGreedily(IRModule&, const RewritePatternSet&,
+                                                     DebugInfo*, const GreedyRewriteConfig&);
+
+    PatternRewriter(IRModule& module, DebugInfo* debugInfo);
+
+    void enqueue(ValueId id);
+    void enqueueUsers(const IRNode* op);
+    ValueId pop();
+    void rebuildBody();
+
+    IRModule& module_;
+    DebugInfo* debugInfo_;
+    std::deque<ValueId> worklist_;
+    std::vector<bool> inWorklist_;
+    // Body nodes and nodes created by the rewriter; only these are visited
+    std::vector<bool> topLevel_;
+    // Body bookkeeping, applied once the worklist drains
+    std::unordered_set<ValueId> unplaced_;
+    std::unordered_map<ValueId, ValueId> slotReplacement_;
+    std::unordered_map<ValueId, std::vector<ValueId>> insertions_;
+};
+
+// Applies `patterns` to the module body until no pattern matches. Starts
+// from every body node in program order; after a rewrite only the nodes it
+// touched are revisited. Region members are not visited.
+GreedyRewriteResult applyPatternsGreedily(IRModule& module,
+                                          const RewritePatternSet& patterns,
+                                          DebugInfo* debugInfo = nullptr,
+                                          const GreedyRewriteConfig& config = {});
+
+} // namespace compiler_sim
\ No newline at end of file
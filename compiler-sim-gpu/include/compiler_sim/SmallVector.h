@@ -0,0 +1,178 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <new>
+#include <utility>
+
+namespace compiler_sim {
+
+// Vector with room for N elements stored inline, spilling to the heap only
+// once it outgrows them. Keeps small per-node lists (attributes, operands)
+// inside the node itself instead of behind a separate allocation.
+template<typename T, unsigned N>
+class SmallVector {
+public:
+    using value_type = T;
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    SmallVector() = default;
+
+    SmallVector(std::initializer_list<T> init) {
+        reserve(init.size());
+        for (const T& value : init) {
+            push_back(value);
+        }
+    }
+
+    SmallVector(const SmallVector& other) {
+        reserve(other.size());
+        for (const T& value : other) {
+            push_back(value);
+        }
+    }
+
+    SmallVector(SmallVector&& other) noexcept {
+        moveFrom(std::move(other));
+    }
+
+    ~SmallVector() {
+        clear();
+        releaseHeap();
+    }
+
+    SmallVector& operator=(const SmallVector& other) {
+        if (this != &other) {
+            clear();
+            reserve(other.size());
+            for (const T& value : other) {
+                push_back(value);
+            }
+        }
+        return *this;
+    }
+
+    SmallVector& operator=(SmallVector&& other) noexcept {
+        if (this != &other) {
+            clear();
+            releaseHeap();
+            moveFrom(std::move(other));
+        }
+        return *this;
+    }
+
+    // Iteration
+    iterator begin() { return data_; }
+    iterator end() { return data_ + size_; }
+    const_iterator begin() const { return data_; }
+    const_iterator end() const { return data_ + size_; }
+
+    size_t size() const { return size_; }
+    size_t capacity() const { return capacity_; }
+    bool empty() const { return size_ == 0; }
+    bool isInline() const { return data_ == inlineData(); }
+
+    T& operator[](size_t index) { return data_[index]; }
+    const T& operator[](size_t index) const { return data_[index]; }
+    T& back() { return data_[size_ - 1]; }
+    const T& back() const { return data_[size_ - 1]; }
+
+    // Modification
+    void reserve(size_t count) {
+        if (count > capacity_) {
+            grow(count);
+        }
+    }
+
+    template<typename... Args>
+    T& emplace_back(Args&&... args) {
+        if (size_ == capacity_) {
+            grow(capacity_ * 2);
+        }
+        T* slot = new (data_ + size_) T(std::forward<Args>(args)...);
+        ++size_;
+        return *slot;
+    }
+
+    void push_back(const T& value) { emplace_back(value); }
+    void push_back(T&& value) { emplace_back(std::move(value)); }
+
+    void pop_back() {
+        --size_;
+        data_[size_].~T();
+    }
+
+    iterator insert(iterator pos, T value) {
+        size_t index = pos - begin();
+        emplace_back(std::move(value));
+        std::rotate(begin() + index, end() - 1, end());
+        return begin() + index;
+    }
+
+    iterator erase(iterator pos) {
+        std::move(pos + 1, end(), pos);
+        pop_back();
+        return pos;
+    }
+
+    void clear() {
+        while (size_ > 0) {
+            pop_back();
+        }
+    }
+
+private:
+    T* inlineData() {
+        return reinterpret_cast<T*>(inline_);
+    }
+    const T* inlineData() const {
+        return reinterpret_cast<const T*>(inline_);
+    }
+
+    void grow(size_t minCapacity) {
+        size_t newCapacity = std::max<size_t>(minCapacity, capacity_ * 2);
+        T* newData = static_cast<T*>(::operator new(newCapacity * sizeof(T)));
+        for (uint32_t i = 0; i < size_; ++i) {
+            new (newData + i) T(std::move(data_[i]));
+            data_[i].~T();
+        }
+        releaseHeap();
+        data_ = newData;
+        capacity_ = static_cast<uint32_t>(newCapacity);
+    }
+
+    void releaseHeap() {
+        if (!isInline()) {
+            ::operator delete(data_);
+            data_ = inlineData();
+            capacity_ = N;
+        }
+    }
+
+    // Expects *this to be empty and inline
+    void moveFrom(SmallVector&& other) {
+        if (other.isInline()) {
+            for (T& value : other) {
+                push_back(std::move(value));
+            }
+            other.clear();
+        } else {
+            data_ = other.data_;
+            size_ = other.size_;
+            capacity_ = other.capacity_;
+            other.data_ = other.inlineData();
+            other.size_ = 0;
+            other.capacity_ = N;
+        }
+    }
+
+    T* data_ = inlineData();
+    uint32_t size_ = 0;
+    uint32_t capacity_ = N;
+    alignas(T) unsigned char inline_[N * sizeof(T)];
+};
+
+} // namespace compiler_sim
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace compiler_sim {
+
+enum class DataType {
+    F32,
+    F16,
+    BF16,
+    F64,
+    I32
+};
+
+// How a tensor's last two dimensions are laid out in memory; any leading
+// dimensions are outermost
+enum class Layout {
+    ROW_MAJOR,
+    COL_MAJOR,   // columns contiguous: the bytes of the transposed row-major tensor
+    TILED        // kLayoutTileSize x kLayoutTileSize blocks, each row-major, in row-major order
+};
+
+// Edge of a TILED layout's blocks, in elements
+constexpr int64_t kLayoutTileSize = 32;
+
+size_t getElementSize(DataType dtype);
+const char* dataTypeName(DataType dtype);
+DataType parseDataType(const std::string& name);
+const char* layoutName(Layout layout);
+
+// Shape, element type and layout of a tensor value. Instances are uniqued
+// by IRContext::getTensorType, so two types are equal exactly when their
+// pointers are. Element count and byte size are computed once, in 64 bits.
+class TensorType {
+public:
+    TensorType(std::vector<int64_t> shape, DataType dtype, Layout layout);
+
+    TensorType(const TensorType&) = delete;
+    TensorType& operator=(const TensorType&) = delete;
+
+    const std::vector<int64_t>& getShape() const { return shape_; }
+    size_t getRank() const { return shape_.size(); }
+    int64_t getDim(size_t index) const { return shape_[index]; }
+    DataType getDataType() const { return dtype_; }
+    Layout getLayout() const { return layout_; }
+
+    int64_t getNumElements() const { return numElements_; }
+    uint64_t getByteSize() const { return byteSize_; }
+
+    // e.g. tensor<1024x512xf32>
+    void print(std::string& out) const;
+    std::string toString() const;
+
+private:
+    std::vector<int64_t> shape_;
+    DataType dtype_;
+    Layout layout_;
+    int64_t numElements_;
+    uint64_t byteSize_;
+};
+
+} // namespace compiler_sim
\ No newline at end of file
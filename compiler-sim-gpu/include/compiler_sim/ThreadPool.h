@@ -0,0 +1,65 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace compiler_sim {
+
+// Fixed-size work-stealing pool. Each worker owns a queue: it pops its own
+// tasks from the back (most recently pushed, still warm in cache) and, when
+// empty, steals the oldest task from the front of another worker's queue.
+// Submitted tasks are spread round-robin across the queues.
+//
+// Tasks must not call submit() or wait() on the pool running them.
+class ThreadPool {
+public:
+    // 0 threads means one per hardware thread
+    explicit ThreadPool(size_t numThreads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t getNumThreads() const { return workers_.size(); }
+
+    void submit(std::function<void()> task);
+
+    // Blocks until every submitted task has finished, then rethrows the
+    // first exception a task raised, if any
+    void wait();
+
+    // Runs fn(0) ... fn(n - 1) across the pool and waits for them
+    void parallelFor(size_t n, const std::function<void(size_t)>& fn);
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void workerLoop(size_t self);
+    bool popOrSteal(size_t self, std::function<void()>& task);
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+    size_t nextQueue_ = 0;
+
+    // Guards the counters below and pairs with both condition variables
+    std::mutex stateMutex_;
+    std::condition_variable wakeCv_;
+    std::condition_variable doneCv_;
+    size_t queued_ = 0;   // submitted, not yet picked up
+    size_t pending_ = 0;  // submitted, not yet finished
+    bool stopping_ = false;
+    std::exception_ptr firstError_;
+};
+
+} // namespace compiler_sim
\ No newline at end of file
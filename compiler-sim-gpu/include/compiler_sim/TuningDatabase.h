@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <string>
+#include "CostModel.h"
+#include "DeviceInfo.h"
+#include "KernelPlan.h"
+
+namespace compiler_sim {
+
+// Best configuration the autotuner found for one kernel
+struct TuningConfig {
+    MatmulTile tile;
+    bool fuse = true;
+    int unrollFactor = 1;
+    // The estimate it was chosen by
+    double cycles = 0.0;
+};
+
+// Autotuning results kept across compiles, keyed by a kernel's op type,
+// shape and dtype, e.g. "matmul_add 1024x256x512 f32". Results only hold
+// for the device and cost model they were tuned for, so a file tuned for
+// another target is ignored and replaced on save, as is one that cannot
+// be parsed. Several compiles may look up and record at once.
+class TuningDatabase {
+public:
+    // Loads `path` if it exists and was tuned for `target`
+    TuningDatabase(std::string path, std::string target);
+
+    const std::string& getPath() const { return path_; }
+    const std::string& getTarget() const { return target_; }
+
+    bool lookup(const std::string& key, TuningConfig& config) const;
+    void record(const std::string& key, const TuningConfig& config);
+    size_t size() const;
+
+    // Writes a temporary file and renames it into place, so a compiler
+    // loading the database never reads a partial one. False on failure.
+    bool save() const;
+
+private:
+    std::string path_;
+    std::string target_;
+    mutable std::mutex mutex_;
+    // Ordered, so saved files are stable
+    std::map<std::string, TuningConfig> entries_;
+};
+
+// What tuning results depend on: every device field and cost parameter
+std::string describeTuningTarget(const DeviceInfo& device, const CostModelParams& params);
+
+} // namespace compiler_sim
\ No newline at end of file
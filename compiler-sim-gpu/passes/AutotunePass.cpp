@@ -0,0 +1,352 @@
+#include "compiler_sim/PassManager.h"
+#include "compiler_sim/IRNode.h"
+#include "compiler_sim/KernelPlan.h"
+#include "compiler_sim/ThreadPool.h"
+#include "compiler_sim/TuningDatabase.h"
+#include <algorithm>
+#include <unordered_map>
+
+namespace compiler_sim {
+
+namespace {
+
+// Loops this short are unrolled completely by LoopUnrollingPass
+const int64_t kFullUnrollTrip = 16;
+const int kUnrollFactors[] = {1, 2, 4, 8, 16};
+
+// One kernel to configure. A matmul's epilogue is the chain of single-use
+// elementwise ops that TensorFusionPass could fold into it, up to the
+// first that writes a tensor.
+struct TuningTask {
+    IRNode* root;
+    std::vector<IRNode*> epilogue;
+    std::string key;
+};
+
+// Candidates of one key and their estimates, filled in parallel
+struct Search {
+    const TuningTask* task;
+    std::vector<TuningConfig> candidates;
+};
+
+int64_t tripCount(const IRNode& loop) {
+    int64_t start = loop.getAttribute<int>("start");
+    int64_t end = loop.getAttribute<int>("end");
+    int64_t step = loop.getAttribute<int>("step");
+    return end > start && step > 0 ? (end - start + step - 1) / step : 0;
+}
+
+std::string describeShape(const MatmulShape& shape) {
+    std::string result;
+    if (shape.batch != 1) {
+        result = std::to_string(shape.batch) + "x";
+    }
+    return result + std::to_string(shape.m) + "x" + std::to_string(shape.n) +
+           "x" + std::to_string(shape.k);
+}
+
+std::string describeConfig(const TuningTask& task, const TuningConfig& config) {
+    if (task.root->getType() == OpType::LOOP) {
+        return "unroll by " + std::to_string(config.unrollFactor);
+    }
+    std::string result = std::to_string(config.tile.m) + "x" + std::to_string(config.tile.n) +
+                         "x" + std::to_string(config.tile.k) + " tiles";
+    if (!task.epilogue.empty()) {
+        result += config.fuse ? ", fused" : ", not fused";
+    }
+    return result;
+}
+
+} // namespace
+
+// Searches kernel configurations with the simulator's cost model and
+// remembers the winners in a TuningDatabase. Each matmul tries every tile
+// that fits the device, with and without fusing its elementwise epilogue;
+// each loop too long to unroll fully tries unroll factors up to 16.
+// Kernels are keyed by op type, shape and dtype, so one search serves
+// every kernel with the same key, here and in later compiles. Candidates
+// of all keys missing from the database are scored together on a thread
+// pool; the estimates are deterministic, so the choice does not depend on
+// scheduling. Only sets attributes the later passes read: tile_m/tile_n/
+// tile_k, fuse on a matmul and its epilogue, and unroll_factor.
+//
+// Runs after shape inference, folding and cleanup, and after mixed
+// precision and layout assignment: keys include the dtype and transpose
+// flags, so the kernels searched must be the ones that will be compiled.
+// It runs before unrolling, fusion and tiling, which follow its choices.
+class AutotunePass : public Pass {
+public:
+    AutotunePass(TuningDatabase& database, DeviceInfo device, const CostModelParams& params,
+                 size_t numThreads)
+        : database_(database), device_(std::move(device)), params_(params),
+          numThreads_(numThreads) {}
+
+    std::string getName() const override {
+        return "AutotunePass";
+    }
+
+    std::string getOptions() const override {
+        return describeTuningTarget(device_, params_);
+    }
+
+    // Reads and records the database
+    bool isCacheable() const override {
+        return false;
+    }
+
+    PreservedAnalyses run(IRModule& module,
+                          AnalysisManager&,
+                          DebugInfo& debugInfo) override {
+        std::vector<TuningTask> tasks;
+        collectTasks(module, tasks);
+        for (const auto& function : module.getFunctions()) {
+            collectTasks(*function, tasks);
+        }
+        
+        // One search per key the database lacks, in first-seen order
+        std::vector<Search> searches;
+        std::unordered_map<std::string, size_t> searchOf;
+        for (const TuningTask& task : tasks) {
+            TuningConfig config;
+            if (!database_.lookup(task.key, config) && !searchOf.count(task.key)) {
+                searchOf.emplace(task.key, searches.size());
+                searches.push_back({&task, enumerateCandidates(task)});
+            }
+        }
+        
+        // Flattened so every candidate of every key is one unit of work
+        std::vector<std::pair<size_t, size_t>> work;
+        for (size_t s = 0; s < searches.size(); ++s) {
+            for (size_t c = 0; c < searches[s].candidates.size(); ++c) {
+                work.emplace_back(s, c);
+            }
+        }
+        auto evaluate = [&](size_t i) {
+            Search& search = searches[work[i].first];
+            TuningConfig& candidate = search.candidates[work[i].second];
+            candidate.cycles = estimateCycles(*search.task, candidate);
+        };
+        if (numThreads_ == 1 || work.size() < 2) {
+            for (size_t i = 0; i < work.size(); ++i) {
+                evaluate(i);
+            }
+        } else {
+            if (!pool_) {
+                pool_ = std::make_unique<ThreadPool>(numThreads_);
+            }
+            const size_t numChunks = std::min(work.size(), pool_->getNumThreads());
+            pool_->parallelFor(numChunks, [&](size_t chunk) {
+                for (size_t i = chunk; i < work.size(); i += numChunks) {
+                    evaluate(i);
+                }
+            });
+        }
+        
+        // Ties go to the earlier candidate: smaller tiles, fusion, less unrolling
+        std::vector<bool> reported(searches.size(), false);
+        for (Search& search : searches) {
+            const TuningConfig* best = &search.candidates.front();
+            for (const TuningConfig& candidate : search.candidates) {
+                if (candidate.cycles < best->cycles) {
+                    best = &candidate;
+                }
+            }
+            database_.record(search.task->key, *best);
+        }
+        
+        uint64_t hits = 0;
+        for (const TuningTask& task : tasks) {
+            TuningConfig config;
+            database_.lookup(task.key, config);
+            apply(task, config);
+            auto it = searchOf.find(task.key);
+            if (it != searchOf.end() && !reported[it->second]) {
+                reported[it->second] = true;
+                debugInfo.recordTransformation(
+                    "Tuned " + task.root->getName() + " (" + task.key + "): " +
+                    describeConfig(task, config) + " (estimated " +
+                    std::to_string(static_cast<int64_t>(config.cycles)) + " cycles, best of " +
+                    std::to_string(searches[it->second].candidates.size()) + " candidates)");
+            } else {
+                ++hits;
+                debugInfo.recordTransformation(
+                    "Reused tuning for " + task.root->getName() + " (" + task.key + "): " +
+                    describeConfig(task, config));
+            }
+        }
+        debugInfo.addPassCounter("tuning_db_hits", hits);
+        debugInfo.addPassCounter("tuning_db_misses", searches.size());
+        debugInfo.addPassCounter("candidates_evaluated", work.size());
+        // Only attributes change
+        return PreservedAnalyses::all();
+    }
+
+private:
+    void collectTasks(IRModule& module, std::vector<TuningTask>& tasks) const {
+        IRContext& context = module.getContext();
+        const AttrKey tileKey = context.getAttrKey("tile_size");
+        for (ValueId id : module.getBody()) {
+            IRNode* node = module.getNode(id);
+            if (node->hasAttribute(tileKey)) {
+                continue;
+            }
+            MatmulShape shape;
+            if (node->getType() == OpType::MATMUL && !node->hasAttribute("tile_m") &&
+                getMatmulShape(*node, shape)) {
+                TuningTask task{node, {}, "matmul"};
+                collectEpilogue(task);
+                for (const IRNode* op : task.epilogue) {
+                    task.key += std::string("_") + opTypeName(op->getType());
+                }
+                task.key += " " + describeShape(shape) + " " +
+                            dataTypeName(node->getTensorType()->getDataType());
+                // Transposed operands change the staging, and narrow
+                // accumulators the registers, so the best tile
+                if (shape.transposeA || shape.transposeB) {
+                    task.key += std::string(" ") + (shape.transposeA ? "t" : "n") +
+                                (shape.transposeB ? "t" : "n");
+                }
+                if (shape.accumulatorSize < 4) {
+                    task.key += " acc" + std::to_string(shape.accumulatorSize * 8);
+                }
+                tasks.push_back(std::move(task));
+            } else if (node->getType() == OpType::LOOP && !node->hasAttribute("unrolled") &&
+                       !node->hasAttribute("unroll_factor") && tripCount(*node) > kFullUnrollTrip) {
+                tasks.push_back({node, {}, loopKey(*node)});
+            }
+        }
+    }
+
+    // Follows single-use add/mul consumers from the matmul, through the
+    // operands fusion can replace. An op that writes a tensor must
+    // materialize its result, so nothing after it is fused.
+    static void collectEpilogue(TuningTask& task) {
+        const IRNode* value = task.root;
+        while (value->hasOneUse() && value->getOutputs().empty()) {
+            IRNode* user = value->getModule().getNode(value->getUsers()[0]);
+            if ((user->getType() != OpType::ADD && user->getType() != OpType::MUL) ||
+                user->getInputs().size() < 2 ||
+                (user->getInputs()[0] != value->getId() && user->getInputs()[1] != value->getId())) {
+                break;
+            }
+            task.epilogue.push_back(user);
+            value = user;
+        }
+    }
+
+    // e.g. "loop_load_mul_store 1024 f32": the body's ops, trip count and
+    // the element type of the first typed op
+    static std::string loopKey(const IRNode& loop) {
+        std::string key = "loop";
+        const char* dtype = nullptr;
+        for (ValueId id : loop.getRegion()) {
+            const IRNode* op = loop.getModule().getNode(id);
+            key += std::string("_") + opTypeName(op->getType());
+            if (!dtype && op->getTensorType()) {
+                dtype = dataTypeName(op->getTensorType()->getDataType());
+            }
+        }
+        return key + " " + std::to_string(tripCount(loop)) + " " + (dtype ? dtype : "none");
+    }
+
+    std::vector<TuningConfig> enumerateCandidates(const TuningTask& task) const {
+        std::vector<TuningConfig> candidates;
+        if (task.root->getType() == OpType::LOOP) {
+            const int64_t trip = tripCount(*task.root);
+            for (int factor : kUnrollFactors) {
+                if (factor <= trip) {
+                    TuningConfig config;
+                    config.unrollFactor = factor;
+                    candidates.push_back(config);
+                }
+            }
+            return candidates;
+        }
+        
+        MatmulShape shape;
+        getMatmulShape(*task.root, shape);
+        size_t elementSize = getElementSize(task.root->getTensorType()->getDataType());
+        for (const MatmulTile& tile : candidateMatmulTiles(shape, elementSize, device_)) {
+            TuningConfig config;
+            config.tile = tile;
+            candidates.push_back(config);
+            if (!task.epilogue.empty()) {
+                config.fuse = false;
+                candidates.push_back(config);
+            }
+        }
+        if (candidates.empty()) {
+            throw std::runtime_error("No matmul tile fits " + device_.name);
+        }
+        return candidates;
+    }
+
+    double estimateCycles(const TuningTask& task, const TuningConfig& config) const {
+        if (task.root->getType() == OpType::LOOP) {
+            return estimateLoopCycles(*task.root, config.unrollFactor, device_, params_);
+        }
+        
+        MatmulShape shape;
+        getMatmulShape(*task.root, shape);
+        size_t elementSize = getElementSize(task.root->getTensorType()->getDataType());
+        double cycles = estimateMatmulCycles(
+            shape, planMatmul(config.tile, elementSize, device_, shape.transposeB,
+                              shape.accumulatorSize),
+            device_, params_);
+        
+        // Fused, each epilogue op only reads its other operands in the
+        // matmul's kernel; separately, each is a kernel of its own
+        const IRNode* value = task.root;
+        for (const IRNode* op : task.epilogue) {
+            if (!config.fuse) {
+                cycles += estimateNodeCost(*op, params_);
+                continue;
+            }
+            double bytes = 0.0;
+            for (ValueId input : op->getInputs()) {
+                const TensorType* type = op->getModule().getNode(input)->getTensorType();
+                if (input != value->getId() && type) {
+                    bytes += static_cast<double>(type->getByteSize());
+                }
+            }
+            const TensorType* type = op->getTensorType();
+            double flops = type ? static_cast<double>(type->getNumElements()) *
+                                      (op->getInputs().size() - 1)
+                                : 0.0;
+            cycles += std::max(flops / params_.flopsPerCycle, bytes / params_.bytesPerCycle);
+            value = op;
+        }
+        return cycles;
+    }
+
+    void apply(const TuningTask& task, const TuningConfig& config) const {
+        IRNode* node = task.root;
+        if (node->getType() == OpType::LOOP) {
+            node->setAttribute("unroll_factor", config.unrollFactor);
+            return;
+        }
+        node->setAttribute("tile_m", static_cast<int>(config.tile.m));
+        node->setAttribute("tile_n", static_cast<int>(config.tile.n));
+        node->setAttribute("tile_k", static_cast<int>(config.tile.k));
+        // Fusion follows the decision for the whole chain, as it was priced
+        if (!task.epilogue.empty()) {
+            node->setAttribute("fuse", config.fuse ? 1 : 0);
+            for (IRNode* op : task.epilogue) {
+                op->setAttribute("fuse", config.fuse ? 1 : 0);
+            }
+        }
+    }
+
+    TuningDatabase& database_;
+    DeviceInfo device_;
+    CostModelParams params_;
+    size_t numThreads_;
+    std::unique_ptr<ThreadPool> pool_;
+};
+
+std::unique_ptr<Pass> createAutotunePass(TuningDatabase& database, const DeviceInfo& device,
+                                         const CostModelParams& params, size_t numThreads) {
+    return std::make_unique<AutotunePass>(database, device, params, numThreads);
+}
+
+} // namespace compiler_sim
\ No newline at end of file
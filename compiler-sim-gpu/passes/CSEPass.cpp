@@ -0,0 +1,220 @@
+#include "compiler_sim/PassManager.h"
+#include "compiler_sim/IRNode.h"
+#include <algorithm>
+#include <type_traits>
+#include <unordered_map>
+
+namespace compiler_sim {
+
+namespace {
+
+// What makes two pure ops compute the same value. Attributes come sorted
+// by key from the node, so equal attribute sets compare equal in order.
+struct ExprKey {
+    OpType type;
+    const TensorType* tensorType;
+    std::vector<ValueId> inputs;
+    std::vector<Attribute> attributes;
+
+    bool operator==(const ExprKey& other) const {
+        if (type != other.type || tensorType != other.tensorType || inputs != other.inputs ||
+            attributes.size() != other.attributes.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < attributes.size(); ++i) {
+            if (attributes[i].key != other.attributes[i].key ||
+                attributes[i].value != other.attributes[i].value) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+struct ExprKeyHash {
+    size_t operator()(const ExprKey& key) const {
+        size_t hash = std::hash<int>()(static_cast<int>(key.type));
+        auto combine = [&](size_t value) {
+            hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+        };
+        combine(std::hash<const void*>()(key.tensorType));
+        for (ValueId input : key.inputs) {
+            combine(input);
+        }
+        for (const Attribute& attr : key.attributes) {
+            combine(attr.key);
+            combine(attr.value.index());
+            std::visit([&](const auto& value) {
+                using T = std::decay_t<decltype(value)>;
+                if constexpr (std::is_same_v<T, std::vector<int>>) {
+                    for (int element : value) {
+                        combine(std::hash<int>()(element));
+                    }
+                } else {
+                    combine(std::hash<T>()(value));
+                }
+            }, attr.value);
+        }
+        return hash;
+    }
+};
+
+// Compute ops and constants that write no output tensor depend only on
+// their operands; loads, stores and allocations touch memory
+bool isPure(const IRNode& node) {
+    switch (node.getType()) {
+        case OpType::MATMUL:
+        case OpType::ADD:
+        case OpType::MUL:
+        case OpType::TRANSPOSE:
+        case OpType::SCALE:
+        case OpType::SOFTMAX:
+        case OpType::CONSTANT:
+        case OpType::CAST:
+            return node.getOutputs().empty();
+        default:
+            return false;
+    }
+}
+
+// Buffers `node` writes, including from its region: its output tensors,
+// and for a store every operand after the stored value
+void collectWrites(const IRModule& module, const IRNode& node, std::vector<ValueId>& written) {
+    written.insert(written.end(), node.getOutputs().begin(), node.getOutputs().end());
+    if (node.getType() == OpType::STORE) {
+        written.insert(written.end(), node.getInputs().begin() + 1, node.getInputs().end());
+    }
+    for (ValueId member : node.getRegion()) {
+        collectWrites(module, *module.getNode(member), written);
+    }
+}
+
+} // namespace
+
+// Hash-consing common subexpression elimination. Pure ops are keyed on op
+// type, result type, operands and attributes; an op whose key was already
+// seen is replaced by the earlier one. Plain adds and muls are commutative,
+// so their operands are keyed in sorted order. Ops in a loop or block
+// region may reuse values from the enclosing scopes, but what they define
+// is forgotten when the region ends. A write to a buffer forgets every op
+// that reads it, and a loop forgets what its body writes before it is
+// entered, since a later iteration reads those writes.
+class CSEPass : public Pass {
+public:
+    std::string getName() const override {
+        return "CSEPass";
+    }
+
+    bool isFunctionLocal() const override {
+        return true;
+    }
+
+    PreservedAnalyses run(IRModule& module,
+                          AnalysisManager&,
+                          DebugInfo& debugInfo) override {
+        State state{module.getContext().getAttrKey("fused_ops"), {}, {}, 0, 0};
+        std::vector<ValueId> body = module.getBody();
+        simplifyRegion(module, body, state, debugInfo);
+        
+        debugInfo.addPassCounter("ops_eliminated", state.opsEliminated);
+        debugInfo.addPassCounter("bytes_eliminated", state.bytesEliminated);
+        return state.opsEliminated ? PreservedAnalyses::none() : PreservedAnalyses::all();
+    }
+
+private:
+    struct State {
+        AttrKey fusedOpsKey;
+        std::unordered_map<ExprKey, ValueId, ExprKeyHash> available;
+        // Keys of available ops that read each buffer
+        std::unordered_map<ValueId, std::vector<ExprKey>> readers;
+        uint64_t opsEliminated;
+        uint64_t bytesEliminated;
+    };
+
+    static void invalidateWrites(IRModule& module, const IRNode& node, State& state) {
+        std::vector<ValueId> written;
+        collectWrites(module, node, written);
+        for (ValueId buffer : written) {
+            auto it = state.readers.find(buffer);
+            if (it == state.readers.end()) {
+                continue;
+            }
+            for (const ExprKey& key : it->second) {
+                state.available.erase(key);
+            }
+            state.readers.erase(it);
+        }
+    }
+
+    // Returns true if any op of `region` was erased
+    static bool simplifyRegion(IRModule& module, std::vector<ValueId>& region, State& state,
+                               DebugInfo& debugInfo) {
+        bool erased = false;
+        std::vector<ExprKey> scope;
+        for (ValueId id : region) {
+            IRNode* node = module.getNode(id);
+            if (node->isErased()) {
+                continue;
+            }
+            if (node->getType() == OpType::LOOP || node->getType() == OpType::BLOCK) {
+                if (node->getType() == OpType::LOOP) {
+                    invalidateWrites(module, *node, state);
+                }
+                std::vector<ValueId> nested = node->getRegion();
+                if (simplifyRegion(module, nested, state, debugInfo)) {
+                    node->setRegion(std::move(nested));
+                }
+                continue;
+            }
+            if (!isPure(*node)) {
+                invalidateWrites(module, *node, state);
+                continue;
+            }
+            
+            ExprKey key{node->getType(), node->getTensorType(), node->getInputs(),
+                        {node->getAttributes().begin(), node->getAttributes().end()}};
+            if ((node->getType() == OpType::ADD || node->getType() == OpType::MUL) &&
+                !node->hasAttribute(state.fusedOpsKey)) {
+                std::sort(key.inputs.begin(), key.inputs.end());
+            }
+            auto [it, inserted] = state.available.emplace(key, id);
+            if (inserted) {
+                for (ValueId input : node->getInputs()) {
+                    if (module.getNode(input)->getType() == OpType::ALLOC) {
+                        state.readers[input].push_back(key);
+                    }
+                }
+                scope.push_back(std::move(key));
+                continue;
+            }
+            
+            IRNode* existing = module.getNode(it->second);
+            debugInfo.recordTransformation(
+                "Replaced " + node->getName() + " with " + existing->getName() +
+                " (common subexpression)");
+            node->replaceAllUsesWith(existing);
+            node->erase();
+            erased = true;
+            ++state.opsEliminated;
+            if (const TensorType* type = node->getTensorType()) {
+                state.bytesEliminated += type->getByteSize();
+            }
+        }
+        
+        for (const ExprKey& key : scope) {
+            state.available.erase(key);
+        }
+        if (erased) {
+            region.erase(std::remove_if(region.begin(), region.end(), [&](ValueId id) {
+                return module.getNode(id)->isErased();
+            }), region.end());
+        }
+        return erased;
+    }
+};
+
+std::unique_ptr<Pass> createCSEPass() {
+    return std::make_unique<CSEPass>();
+}
+
+} // namespace compiler_sim
\ No newline at end of file
@@ -0,0 +1,320 @@
+#include "compiler_sim/PassManager.h"
+#include "compiler_sim/PatternRewriter.h"
+#include "compiler_sim/IRNode.h"
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <numeric>
+
+namespace compiler_sim {
+
+namespace {
+
+bool isScalarConstant(const IRNode* node) {
+    return node->getType() == OpType::CONSTANT && node->getTensorType() &&
+           node->getTensorType()->getNumElements() == 1;
+}
+
+float constantValue(const IRNode* node) {
+    return node->getAttribute<float>("value");
+}
+
+std::string formatValue(float value) {
+    char buf[32];
+    int len = std::snprintf(buf, sizeof(buf), "%g", value);
+    return std::string(buf, len);
+}
+
+// The permutation `perm` attribute of a transpose, or the swap of its last
+// two dimensions
+std::vector<int> transposePerm(const IRNode& node, size_t rank) {
+    if (node.hasAttribute("perm")) {
+        return node.getAttribute<std::vector<int>>("perm");
+    }
+    std::vector<int> perm(rank);
+    std::iota(perm.begin(), perm.end(), 0);
+    std::swap(perm[rank - 2], perm[rank - 1]);
+    return perm;
+}
+
+// Whether every value of `from` converts to `to` and back unchanged
+bool convertsExactly(DataType from, DataType to) {
+    switch (from) {
+        case DataType::F16:
+        case DataType::BF16:
+            return to == from || to == DataType::F32 || to == DataType::F64;
+        case DataType::F32:
+            return to == DataType::F32 || to == DataType::F64;
+        default:
+            return to == from;
+    }
+}
+
+// `value` as the cast to `dtype` stores it: rounded to nearest even at the
+// type's precision, with f16 overflowing to infinity and I32 truncated
+float roundToType(float value, DataType dtype) {
+    int significantBits;
+    int minExponent;
+    switch (dtype) {
+        case DataType::F16:
+            significantBits = 11;
+            minExponent = -24;
+            break;
+        case DataType::BF16:
+            significantBits = 8;
+            minExponent = -133;
+            break;
+        case DataType::I32:
+            return std::trunc(value);
+        default:
+            return value;
+    }
+    if (value == 0.0f || !std::isfinite(value)) {
+        return value;
+    }
+    int exponent;
+    std::frexp(value, &exponent);
+    // Subnormals keep the quantum of the smallest exponent
+    double quantum = std::ldexp(1.0, std::max(exponent - significantBits, minExponent));
+    double rounded = std::nearbyint(value / quantum) * quantum;
+    if (dtype == DataType::F16 && std::fabs(rounded) > 65504.0) {
+        return std::copysign(std::numeric_limits<float>::infinity(), value);
+    }
+    return static_cast<float>(rounded);
+}
+
+} // namespace
+
+// Pattern: an add, mul or scale whose operands are all scalar constants
+// becomes one constant
+class FoldScalarArithmeticPattern : public RewritePattern {
+public:
+    explicit FoldScalarArithmeticPattern(OpType rootType) : RewritePattern(rootType, 2) {}
+
+    bool matchAndRewrite(IRNode* op, PatternRewriter& rewriter) const override {
+        if (op->getInputs().size() < 2 || op->hasAttribute("fused_ops") ||
+            !op->getOutputs().empty()) {
+            return false;
+        }
+        for (size_t i = 0; i < op->getInputs().size(); ++i) {
+            if (!isScalarConstant(op->getInput(i))) {
+                return false;
+            }
+        }
+        
+        float value = constantValue(op->getInput(0));
+        for (size_t i = 1; i < op->getInputs().size(); ++i) {
+            float operand = constantValue(op->getInput(i));
+            value = op->getType() == OpType::ADD ? value + operand : value * operand;
+        }
+        IRNode* folded = rewriter.create(OpType::CONSTANT, op->getNameId());
+        folded->setAttribute("value", value);
+        folded->setTensorType(op->getInput(0)->getTensorType());
+        rewriter.notifyTransformation("Folded " + op->getName() + " to constant " +
+                                      formatValue(value));
+        rewriter.replaceOp(op, folded);
+        return true;
+    }
+};
+
+// Pattern: scale(scale(x, a), b) with constant factors becomes
+// scale(x, a * b), and a scale by 1 becomes its input. An inner scale that
+// writes an output tensor is kept for that write.
+class FoldScaleChainPattern : public RewritePattern {
+public:
+    FoldScaleChainPattern() : RewritePattern(OpType::SCALE) {}
+
+    bool matchAndRewrite(IRNode* op, PatternRewriter& rewriter) const override {
+        if (op->getInputs().size() != 2 || !isScalarConstant(op->getInput(1))) {
+            return false;
+        }
+        IRNode* input = op->getInput(0);
+        float factor = constantValue(op->getInput(1));
+        if (factor == 1.0f && input->getTensorType() == op->getTensorType() &&
+            op->getOutputs().empty()) {
+            rewriter.notifyTransformation("Removed " + op->getName() + " (scale by 1)");
+            rewriter.replaceOp(op, input);
+            return true;
+        }
+        if (input->getType() != OpType::SCALE || input->getInputs().size() != 2 ||
+            !isScalarConstant(input->getInput(1))) {
+            return false;
+        }
+        
+        float combined = constantValue(input->getInput(1)) * factor;
+        IRNode* constant = rewriter.create(OpType::CONSTANT, op->getName() + "_factor");
+        constant->setAttribute("value", combined);
+        constant->setTensorType(op->getInput(1)->getTensorType());
+        rewriter.insertBefore(op, constant);
+        
+        IRNode* scale = rewriter.create(OpType::SCALE, op->getNameId());
+        scale->addInput(input->getInputs()[0]).addInput(constant);
+        scale->setTensorType(op->getTensorType());
+        for (ValueId output : op->getOutputs()) {
+            scale->addOutput(output);
+        }
+        rewriter.notifyTransformation("Folded " + input->getName() + " into " + op->getName() +
+                                      " (scale by " + formatValue(combined) + ")");
+        rewriter.replaceOp(op, scale);
+        if (input->useEmpty() && input->getOutputs().empty()) {
+            rewriter.eraseOp(input);
+        }
+        return true;
+    }
+};
+
+// Pattern: transpose(transpose(x)) becomes one transpose with the composed
+// permutation, or x itself when they cancel. An inner transpose that writes
+// an output tensor is kept for that write.
+class FoldTransposePairPattern : public RewritePattern {
+public:
+    FoldTransposePairPattern() : RewritePattern(OpType::TRANSPOSE) {}
+
+    bool matchAndRewrite(IRNode* op, PatternRewriter& rewriter) const override {
+        IRNode* inner = op->getInputs().size() == 1 ? op->getInput(0) : nullptr;
+        if (!inner || inner->getType() != OpType::TRANSPOSE || inner->getInputs().size() != 1) {
+            return false;
+        }
+        IRNode* source = inner->getInput(0);
+        const TensorType* type = source->getTensorType();
+        if (!type || type->getRank() < 2 || !op->getOutputs().empty()) {
+            return false;
+        }
+        
+        // Output dimension i is the inner result's outerPerm[i], which is
+        // the source's innerPerm[outerPerm[i]]
+        const size_t rank = type->getRank();
+        std::vector<int> innerPerm = transposePerm(*inner, rank);
+        std::vector<int> outerPerm = transposePerm(*op, rank);
+        std::vector<int> composed(rank);
+        bool identity = true;
+        for (size_t i = 0; i < rank; ++i) {
+            composed[i] = innerPerm.at(outerPerm.at(i));
+            identity = identity && composed[i] == static_cast<int>(i);
+        }
+        
+        if (identity) {
+            rewriter.notifyTransformation("Cancelled transposes " + inner->getName() +
+                                          " and " + op->getName());
+            rewriter.replaceOp(op, source);
+        } else {
+            IRNode* transpose = rewriter.create(OpType::TRANSPOSE, op->getNameId());
+            transpose->addInput(source);
+            transpose->setAttribute("perm", composed);
+            transpose->setTensorType(op->getTensorType());
+            rewriter.notifyTransformation("Composed transposes " + inner->getName() +
+                                          " and " + op->getName());
+            rewriter.replaceOp(op, transpose);
+        }
+        if (inner->useEmpty() && inner->getOutputs().empty()) {
+            rewriter.eraseOp(inner);
+        }
+        return true;
+    }
+};
+
+// Pattern: a cast of a constant becomes a constant, a cast to its operand's
+// type becomes the operand, and cast(cast(x)) whose inner cast loses
+// nothing becomes one cast of x, or x itself when they cancel
+class FoldCastPattern : public RewritePattern {
+public:
+    FoldCastPattern() : RewritePattern(OpType::CAST) {}
+
+    bool matchAndRewrite(IRNode* op, PatternRewriter& rewriter) const override {
+        const TensorType* type = op->getTensorType();
+        IRNode* input = op->getInputs().size() == 1 ? op->getInput(0) : nullptr;
+        if (!type || !input || !input->getTensorType()) {
+            return false;
+        }
+        if (isScalarConstant(input)) {
+            if (!op->getOutputs().empty()) {
+                return false;
+            }
+            float value = roundToType(constantValue(input), type->getDataType());
+            IRNode* folded = rewriter.create(OpType::CONSTANT, op->getNameId());
+            folded->setAttribute("value", value);
+            folded->setTensorType(type);
+            rewriter.notifyTransformation("Folded " + op->getName() + " to constant " +
+                                          formatValue(value));
+            rewriter.replaceOp(op, folded);
+            return true;
+        }
+
+        IRNode* inner = nullptr;
+        IRNode* source = input;
+        if (input->getType() == OpType::CAST && input->getInputs().size() == 1 &&
+            input->getInput(0)->getTensorType() &&
+            convertsExactly(input->getInput(0)->getTensorType()->getDataType(),
+                            input->getTensorType()->getDataType())) {
+            inner = input;
+            source = input->getInput(0);
+        }
+        if (source->getTensorType() == type) {
+            if (!op->getOutputs().empty()) {
+                return false;
+            }
+            rewriter.notifyTransformation(
+                inner ? "Cancelled casts " + inner->getName() + " and " + op->getName()
+                      : "Removed " + op->getName() + " (cast to its operand's type)");
+            rewriter.replaceOp(op, source);
+        } else if (inner) {
+            IRNode* cast = rewriter.create(OpType::CAST, op->getNameId());
+            cast->addInput(source);
+            cast->setTensorType(type);
+            for (ValueId output : op->getOutputs()) {
+                cast->addOutput(output);
+            }
+            rewriter.notifyTransformation("Composed casts " + inner->getName() + " and " +
+                                          op->getName());
+            rewriter.replaceOp(op, cast);
+        } else {
+            return false;
+        }
+        if (inner && inner->useEmpty() && inner->getOutputs().empty()) {
+            rewriter.eraseOp(inner);
+        }
+        return true;
+    }
+};
+
+void populateConstantFoldingPatterns(RewritePatternSet& patterns) {
+    patterns.add<FoldScalarArithmeticPattern>(OpType::ADD);
+    patterns.add<FoldScalarArithmeticPattern>(OpType::MUL);
+    patterns.add<FoldScalarArithmeticPattern>(OpType::SCALE);
+    patterns.add<FoldScaleChainPattern>();
+    patterns.add<FoldTransposePairPattern>();
+    populateCastFoldingPatterns(patterns);
+}
+
+void populateCastFoldingPatterns(RewritePatternSet& patterns) {
+    patterns.add<FoldCastPattern>();
+}
+
+// Evaluates what is known at compile time: arithmetic on scalar constants,
+// chains of constant scales, transposes of transposes, and casts of
+// constants or of casts
+class ConstantFoldingPass : public Pass {
+public:
+    std::string getName() const override {
+        return "ConstantFoldingPass";
+    }
+
+    bool isFunctionLocal() const override {
+        return true;
+    }
+
+    PreservedAnalyses run(IRModule& module,
+                          AnalysisManager&,
+                          DebugInfo& debugInfo) override {
+        RewritePatternSet patterns;
+        populateConstantFoldingPatterns(patterns);
+        GreedyRewriteResult result = applyPatternsGreedily(module, patterns, &debugInfo);
+        return result.numRewrites ? PreservedAnalyses::none() : PreservedAnalyses::all();
+    }
+};
+
+std::unique_ptr<Pass> createConstantFoldingPass() {
+    return std::make_unique<ConstantFoldingPass>();
+}
+
+} // namespace compiler_sim
\ No newline at end of file
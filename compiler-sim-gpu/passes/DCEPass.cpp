@@ -0,0 +1,133 @@
+#include "compiler_sim/PassManager.h"
+#include "compiler_sim/IRNode.h"
+#include <algorithm>
+
+namespace compiler_sim {
+
+namespace {
+
+// Ops whose effect is visible after the module runs: stores, and ops that
+// write their result into an output tensor
+bool isRoot(const IRNode& node) {
+    return node.getType() == OpType::STORE || !node.getOutputs().empty();
+}
+
+} // namespace
+
+// Liveness-driven dead code elimination. Starting from the roots, a live
+// op makes its operands, the tensors it writes and the loop or block
+// holding it live. Everything else is erased: values nobody reads,
+// allocations nothing writes or reads, and loops whose bodies have no
+// effect, so MemoryMapPass never assigns them memory.
+class DCEPass : public Pass {
+public:
+    std::string getName() const override {
+        return "DCEPass";
+    }
+
+    bool isFunctionLocal() const override {
+        return true;
+    }
+
+    PreservedAnalyses run(IRModule& module,
+                          AnalysisManager&,
+                          DebugInfo& debugInfo) override {
+        const size_t numNodes = module.getNumNodes();
+        std::vector<ValueId> parent(numNodes, kInvalidValueId);
+        std::vector<bool> live(numNodes, false);
+        std::vector<ValueId> worklist;
+        auto markLive = [&](ValueId id) {
+            if (id != kInvalidValueId && !live[id]) {
+                live[id] = true;
+                worklist.push_back(id);
+            }
+        };
+        
+        // Record which region holds each op and seed the roots
+        std::vector<std::pair<const std::vector<ValueId>*, ValueId>> regions{
+            {&module.getBody(), kInvalidValueId}};
+        while (!regions.empty()) {
+            auto [region, owner] = regions.back();
+            regions.pop_back();
+            for (ValueId id : *region) {
+                const IRNode* node = module.getNode(id);
+                parent[id] = owner;
+                if (isRoot(*node)) {
+                    markLive(id);
+                }
+                if (!node->getRegion().empty()) {
+                    regions.emplace_back(&node->getRegion(), id);
+                }
+            }
+        }
+        while (!worklist.empty()) {
+            const IRNode* node = module.getNode(worklist.back());
+            worklist.pop_back();
+            for (ValueId input : node->getInputs()) {
+                markLive(input);
+            }
+            for (ValueId output : node->getOutputs()) {
+                markLive(output);
+            }
+            markLive(parent[node->getId()]);
+        }
+        
+        Removal removal{live, 0, 0};
+        std::vector<ValueId> body = module.getBody();
+        removeDead(module, body, removal, debugInfo);
+        
+        debugInfo.addPassCounter("ops_eliminated", removal.opsEliminated);
+        debugInfo.addPassCounter("bytes_eliminated", removal.bytesEliminated);
+        return removal.opsEliminated ? PreservedAnalyses::none() : PreservedAnalyses::all();
+    }
+
+private:
+    struct Removal {
+        const std::vector<bool>& live;
+        uint64_t opsEliminated;
+        uint64_t bytesEliminated;
+    };
+
+    // Erases the dead ops of `region` in reverse program order, so each op
+    // goes before the values it reads. Returns true if any was erased.
+    static bool removeDead(IRModule& module, std::vector<ValueId>& region, Removal& removal,
+                           DebugInfo& debugInfo) {
+        bool erased = false;
+        for (auto it = region.rbegin(); it != region.rend(); ++it) {
+            IRNode* node = module.getNode(*it);
+            if (node->isErased()) {
+                continue;
+            }
+            if (!node->getRegion().empty()) {
+                std::vector<ValueId> nested = node->getRegion();
+                if (removeDead(module, nested, removal, debugInfo)) {
+                    node->setRegion(std::move(nested));
+                }
+            }
+            // Nodes never placed in the body may still read a dead value
+            if (removal.live[*it] || !node->useEmpty()) {
+                continue;
+            }
+            debugInfo.recordTransformation(
+                std::string("Removed dead ") + opTypeName(node->getType()) + " " + node->getName());
+            node->erase();
+            erased = true;
+            ++removal.opsEliminated;
+            if (const TensorType* type = node->getTensorType()) {
+                removal.bytesEliminated += type->getByteSize();
+            }
+        }
+        if (erased) {
+            region.erase(std::remove_if(region.begin(), region.end(), [&](ValueId id) {
+                return module.getNode(id)->isErased();
+            }), region.end());
+        }
+        return erased;
+    }
+};
+
+std::unique_ptr<Pass> createDCEPass() {
+    return std::make_unique<DCEPass>();
+}
+
+} // namespace compiler_sim
\ No newline at end of file
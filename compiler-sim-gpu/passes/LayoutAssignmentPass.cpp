@@ -0,0 +1,408 @@
+#include "compiler_sim/PassManager.h"
+#include "compiler_sim/IRNode.h"
+#include <algorithm>
+#include <numeric>
+
+namespace compiler_sim {
+
+namespace {
+
+// Whether `transpose` only swaps the last two dimensions of its operand,
+// which a matmul can absorb and a layout can express
+bool swapsLastTwo(const IRNode& transpose) {
+    const TensorType* type = transpose.getInputs().size() == 1
+                                 ? transpose.getInput(0)->getTensorType() : nullptr;
+    if (!type || type->getRank() < 2) {
+        return false;
+    }
+    if (!transpose.hasAttribute("perm")) {
+        return true;
+    }
+    const std::vector<int>& perm = transpose.getAttribute<std::vector<int>>("perm");
+    const int rank = static_cast<int>(type->getRank());
+    if (static_cast<int>(perm.size()) != rank) {
+        return false;
+    }
+    for (int i = 0; i + 2 < rank; ++i) {
+        if (perm[i] != i) {
+            return false;
+        }
+    }
+    return perm[rank - 2] == rank - 1 && perm[rank - 1] == rank - 2;
+}
+
+// Whether the type's last two dimensions are whole layout tiles
+bool isTileable(const TensorType& type) {
+    return type.getRank() >= 2 && type.getShape().back() % kLayoutTileSize == 0 &&
+           type.getShape()[type.getRank() - 2] % kLayoutTileSize == 0;
+}
+
+// Scalars read the same in any layout
+bool isTensor(const IRNode& node) {
+    return node.getTensorType() && node.getTensorType()->getNumElements() > 1;
+}
+
+// Elementwise operands of the same shape are read at the same index as the
+// result, so they must be stored the same way
+bool sameShape(const IRNode& a, const IRNode& b) {
+    return isTensor(a) && isTensor(b) &&
+           a.getTensorType()->getShape() == b.getTensorType()->getShape();
+}
+
+void collectOps(const IRModule& module, const std::vector<ValueId>& region,
+                std::vector<IRNode*>& ops) {
+    for (ValueId id : region) {
+        IRNode* node = module.getNode(id);
+        if (node->isErased()) {
+            continue;
+        }
+        ops.push_back(node);
+        collectOps(module, node->getRegion(), ops);
+    }
+}
+
+// Values that must share a layout, joined by union-find, and what their
+// readers and writers need of it
+class LayoutGroups {
+public:
+    explicit LayoutGroups(size_t numNodes) : parent_(numNodes), groups_(numNodes) {
+        std::iota(parent_.begin(), parent_.end(), 0);
+    }
+
+    ValueId find(ValueId id) {
+        while (parent_[id] != id) {
+            parent_[id] = parent_[parent_[id]];
+            id = parent_[id];
+        }
+        return id;
+    }
+
+    void unite(ValueId a, ValueId b) {
+        a = find(a);
+        b = find(b);
+        if (a != b) {
+            parent_[b] = a;
+        }
+    }
+
+    struct Group {
+        bool rowMajor = false;    // accessed by something that needs row-major data
+        bool matmulOnly = true;   // only matmuls touch it, a tile at a time
+        bool tileable = true;     // every value in it is whole layout tiles
+        bool decided = false;
+        Layout layout = Layout::ROW_MAJOR;
+    };
+
+    // Call once every unite() is done
+    Group& get(ValueId id) { return groups_[find(id)]; }
+
+    // Tiled when only matmuls access the group and tiling pads nothing,
+    // since each tile a kernel stages is then one contiguous block;
+    // row-major otherwise
+    Layout resolve(ValueId id) {
+        Group& group = get(id);
+        if (!group.decided) {
+            group.decided = true;
+            group.layout = !group.rowMajor && group.matmulOnly && group.tileable
+                               ? Layout::TILED : Layout::ROW_MAJOR;
+        }
+        return group.layout;
+    }
+
+private:
+    std::vector<ValueId> parent_;
+    std::vector<Group> groups_;
+};
+
+} // namespace
+
+// Chooses how each tensor is stored, to avoid moving data just to reorder
+// it. First, a transpose feeding a matmul operand is folded into the
+// matmul's transpose_a/transpose_b flag, and removed once nothing else
+// reads it. Then values are grouped by what must share a layout (an op
+// and the tensors it writes, elementwise operands and results of one
+// shape, a stored value and its buffer), and each group gets:
+//   row_major  if the host fills or reads a tensor in it, or an op that
+//              walks rows (softmax, broadcasting, general permutes) uses it
+//   tiled      if only matmuls use it and its values are whole tiles
+//   col_major  if it is the result of a transpose whose input is row-major:
+//              the transpose becomes a view of the same bytes (view = 1)
+// A transpose whose result cannot be a view stays as an explicit relayout.
+class LayoutAssignmentPass : public Pass {
+public:
+    std::string getName() const override {
+        return "LayoutAssignmentPass";
+    }
+
+    bool isFunctionLocal() const override {
+        return true;
+    }
+
+    PreservedAnalyses run(IRModule& module,
+                          AnalysisManager&,
+                          DebugInfo& debugInfo) override {
+        Folding folding;
+        foldTransposes(module, folding, debugInfo);
+        bool changed = folding.folded != 0;
+
+        std::vector<IRNode*> ops;
+        collectOps(module, module.getBody(), ops);
+        LayoutGroups groups(module.getNumNodes());
+        buildGroups(module, ops, groups);
+
+        const AttrKey viewKey = module.getContext().getAttrKey("view");
+        uint64_t viewed = 0;
+        uint64_t relayouts = 0;
+        uint64_t bytesSaved = 0;
+        for (IRNode* node : ops) {
+            if (node->getType() != OpType::TRANSPOSE || node->getInputs().size() != 1 ||
+                !node->getTensorType()) {
+                continue;
+            }
+            std::string reason = viewReason(*node, groups);
+            if (!reason.empty()) {
+                debugInfo.recordTransformation("Kept transpose " + node->getName() +
+                                               " as a relayout: " + reason);
+                ++relayouts;
+                continue;
+            }
+            LayoutGroups::Group& group = groups.get(node->getId());
+            group.decided = true;
+            group.layout = groups.resolve(node->getInputs()[0]) == Layout::ROW_MAJOR
+                               ? Layout::COL_MAJOR : Layout::ROW_MAJOR;
+            if (!node->hasAttribute(viewKey)) {
+                node->setAttribute(viewKey, 1);
+                debugInfo.recordTransformation(
+                    "Transposed " + node->getInput(0)->getName() + " as a view: " +
+                    node->getName() + " reads it as " + layoutName(group.layout));
+                ++viewed;
+                bytesSaved += 2 * node->getTensorType()->getByteSize();
+                changed = true;
+            }
+        }
+
+        IRContext& context = module.getContext();
+        for (IRNode* node : ops) {
+            const TensorType* type = node->getTensorType();
+            if (!type) {
+                continue;
+            }
+            Layout layout = groups.resolve(node->getId());
+            if (layout == type->getLayout()) {
+                continue;
+            }
+            node->setTensorType(
+                context.getTensorType(type->getShape(), type->getDataType(), layout));
+            if (node->getType() == OpType::ALLOC) {
+                debugInfo.recordTransformation(std::string("Assigned ") + layoutName(layout) +
+                                               " layout to " + node->getName());
+            }
+            changed = true;
+        }
+
+        debugInfo.addPassCounter("transposes_folded", folding.folded);
+        debugInfo.addPassCounter("transposes_viewed", viewed);
+        debugInfo.addPassCounter("relayouts", relayouts);
+        debugInfo.addPassCounter("relayout_bytes_saved", folding.bytesSaved + bytesSaved);
+        return changed ? PreservedAnalyses::none() : PreservedAnalyses::all();
+    }
+
+private:
+    struct Folding {
+        uint64_t folded = 0;
+        // A transpose copy reads and writes its whole tensor
+        uint64_t bytesSaved = 0;
+    };
+
+    // Rewires matmul operands past last-two-dimension transposes, toggling
+    // the operand's flag, then erases the transposes left unused
+    static void foldTransposes(IRModule& module, Folding& folding, DebugInfo& debugInfo) {
+        IRContext& context = module.getContext();
+        const AttrKey flagKeys[] = {context.getAttrKey("transpose_a"),
+                                    context.getAttrKey("transpose_b")};
+        std::vector<IRNode*> ops;
+        collectOps(module, module.getBody(), ops);
+        std::vector<bool> candidates(module.getNumNodes(), false);
+        for (IRNode* node : ops) {
+            if (node->getType() != OpType::MATMUL) {
+                continue;
+            }
+            for (size_t i = 0; i < 2 && i < node->getInputs().size(); ++i) {
+                IRNode* transpose = node->getInput(i);
+                if (transpose->getType() != OpType::TRANSPOSE || !swapsLastTwo(*transpose)) {
+                    continue;
+                }
+                int flag = 0;
+                if (const AttributeValue* value = node->findAttribute(flagKeys[i])) {
+                    flag = std::get<int>(*value);
+                }
+                node->setInput(i, transpose->getInputs()[0]);
+                node->setAttribute(flagKeys[i], flag ? 0 : 1);
+                candidates[transpose->getId()] = true;
+                ++folding.folded;
+                debugInfo.recordTransformation(
+                    "Folded transpose " + transpose->getName() + " into " + node->getName() +
+                    " (" + context.getAttrName(flagKeys[i]) + " = " +
+                    std::to_string(flag ? 0 : 1) + ")");
+            }
+        }
+        if (folding.folded != 0) {
+            std::vector<ValueId> body = module.getBody();
+            eraseUnused(module, body, candidates, folding);
+        }
+    }
+
+    static void eraseUnused(IRModule& module, std::vector<ValueId>& region,
+                            const std::vector<bool>& candidates, Folding& folding) {
+        bool erased = false;
+        for (ValueId id : region) {
+            IRNode* node = module.getNode(id);
+            if (!node->getRegion().empty()) {
+                std::vector<ValueId> nested = node->getRegion();
+                eraseUnused(module, nested, candidates, folding);
+                if (nested.size() != node->getRegion().size()) {
+                    node->setRegion(std::move(nested));
+                }
+            }
+            if (candidates[id] && !node->isErased() && node->useEmpty() &&
+                node->getOutputs().empty()) {
+                if (const TensorType* type = node->getTensorType()) {
+                    folding.bytesSaved += 2 * type->getByteSize();
+                }
+                node->erase();
+                erased = true;
+            }
+        }
+        if (erased) {
+            region.erase(std::remove_if(region.begin(), region.end(), [&](ValueId id) {
+                return module.getNode(id)->isErased();
+            }), region.end());
+        }
+    }
+
+    static void buildGroups(const IRModule& module, const std::vector<IRNode*>& ops,
+                            LayoutGroups& groups) {
+        for (IRNode* node : ops) {
+            const ValueId id = node->getId();
+            for (ValueId output : node->getOutputs()) {
+                groups.unite(id, output);
+            }
+            const std::vector<ValueId>& inputs = node->getInputs();
+            for (size_t i = 0; i < inputs.size(); ++i) {
+                const IRNode* input = module.getNode(inputs[i]);
+                switch (node->getType()) {
+                    case OpType::MATMUL:
+                        // Epilogue operands are read at the result's index
+                        if (i >= 2 && sameShape(*node, *input)) {
+                            groups.unite(id, inputs[i]);
+                        }
+                        break;
+                    case OpType::ADD:
+                    case OpType::MUL:
+                    case OpType::SCALE:
+                    case OpType::LOAD:
+                    case OpType::CAST:
+                        if (sameShape(*node, *input)) {
+                            groups.unite(id, inputs[i]);
+                        }
+                        break;
+                    case OpType::STORE:
+                        if (i > 0 && sameShape(*module.getNode(inputs[0]), *input)) {
+                            groups.unite(inputs[0], inputs[i]);
+                        }
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+
+        for (IRNode* node : ops) {
+            const TensorType* type = node->getTensorType();
+            LayoutGroups::Group& group = groups.get(node->getId());
+            group.tileable = group.tileable && type && isTileable(*type);
+            const std::vector<ValueId>& inputs = node->getInputs();
+            switch (node->getType()) {
+                case OpType::ALLOC:
+                    // The host uses row-major data
+                    group.rowMajor = group.rowMajor || isHostVisible(*node);
+                    break;
+                case OpType::CONSTANT:
+                case OpType::LOOP:
+                case OpType::BLOCK:
+                    break;
+                case OpType::MATMUL:
+                    // Broadcast epilogue operands are indexed as row-major
+                    for (size_t i = 2; i < inputs.size(); ++i) {
+                        const IRNode* input = module.getNode(inputs[i]);
+                        if (isTensor(*input) && !sameShape(*node, *input)) {
+                            groups.get(inputs[i]).rowMajor = true;
+                            group.rowMajor = true;
+                        }
+                    }
+                    break;
+                case OpType::SOFTMAX:
+                    group.rowMajor = true;
+                    for (ValueId input : inputs) {
+                        groups.get(input).rowMajor = true;
+                    }
+                    break;
+                case OpType::TRANSPOSE:
+                    group.matmulOnly = false;
+                    for (ValueId input : inputs) {
+                        LayoutGroups::Group& source = groups.get(input);
+                        source.matmulOnly = false;
+                        if (!swapsLastTwo(*node)) {
+                            source.rowMajor = true;
+                            group.rowMajor = true;
+                        }
+                    }
+                    break;
+                default:
+                    // Elementwise ops, loads and stores walk whole rows
+                    group.matmulOnly = false;
+                    for (ValueId input : inputs) {
+                        const IRNode* operand = module.getNode(input);
+                        LayoutGroups::Group& source = groups.get(input);
+                        source.matmulOnly = false;
+                        if (isTensor(*operand) && !sameShape(*node, *operand) &&
+                            node->getType() != OpType::STORE) {
+                            source.rowMajor = true;
+                            group.rowMajor = true;
+                        }
+                    }
+                    break;
+            }
+        }
+    }
+
+    // Empty if the transpose can become a view of its input
+    static std::string viewReason(const IRNode& transpose, LayoutGroups& groups) {
+        if (!swapsLastTwo(transpose)) {
+            return "it permutes more than the last two dimensions";
+        }
+        const ValueId input = transpose.getInputs()[0];
+        if (groups.find(input) == groups.find(transpose.getId())) {
+            return "its result must share a layout with its input";
+        }
+        LayoutGroups::Group& group = groups.get(transpose.getId());
+        if (group.rowMajor) {
+            return "its result must be row-major";
+        }
+        Layout source = groups.resolve(input);
+        if (source == Layout::TILED) {
+            return "its input is tiled";
+        }
+        Layout view = source == Layout::ROW_MAJOR ? Layout::COL_MAJOR : Layout::ROW_MAJOR;
+        if (group.decided && group.layout != view) {
+            return "its result is already " + std::string(layoutName(group.layout));
+        }
+        return "";
+    }
+};
+
+std::unique_ptr<Pass> createLayoutAssignmentPass() {
+    return std::make_unique<LayoutAssignmentPass>();
+}
+
+} // namespace compiler_sim
\ No newline at end of file
@@ -0,0 +1,229 @@
+#include "compiler_sim/PassManager.h"
+#include "compiler_sim/IRNode.h"
+#include "compiler_sim/KernelPlan.h"
+#include <unordered_set>
+
+namespace compiler_sim {
+
+namespace {
+
+// Addresses, indices and loop counters, as for matmul kernels
+const uint32_t kBaseRegisters = 16;
+
+// Per-iteration resources of a loop body run by one thread: one element of
+// each tensor it loads or stores staged in shared memory, and one register
+// per value it computes
+struct LoopFootprint {
+    uint32_t sharedBytes = 0;
+    uint32_t registers = kBaseRegisters;
+};
+
+void measureRegion(const IRModule& module, const std::vector<ValueId>& region,
+                   std::unordered_set<ValueId>& tensors, LoopFootprint& footprint) {
+    for (ValueId id : region) {
+        const IRNode* node = module.getNode(id);
+        switch (node->getType()) {
+            case OpType::LOOP:
+            case OpType::BLOCK:
+                measureRegion(module, node->getRegion(), tensors, footprint);
+                continue;
+            case OpType::LOAD:
+            case OpType::STORE:
+                for (size_t i = 0; i < node->getInputs().size(); ++i) {
+                    const IRNode* operand = node->getInput(i);
+                    if (operand->getType() == OpType::ALLOC && tensors.insert(operand->getId()).second) {
+                        const TensorType* type = operand->getTensorType();
+                        footprint.sharedBytes += static_cast<uint32_t>(
+                            type ? getElementSize(type->getDataType()) : sizeof(float));
+                    }
+                }
+                break;
+            default:
+                break;
+        }
+        if (node->getType() != OpType::STORE) {
+            ++footprint.registers;
+        }
+    }
+}
+
+} // namespace
+
+// Tiles kernels for the device. Each matmul without a tile gets the one
+// selectMatmulTile estimates fastest among those that fit the device's
+// shared memory, registers and threads (tile_m, tile_n, tile_k). Each
+// top-level loop is strip-mined into a loop over tiles, one block each,
+// holding a point loop over the tile's iterations, one thread each; the
+// tile size is the one that keeps the most threads resident. Runs after
+// unrolling, which leaves tiled loops alone, and before MemoryMapPass,
+// which plans memory for the chosen tiles.
+class LoopTilingPass : public Pass {
+public:
+    LoopTilingPass(DeviceInfo device, const CostModelParams& params)
+        : device_(std::move(device)), params_(params) {}
+
+    std::string getName() const override {
+        return "LoopTilingPass";
+    }
+
+    std::string getOptions() const override {
+        return device_.describe() +
+               " flops=" + std::to_string(params_.flopsPerCycle) +
+               " bytes=" + std::to_string(params_.bytesPerCycle) +
+               " launch=" + std::to_string(params_.launchCycles);
+    }
+
+    bool isFunctionLocal() const override {
+        return true;
+    }
+
+    PreservedAnalyses run(IRModule& module,
+                          AnalysisManager&,
+                          DebugInfo& debugInfo) override {
+        bool tiledLoops = false;
+        for (ValueId id : module.getBody()) {
+            IRNode* node = module.getNode(id);
+            if (node->getType() == OpType::MATMUL) {
+                tileMatmul(node, debugInfo);
+            } else if (node->getType() == OpType::LOOP) {
+                tiledLoops |= tileLoop(module, node, debugInfo);
+            }
+        }
+        // Matmul tiles are only attributes
+        return tiledLoops ? PreservedAnalyses::none() : PreservedAnalyses::all();
+    }
+
+private:
+    void tileMatmul(IRNode* node, DebugInfo& debugInfo) const {
+        IRContext& context = node->getModule().getContext();
+        const AttrKey tileMKey = context.getAttrKey("tile_m");
+        MatmulShape shape;
+        if (node->hasAttribute(tileMKey) || node->hasAttribute(context.getAttrKey("tile_size")) ||
+            !getMatmulShape(*node, shape)) {
+            return;
+        }
+        size_t elementSize = getElementSize(node->getTensorType()->getDataType());
+        MatmulTile tile = selectMatmulTile(shape, elementSize, device_, params_);
+        node->setAttribute(tileMKey, static_cast<int>(tile.m));
+        node->setAttribute(context.getAttrKey("tile_n"), static_cast<int>(tile.n));
+        node->setAttribute(context.getAttrKey("tile_k"), static_cast<int>(tile.k));
+        
+        double cycles = estimateMatmulCycles(
+            shape, planMatmul(tile, elementSize, device_, shape.transposeB, shape.accumulatorSize),
+            device_, params_);
+        debugInfo.recordTransformation(
+            "Tiled " + node->getName() + " (" + describeShape(shape) + ") with " +
+            std::to_string(tile.m) + "x" + std::to_string(tile.n) + "x" +
+            std::to_string(tile.k) + " tiles, estimated " +
+            std::to_string(static_cast<int64_t>(cycles)) + " cycles"
+        );
+    }
+
+    // Rewrites `loop` in place into the loop over tiles
+    bool tileLoop(IRModule& module, IRNode* loop, DebugInfo& debugInfo) const {
+        IRContext& context = module.getContext();
+        const AttrKey startKey = context.getAttrKey("start");
+        const AttrKey endKey = context.getAttrKey("end");
+        const AttrKey stepKey = context.getAttrKey("step");
+        const AttrKey tileKey = context.getAttrKey("tile_size");
+        if (loop->hasAttribute(tileKey)) {
+            return false;
+        }
+        
+        int64_t start = loop->getAttribute<int>(startKey);
+        int64_t end = loop->getAttribute<int>(endKey);
+        int64_t step = loop->getAttribute<int>(stepKey);
+        if (step <= 0) {
+            throw std::runtime_error("Loop " + loop->getName() + " has non-positive step");
+        }
+        int64_t tripCount = end > start ? (end - start + step - 1) / step : 0;
+        // A single warp gains nothing from tiling
+        if (tripCount <= device_.warpSize) {
+            return false;
+        }
+        
+        std::unordered_set<ValueId> tensors;
+        LoopFootprint footprint;
+        measureRegion(module, loop->getRegion(), tensors, footprint);
+        if (footprint.registers > device_.maxRegistersPerThread) {
+            debugInfo.recordTransformation(
+                "Not tiling loop " + loop->getName() + ": its body needs " +
+                std::to_string(footprint.registers) + " registers per thread");
+            return false;
+        }
+        
+        // Most threads resident, then most SMs busy, then fewer blocks
+        int64_t tileSize = 0;
+        int64_t bestResident = 0;
+        int64_t bestActiveSMs = 0;
+        for (int64_t threads = device_.warpSize; threads <= device_.maxThreadsPerBlock;
+             threads *= 2) {
+            if (threads > device_.warpSize && threads / 2 >= tripCount) {
+                break;
+            }
+            Occupancy occupancy = computeOccupancy(
+                device_, static_cast<uint32_t>(threads),
+                static_cast<uint32_t>(threads * footprint.sharedBytes), footprint.registers);
+            if (occupancy.blocksPerSM == 0) {
+                continue;
+            }
+            int64_t blocks = (tripCount + threads - 1) / threads;
+            int64_t resident = std::min<int64_t>(
+                std::min<int64_t>(blocks, int64_t(device_.numSMs) * occupancy.blocksPerSM) * threads,
+                tripCount);
+            int64_t activeSMs = std::min<int64_t>(blocks, device_.numSMs);
+            if (resident > bestResident ||
+                (resident == bestResident && activeSMs >= bestActiveSMs)) {
+                tileSize = threads;
+                bestResident = resident;
+                bestActiveSMs = activeSMs;
+            }
+        }
+        if (tileSize == 0) {
+            return false;
+        }
+        int64_t numTiles = (tripCount + tileSize - 1) / tileSize;
+        
+        // The point loop counts from the tile's first iteration. When the
+        // tiles overrun the loop, iterations from guard_end on are skipped.
+        IRNode* point = module.createNode(OpType::LOOP, loop->getNameId());
+        point->setAttribute(startKey, 0);
+        point->setAttribute(endKey, static_cast<int>(tileSize * step));
+        point->setAttribute(stepKey, static_cast<int>(step));
+        if (tripCount % tileSize != 0) {
+            point->setAttribute(context.getAttrKey("guard_end"), static_cast<int>(end));
+        }
+        point->setRegion(loop->getRegion());
+        
+        loop->setRegion({point->getId()});
+        loop->setAttribute(stepKey, static_cast<int>(tileSize * step));
+        loop->setAttribute(tileKey, static_cast<int>(tileSize));
+        loop->setAttribute(context.getAttrKey("block_threads"), static_cast<int>(tileSize));
+        loop->setAttribute(context.getAttrKey("grid_blocks"), static_cast<int>(numTiles));
+        
+        debugInfo.recordTransformation(
+            "Tiled loop " + loop->getName() + ": " + std::to_string(tileSize) +
+            " iterations per block, " + std::to_string(numTiles) + " blocks"
+        );
+        return true;
+    }
+
+    static std::string describeShape(const MatmulShape& shape) {
+        std::string result;
+        if (shape.batch != 1) {
+            result = std::to_string(shape.batch) + "x";
+        }
+        return result + std::to_string(shape.m) + "x" + std::to_string(shape.n) +
+               "x" + std::to_string(shape.k);
+    }
+
+    DeviceInfo device_;
+    CostModelParams params_;
+};
+
+std::unique_ptr<Pass> createLoopTilingPass(const DeviceInfo& device,
+                                           const CostModelParams& params) {
+    return std::make_unique<LoopTilingPass>(device, params);
+}
+
+} // namespace compiler_sim
\ No newline at end of file
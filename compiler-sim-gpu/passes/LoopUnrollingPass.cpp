@@ -4,56 +4,223 @@
 
 namespace compiler_sim {
 
+// Unrolls LOOP nodes symbolically. A loop over [start, end) is rewritten
+// into a main loop whose step is multiplied by the unroll factor and whose
+// region holds one BLOCK per unrolled copy of the body (tagged with its
+// iteration_offset), followed by a remainder loop for the leftover
+// iterations. Loops with at most fullUnrollThreshold iterations are
+// replaced by one BLOCK per iteration instead; longer loops tagged with
+// unroll_factor (by AutotunePass) use that factor. The IR grows with body
+// size times the unroll factor, never with the trip count. New nodes reuse
+// the loop's interned name; the printer tells them apart.
 class LoopUnrollingPass : public Pass {
 public:
-    LoopUnrollingPass(int unrollFactor) : unrollFactor_(unrollFactor) {}
-    
+    LoopUnrollingPass(int unrollFactor, int fullUnrollThreshold)
+        : unrollFactor_(unrollFactor), fullUnrollThreshold_(fullUnrollThreshold) {}
+
     std::string getName() const override {
         return "LoopUnrollingPass";
     }
-    
-    void run(std::vector<std::shared_ptr<IRNode>>& nodes,
-            DebugInfo& debugInfo) override {
-        
-        std::vector<std::shared_ptr<IRNode>> newNodes;
-        
-        for (auto& node : nodes) {
-            if (node->getType() == OpType::LOOP) {
-                // Simulate loop unrolling
+
+    bool isFunctionLocal() const override {
+        return true;
+    }
+
+    std::string getOptions() const override {
+        return "factor=" + std::to_string(unrollFactor_) +
+               " full=" + std::to_string(fullUnrollThreshold_);
+    }
+
+    PreservedAnalyses run(IRModule& module,
+                          AnalysisManager& analyses,
+                          DebugInfo& debugInfo) override;
+
+private:
+    int unrollFactor_;
+    int fullUnrollThreshold_;
+};
+
+namespace {
+
+// State for one run, so a single pass instance can unroll several
+// functions concurrently
+class LoopUnroller {
+public:
+    LoopUnroller(IRContext& context, int unrollFactor, int fullUnrollThreshold)
+        : unrollFactor_(unrollFactor), fullUnrollThreshold_(fullUnrollThreshold),
+          startKey_(context.getAttrKey("start")),
+          endKey_(context.getAttrKey("end")),
+          stepKey_(context.getAttrKey("step")),
+          iterationKey_(context.getAttrKey("iteration")),
+          offsetKey_(context.getAttrKey("iteration_offset")),
+          unrolledKey_(context.getAttrKey("unrolled")),
+          factorKey_(context.getAttrKey("unroll_factor")),
+          tileKey_(context.getAttrKey("tile_size")) {}
+
+    // True once any loop, at any depth, has been rewritten
+    bool madeChanges() const { return madeChanges_; }
+
+    // Unrolls every loop in `region`, innermost first. Returns true if the
+    // region itself changed.
+    bool unrollRegion(IRModule& module, std::vector<ValueId>& region, DebugInfo& debugInfo) {
+        bool changed = false;
+        std::vector<ValueId> newRegion;
+        newRegion.reserve(region.size());
+
+        for (ValueId id : region) {
+            IRNode* node = module.getNode(id);
+            // Tiled loops are laid out for their launch; leave them be
+            if (node->getType() != OpType::LOOP || node->isErased() ||
+                node->hasAttribute(unrolledKey_) || node->hasAttribute(tileKey_)) {
+                newRegion.push_back(id);
+                continue;
+            }
+
+            std::vector<ValueId> loopBody = node->getRegion();
+            if (unrollRegion(module, loopBody, debugInfo)) {
+                node->setRegion(std::move(loopBody));
+            }
+
+            // Bounds are widened so trip counts near INT_MAX don't overflow
+            int64_t start = node->getAttribute<int>(startKey_);
+            int64_t end = node->getAttribute<int>(endKey_);
+            int64_t step = node->getAttribute<int>(stepKey_);
+            if (step <= 0) {
+                throw std::runtime_error("Loop " + node->getName() + " has non-positive step");
+            }
+            int64_t tripCount = end > start ? (end - start + step - 1) / step : 0;
+            const AttributeValue* tuned = node->findAttribute(factorKey_);
+            int factor = tuned ? std::get<int>(*tuned) : unrollFactor_;
+
+            if (tripCount <= fullUnrollThreshold_) {
+                debugInfo.recordTransformation(
+                    "Fully unrolling loop " + node->getName() +
+                    " (" + std::to_string(tripCount) + " iterations)");
+                fullyUnroll(module, node, start, step, tripCount, newRegion);
+                changed = true;
+                madeChanges_ = true;
+            } else if (factor > 1) {
                 debugInfo.recordTransformation(
-                    "Unrolling loop " + node->getName() + 
-                    " by factor " + std::to_string(unrollFactor_));
-                
-                // Get loop bounds
-                int start = node->getAttribute<int>("start");
-                int end = node->getAttribute<int>("end");
-                int step = node->getAttribute<int>("step");
-                
-                // Create unrolled iterations
-                for (int i = start; i < end; i += step * unrollFactor_) {
-                    for (int j = 0; j < unrollFactor_ && i + j * step < end; j++) {
-                        auto unrolled = std::make_shared<IRNode>(
-                            OpType::BLOCK, 
-                            node->getName() + "_unroll_" + std::to_string(i + j * step)
-                        );
-                        unrolled->setAttribute("iteration", i + j * step);
-                        newNodes.push_back(unrolled);
-                    }
+                    "Unrolling loop " + node->getName() +
+                    " by factor " + std::to_string(factor));
+                newRegion.push_back(id);
+                madeChanges_ = true;
+                if (IRNode* remainder = partiallyUnroll(module, node, start, step, tripCount,
+                                                        factor)) {
+                    newRegion.push_back(remainder->getId());
+                    changed = true;
                 }
             } else {
-                newNodes.push_back(node);
+                newRegion.push_back(id);
             }
         }
-        
-        nodes = std::move(newNodes);
+
+        if (changed) {
+            region = std::move(newRegion);
+        }
+        return changed;
     }
-    
+
 private:
-    int unrollFactor_;
+    // One BLOCK per iteration, each with its own copy of the body
+    void fullyUnroll(IRModule& module, IRNode* loop, int64_t start, int64_t step,
+                     int64_t tripCount, std::vector<ValueId>& out) {
+        const std::vector<ValueId>& body = loop->getRegion();
+        for (int64_t i = 0; i < tripCount; ++i) {
+            int64_t iteration = start + i * step;
+            IRNode* block = module.createNode(OpType::BLOCK, loop->getNameId());
+            block->setAttribute(iterationKey_, static_cast<int>(iteration));
+
+            // The first copy reuses the original body
+            if (i == 0) {
+                block->setRegion(body);
+            } else {
+                IRMapping mapping;
+                for (ValueId member : body) {
+                    block->appendToRegion(module.getNode(member)->clone(mapping));
+                }
+            }
+            out.push_back(block->getId());
+        }
+        loop->setRegion({});
+        if (loop->useEmpty()) {
+            loop->erase();
+        }
+    }
+
+    // Rewrites `loop` in place into the unrolled main loop and returns the
+    // remainder loop, or null if the trip count divides evenly
+    IRNode* partiallyUnroll(IRModule& module, IRNode* loop, int64_t start, int64_t step,
+                            int64_t tripCount, int64_t factor) {
+        const int64_t mainEnd = start + (tripCount / factor) * factor * step;
+        const int64_t end = loop->getAttribute<int>(endKey_);
+        const std::vector<ValueId> body = loop->getRegion();
+
+        std::vector<ValueId> unrolled;
+        unrolled.reserve(factor);
+        for (int64_t j = 0; j < factor; ++j) {
+            IRNode* block = module.createNode(OpType::BLOCK, loop->getNameId());
+            block->setAttribute(offsetKey_, static_cast<int>(j * step));
+            if (j == 0) {
+                block->setRegion(body);
+            } else {
+                IRMapping mapping;
+                for (ValueId member : body) {
+                    block->appendToRegion(module.getNode(member)->clone(mapping));
+                }
+            }
+            unrolled.push_back(block->getId());
+        }
+
+        loop->setRegion(std::move(unrolled));
+        loop->setAttribute(endKey_, static_cast<int>(mainEnd));
+        loop->setAttribute(stepKey_, static_cast<int>(step * factor));
+        loop->setAttribute(unrolledKey_, static_cast<int>(factor));
+
+        if (mainEnd >= end) {
+            return nullptr;
+        }
+
+        // Leftover iterations run the original body at the original step
+        IRNode* remainder = module.createNode(OpType::LOOP, loop->getNameId());
+        remainder->setAttribute(startKey_, static_cast<int>(mainEnd));
+        remainder->setAttribute(endKey_, static_cast<int>(end));
+        remainder->setAttribute(stepKey_, static_cast<int>(step));
+        remainder->setAttribute(unrolledKey_, 1);
+        IRMapping mapping;
+        for (ValueId member : body) {
+            remainder->appendToRegion(module.getNode(member)->clone(mapping));
+        }
+        return remainder;
+    }
+
+    const int unrollFactor_;
+    const int fullUnrollThreshold_;
+    const AttrKey startKey_;
+    const AttrKey endKey_;
+    const AttrKey stepKey_;
+    const AttrKey iterationKey_;
+    const AttrKey offsetKey_;
+    const AttrKey unrolledKey_;
+    const AttrKey factorKey_;
+    const AttrKey tileKey_;
+    bool madeChanges_ = false;
 };
 
-std::unique_ptr<Pass> createLoopUnrollingPass(int unrollFactor) {
-    return std::make_unique<LoopUnrollingPass>(unrollFactor);
+} // namespace
+
+PreservedAnalyses LoopUnrollingPass::run(IRModule& module, AnalysisManager&,
+                                         DebugInfo& debugInfo) {
+    LoopUnroller unroller(module.getContext(), unrollFactor_, fullUnrollThreshold_);
+    std::vector<ValueId> body = module.getBody();
+    if (unroller.unrollRegion(module, body, debugInfo)) {
+        module.getBody() = std::move(body);
+    }
+    return unroller.madeChanges() ? PreservedAnalyses::none() : PreservedAnalyses::all();
+}
+
+std::unique_ptr<Pass> createLoopUnrollingPass(int unrollFactor, int fullUnrollThreshold) {
+    return std::make_unique<LoopUnrollingPass>(unrollFactor, fullUnrollThreshold);
 }
 
 } // namespace compiler_sim
\ No newline at end of file
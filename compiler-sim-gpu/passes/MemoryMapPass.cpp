@@ -1,74 +1,422 @@
 #include "compiler_sim/PassManager.h"
 #include "compiler_sim/IRNode.h"
-#include <unordered_map>
+#include "compiler_sim/Analyses.h"
+#include "compiler_sim/DeviceInfo.h"
+#include "compiler_sim/KernelPlan.h"
+#include <algorithm>
+#include <map>
+#include <queue>
+#include <set>
 
 namespace compiler_sim {
 
+namespace {
+
+const size_t kAlignment = 256; // GPU memory alignment
+
+size_t alignUp(size_t value) {
+    return (value + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+struct Buffer {
+    ValueId id;
+    size_t size;
+    // Body positions over which the contents must survive, inclusive
+    uint32_t start;
+    uint32_t end;
+    size_t offset = 0;
+};
+
+// Whether `user` reads or writes `buffer`. Outputs are written, and so is
+// the destination of a store (every input after the value); any other
+// input is read.
+void classifyAccess(const IRNode* user, ValueId buffer, bool& reads, bool& writes) {
+    const std::vector<ValueId>& inputs = user->getInputs();
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        if (inputs[i] == buffer) {
+            (user->getType() == OpType::STORE && i > 0 ? writes : reads) = true;
+        }
+    }
+    for (ValueId output : user->getOutputs()) {
+        if (output == buffer) {
+            writes = true;
+        }
+    }
+}
+
+// Narrows the live interval of an allocation to when its contents matter.
+// An op that writes the buffer also hands its contents on as its result,
+// so uses of that result read the buffer too. A buffer read before
+// anything writes it is filled by the host, so it is live from entry; one
+// whose last access may write it holds a result, as does one never
+// accessed, so it is live to exit. Everything else is an intermediate,
+// live from its first write to its last read.
+Buffer computeLifetime(const IRModule& module, ValueId id,
+                       const DefUseAnalysis::Result& defUse,
+                       const LivenessAnalysis::Result& liveness) {
+    const uint32_t lastPosition = static_cast<uint32_t>(defUse.getNumPositions() - 1);
+    const LivenessAnalysis::Interval& interval = liveness.getInterval(id);
+    uint32_t firstRead = DefUseAnalysis::kNotInBody;
+    uint32_t lastRead = 0;
+    uint32_t firstWrite = DefUseAnalysis::kNotInBody;
+    uint32_t lastWrite = 0;
+    bool accessed = false;
+    
+    for (ValueId user : module.getNode(id)->getUsers()) {
+        uint32_t position = defUse.getPosition(user);
+        if (position == DefUseAnalysis::kNotInBody) {
+            continue;
+        }
+        bool reads = false;
+        bool writes = false;
+        classifyAccess(module.getNode(user), id, reads, writes);
+        if (reads) {
+            firstRead = std::min(firstRead, position);
+            lastRead = std::max(lastRead, position);
+        }
+        if (writes) {
+            firstWrite = std::min(firstWrite, position);
+            lastWrite = std::max(lastWrite, position);
+            for (uint32_t use : defUse.getUsePositions(user)) {
+                lastRead = std::max(lastRead, use);
+            }
+        }
+        accessed = accessed || reads || writes;
+    }
+    
+    Buffer buffer{id, 0, interval.start, interval.end};
+    if (firstRead <= firstWrite) {
+        buffer.start = 0;
+    } else {
+        buffer.start = std::max(buffer.start, firstWrite);
+    }
+    if (!accessed || (firstWrite != DefUseAnalysis::kNotInBody && lastWrite >= lastRead)) {
+        buffer.end = lastPosition;
+    } else {
+        buffer.end = std::max(buffer.end, lastRead);
+    }
+    return buffer;
+}
+
+// Best-fit allocator over aligned blocks. Freed blocks are coalesced with
+// their neighbours; an allocation takes the smallest free block it fits
+// in, else extends the arena, reusing a free block at its end if any.
+class Arena {
+public:
+    size_t allocate(size_t size) {
+        auto fit = freeBySize_.lower_bound({size, 0});
+        if (fit != freeBySize_.end()) {
+            auto [blockSize, offset] = *fit;
+            removeFree(offset, blockSize);
+            if (blockSize > size) {
+                addFree(offset + size, blockSize - size);
+            }
+            return offset;
+        }
+        size_t offset = top_;
+        if (!freeByOffset_.empty()) {
+            auto last = std::prev(freeByOffset_.end());
+            if (last->first + last->second == top_) {
+                offset = last->first;
+                removeFree(last->first, last->second);
+            }
+        }
+        top_ = offset + size;
+        peak_ = std::max(peak_, top_);
+        return offset;
+    }
+    
+    void release(size_t offset, size_t size) {
+        auto next = freeByOffset_.lower_bound(offset);
+        if (next != freeByOffset_.end() && offset + size == next->first) {
+            size += next->second;
+            removeFree(next->first, next->second);
+        }
+        auto prev = freeByOffset_.lower_bound(offset);
+        if (prev != freeByOffset_.begin()) {
+            --prev;
+            if (prev->first + prev->second == offset) {
+                offset = prev->first;
+                size += prev->second;
+                removeFree(prev->first, prev->second);
+            }
+        }
+        addFree(offset, size);
+    }
+    
+    size_t getPeak() const { return peak_; }
+    
+private:
+    void addFree(size_t offset, size_t size) {
+        freeByOffset_.emplace(offset, size);
+        freeBySize_.emplace(size, offset);
+    }
+    
+    void removeFree(size_t offset, size_t size) {
+        freeByOffset_.erase(offset);
+        freeBySize_.erase({size, offset});
+    }
+    
+    std::map<size_t, size_t> freeByOffset_;
+    std::set<std::pair<size_t, size_t>> freeBySize_;
+    size_t top_ = 0;
+    size_t peak_ = 0;
+};
+
+// Assigns offsets in order of first position, releasing each buffer after
+// its last one, so only buffers with overlapping lifetimes are kept apart.
+// Returns the peak footprint.
+size_t packBuffers(std::vector<Buffer>& buffers) {
+    std::vector<size_t> order(buffers.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return buffers[a].start < buffers[b].start;
+    });
+    
+    Arena arena;
+    // Earliest end first
+    auto laterEnd = [&](size_t a, size_t b) { return buffers[a].end > buffers[b].end; };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(laterEnd)> live(laterEnd);
+    for (size_t index : order) {
+        Buffer& buffer = buffers[index];
+        while (!live.empty() && buffers[live.top()].end < buffer.start) {
+            const Buffer& dead = buffers[live.top()];
+            arena.release(dead.offset, alignUp(dead.size));
+            live.pop();
+        }
+        if (buffer.size == 0) {
+            continue;
+        }
+        buffer.offset = arena.allocate(alignUp(buffer.size));
+        live.push(index);
+    }
+    return arena.getPeak();
+}
+
+const int kDefaultTileSize = 32;
+
+// Bytes a tensor occupies in its layout: a tiled tensor is stored as
+// whole blocks, so partial blocks at its edges are padded out
+uint64_t storageBytes(const TensorType& type) {
+    if (type.getLayout() != Layout::TILED || type.getRank() < 2) {
+        return type.getByteSize();
+    }
+    const std::vector<int64_t>& dims = type.getShape();
+    uint64_t elements = 1;
+    for (size_t i = 0; i < dims.size(); ++i) {
+        int64_t dim = dims[i];
+        if (i + 2 >= dims.size()) {
+            dim = (dim + kLayoutTileSize - 1) / kLayoutTileSize * kLayoutTileSize;
+        }
+        elements *= static_cast<uint64_t>(dim);
+    }
+    return elements * getElementSize(type.getDataType());
+}
+
+} // namespace
+
+// Places every top-level allocation in one global-memory arena, sized for
+// its layout. Buffers whose lifetimes don't overlap may share memory, so
+// the footprint is the peak of live buffers rather than their sum. Each
+// matmul kernel also gets its operand tiles placed in shared memory and
+// its accumulators in registers, and is checked against the device's
+// per-block limits and occupancy, so a kernel that cannot launch fails
+// here rather than in simulation.
 class MemoryMapPass : public Pass {
 public:
+    explicit MemoryMapPass(DeviceInfo device) : device_(std::move(device)) {}
+    
     std::string getName() const override {
         return "MemoryMapPass";
     }
     
-    void run(std::vector<std::shared_ptr<IRNode>>& nodes,
-            DebugInfo& debugInfo) override {
-        
-        size_t currentOffset = 0;
-        const size_t alignment = 256; // GPU memory alignment
+    std::string getOptions() const override {
+        return device_.describe();
+    }
+    
+    bool isFunctionLocal() const override {
+        return true;
+    }
+    
+    PreservedAnalyses run(IRModule& module,
+                          AnalysisManager& analyses,
+                          DebugInfo& debugInfo) override {
+        const ShapeInfoAnalysis::Result& shapes = analyses.getResult<ShapeInfoAnalysis>(module);
+        const DefUseAnalysis::Result& defUse = analyses.getResult<DefUseAnalysis>(module);
+        const LivenessAnalysis::Result& liveness = analyses.getResult<LivenessAnalysis>(module);
         
-        std::unordered_map<std::string, size_t> memoryMap;
+        IRContext& context = module.getContext();
+        const AttrKey offsetKey = context.getAttrKey("memory_offset");
+        const AttrKey sizeKey = context.getAttrKey("memory_size");
+        const AttrKey spaceKey = context.getAttrKey("memory_space");
+        const AttrKey loweredFromKey = context.getAttrKey("lowered_from");
         
-        for (auto& node : nodes) {
+        std::vector<Buffer> buffers;
+        size_t naiveBytes = 0;
+        for (ValueId id : module.getBody()) {
+            IRNode* node = module.getNode(id);
             if (node->getType() == OpType::ALLOC) {
-                // Calculate memory size
-                auto shape = node->getAttribute<std::vector<int>>("shape");
-                auto dtype = node->getAttribute<std::string>("dtype");
-                
-                size_t elementSize = 4; // f32 by default
-                if (dtype == "f16") elementSize = 2;
-                else if (dtype == "f64") elementSize = 8;
-                
-                size_t totalElements = 1;
-                for (int dim : shape) {
-                    totalElements *= dim;
-                }
-                
-                size_t memorySize = totalElements * elementSize;
-                
-                // Align to GPU requirements
-                if (currentOffset % alignment != 0) {
-                    currentOffset = ((currentOffset / alignment) + 1) * alignment;
+                if (!shapes.getType(id)) {
+                    throw std::runtime_error("Untyped allocation: " + node->getName());
                 }
                 
-                // Record mapping
-                memoryMap[node->getName()] = currentOffset;
-                node->setAttribute("memory_offset", static_cast<int>(currentOffset));
-                node->setAttribute("memory_size", static_cast<int>(memorySize));
-                
-                debugInfo.recordMemoryMapping(
-                    node->getName(),
-                    currentOffset,
-                    memorySize
-                );
-                
-                debugInfo.recordTransformation(
-                    "Mapped tensor " + node->getName() + 
-                    " to offset " + std::to_string(currentOffset) +
-                    " (size: " + std::to_string(memorySize) + " bytes)"
-                );
-                
-                currentOffset += memorySize;
+                Buffer buffer = computeLifetime(module, id, defUse, liveness);
+                buffer.size = storageBytes(*shapes.getType(id));
+                naiveBytes += alignUp(buffer.size);
+                buffers.push_back(buffer);
             }
         }
         
+        size_t peakBytes = packBuffers(buffers);
+        
+        // Reported in body order
+        uint64_t precisionSaved = 0;
+        for (const Buffer& buffer : buffers) {
+            IRNode* node = module.getNode(buffer.id);
+            node->setAttribute(offsetKey, static_cast<int64_t>(buffer.offset));
+            node->setAttribute(sizeKey, static_cast<int64_t>(buffer.size));
+            node->setAttribute(spaceKey, std::string(getMemorySpaceName(MemorySpace::GLOBAL)));
+            
+            debugInfo.recordMemoryMapping(
+                node->getName(),
+                buffer.offset,
+                buffer.size
+            );
+            
+            const TensorType* type = node->getTensorType();
+            std::string layout;
+            if (type->getLayout() != Layout::ROW_MAJOR) {
+                layout = std::string(", ") + layoutName(type->getLayout());
+            }
+            // Tensors lowered by MixedPrecisionPass: what the wider type took
+            if (const AttributeValue* from = node->findAttribute(loweredFromKey)) {
+                const std::string& wide = std::get<std::string>(*from);
+                const TensorType* wideType = context.getTensorType(
+                    type->getShape(), parseDataType(wide), type->getLayout());
+                precisionSaved += storageBytes(*wideType) - buffer.size;
+                layout += std::string(", ") + dataTypeName(type->getDataType()) + " from " + wide;
+            }
+            debugInfo.recordTransformation(
+                "Mapped tensor " + node->getName() + 
+                " to offset " + std::to_string(buffer.offset) +
+                " (size: " + std::to_string(buffer.size) + " bytes" + layout + ")"
+            );
+        }
+        
+        std::string precision;
+        if (precisionSaved != 0) {
+            precision = "; precision lowering saved " + std::to_string(precisionSaved) + " bytes";
+            debugInfo.addPassCounter("precision_bytes_saved", precisionSaved);
+        }
         debugInfo.recordTransformation(
-            "Total memory allocated: " + std::to_string(currentOffset) + " bytes"
+            "Total memory allocated: " + std::to_string(peakBytes) +
+            " bytes (without reuse: " + std::to_string(naiveBytes) + " bytes" + precision + ")"
         );
+        if (peakBytes > device_.globalMemoryBytes) {
+            throw std::runtime_error(
+                "Memory plan needs " + std::to_string(peakBytes) + " bytes of global memory; " +
+                device_.name + " has " + std::to_string(device_.globalMemoryBytes));
+        }
+        
+        for (ValueId id : module.getBody()) {
+            IRNode* node = module.getNode(id);
+            if (node->getType() == OpType::MATMUL) {
+                planKernel(node, debugInfo);
+            }
+        }
+        
+        // Only attributes were added
+        return PreservedAnalyses::all();
     }
+    
+private:
+    // Uses the tile_m/tile_n/tile_k chosen by LoopTilingPass, or a square
+    // tile_size (default 32) when the kernel was not tiled
+    void planKernel(IRNode* node, DebugInfo& debugInfo) const {
+        IRContext& context = node->getModule().getContext();
+        const AttrKey tileMKey = context.getAttrKey("tile_m");
+        const AttrKey tileNKey = context.getAttrKey("tile_n");
+        const AttrKey tileKKey = context.getAttrKey("tile_k");
+        int tileM, tileN, tileK;
+        if (node->hasAttribute(tileMKey)) {
+            tileM = node->getAttribute<int>(tileMKey);
+            tileN = node->getAttribute<int>(tileNKey);
+            tileK = node->getAttribute<int>(tileKKey);
+        } else {
+            const AttrKey tileKey = context.getAttrKey("tile_size");
+            int tileSize = node->hasAttribute(tileKey) ? node->getAttribute<int>(tileKey)
+                                                       : kDefaultTileSize;
+            node->setAttribute(tileKey, tileSize);
+            tileM = tileN = tileK = tileSize;
+        }
+        if (tileM <= 0 || tileN <= 0 || tileK <= 0) {
+            throw std::runtime_error("Kernel " + node->getName() + " has a non-positive tile size");
+        }
+        const TensorType* type = node->getTensorType();
+        size_t elementSize = type ? getElementSize(type->getDataType()) : sizeof(float);
+        MatmulTile tile{static_cast<uint32_t>(tileM), static_cast<uint32_t>(tileN),
+                        static_cast<uint32_t>(tileK)};
+        MatmulShape shape;
+        const bool typed = getMatmulShape(*node, shape);
+        const bool transposeB = typed && shape.transposeB;
+        KernelPlan plan = planMatmul(tile, elementSize, device_, transposeB,
+                                     typed ? shape.accumulatorSize : 0);
+        
+        const std::string& name = node->getName();
+        if (plan.sharedBytes > device_.sharedMemoryPerBlock) {
+            throw std::runtime_error(
+                "Kernel " + name + " needs " + std::to_string(plan.sharedBytes) +
+                " bytes of shared memory per block; " + device_.name + " allows " +
+                std::to_string(device_.sharedMemoryPerBlock));
+        }
+        if (plan.registersPerThread > device_.maxRegistersPerThread) {
+            throw std::runtime_error(
+                "Kernel " + name + " needs " + std::to_string(plan.registersPerThread) +
+                " registers per thread; " + device_.name + " allows " +
+                std::to_string(device_.maxRegistersPerThread));
+        }
+        if (plan.occupancy.blocksPerSM == 0) {
+            throw std::runtime_error("Kernel " + name + " cannot launch on " + device_.name +
+                                     " (limited by " + plan.occupancy.limiter + ")");
+        }
+        
+        node->setAttribute(tileMKey, tileM);
+        node->setAttribute(tileNKey, tileN);
+        node->setAttribute(tileKKey, tileK);
+        node->setAttribute(context.getAttrKey("block_threads"),
+                           static_cast<int>(plan.threadsPerBlock));
+        node->setAttribute(context.getAttrKey("shared_memory_bytes"),
+                           static_cast<int64_t>(plan.sharedBytes));
+        node->setAttribute(context.getAttrKey("registers_per_thread"),
+                           static_cast<int>(plan.registersPerThread));
+        node->setAttribute(context.getAttrKey("blocks_per_sm"),
+                           static_cast<int>(plan.occupancy.blocksPerSM));
+        node->setAttribute(context.getAttrKey("occupancy"),
+                           static_cast<float>(plan.occupancy.occupancy));
+        
+        debugInfo.recordMemoryMapping(name + ".tile_a", 0, plan.tileABytes, MemorySpace::SHARED);
+        debugInfo.recordMemoryMapping(name + ".tile_b", plan.tileBOffset, plan.tileBBytes,
+                                      MemorySpace::SHARED);
+        debugInfo.recordMemoryMapping(name + ".acc", 0, plan.accumulatorBytes,
+                                      MemorySpace::REGISTER);
+        debugInfo.recordTransformation(
+            "Planned kernel " + name + ": " + std::to_string(tileM) + "x" +
+            std::to_string(tileN) + "x" + std::to_string(tileK) + " tiles, " +
+            std::to_string(plan.threadsPerBlock) +
+            " threads, " + std::to_string(plan.sharedBytes) + " bytes shared, " +
+            std::to_string(plan.registersPerThread) + " registers/thread, " +
+            std::to_string(plan.occupancy.blocksPerSM) + " blocks/SM (limited by " +
+            plan.occupancy.limiter + ")" + (transposeB ? ", B staged transposed" : "")
+        );
+    }
+    
+    DeviceInfo device_;
 };
 
-std::unique_ptr<Pass> createMemoryMapPass() {
-    return std::make_unique<MemoryMapPass>();
+std::unique_ptr<Pass> createMemoryMapPass(const DeviceInfo& device) {
+    return std::make_unique<MemoryMapPass>(device);
 }
 
 } // namespace compiler_sim
\ No newline at end of file
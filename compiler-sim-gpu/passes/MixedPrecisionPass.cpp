@@ -0,0 +1,269 @@
+#include "compiler_sim/PassManager.h"
+#include "compiler_sim/PatternRewriter.h"
+#include "compiler_sim/IRNode.h"
+#include <algorithm>
+#include <map>
+
+namespace compiler_sim {
+
+namespace {
+
+bool writes(const IRNode& user, ValueId tensor) {
+    return std::find(user.getOutputs().begin(), user.getOutputs().end(), tensor) !=
+           user.getOutputs().end();
+}
+
+bool isF32(const IRNode& node) {
+    return node.getTensorType() && node.getTensorType()->getDataType() == DataType::F32;
+}
+
+// Matmuls and softmax sum many products or exponentials per result
+bool accumulates(OpType type) {
+    return type == OpType::MATMUL || type == OpType::SOFTMAX;
+}
+
+} // namespace
+
+// Retypes the f32 compute the policy allows, and the tensors only that
+// compute writes, to a half-precision type. Casts are inserted where a
+// lowered value meets an f32 one: before the first op that needs them,
+// and after a lowered op that writes an f32 tensor. Casts of constants and
+// cast pairs are then folded, rounding constants to the new type. Ops
+// inside loops and blocks keep their types.
+class MixedPrecisionPass : public Pass {
+public:
+    explicit MixedPrecisionPass(const PrecisionPolicy& policy) : policy_(policy) {}
+
+    std::string getName() const override {
+        return "MixedPrecisionPass";
+    }
+
+    std::string getOptions() const override {
+        std::string options = std::string("target=") + dataTypeName(policy_.target) +
+                              " accumulate=" + accumulatorName() + " ops=";
+        for (OpType type : policy_.ops) {
+            options += std::string(opTypeName(type)) + ",";
+        }
+        options += " pinned=";
+        for (const std::string& name : policy_.pinned) {
+            options += name + ",";
+        }
+        return options;
+    }
+
+    bool isFunctionLocal() const override {
+        return true;
+    }
+
+    PreservedAnalyses run(IRModule& module,
+                          AnalysisManager&,
+                          DebugInfo& debugInfo) override {
+        std::vector<bool> lowered(module.getNumNodes(), false);
+        std::vector<IRNode*> ops;
+        std::vector<IRNode*> tensors;
+        for (ValueId id : module.getBody()) {
+            IRNode* node = module.getNode(id);
+            if (!node->isErased() && lowersOp(*node)) {
+                lowered[id] = true;
+                ops.push_back(node);
+            }
+        }
+        for (ValueId id : module.getBody()) {
+            IRNode* node = module.getNode(id);
+            if (!node->isErased() && lowersTensor(*node, lowered)) {
+                lowered[id] = true;
+                tensors.push_back(node);
+            }
+        }
+        if (ops.empty()) {
+            return PreservedAnalyses::all();
+        }
+
+        IRContext& context = module.getContext();
+        const AttrKey accumulateKey = context.getAttrKey("accumulate");
+        for (IRNode* node : ops) {
+            node->setTensorType(lowerType(context, *node->getTensorType()));
+            std::string note;
+            if (accumulates(node->getType())) {
+                node->setAttribute(accumulateKey, accumulatorName());
+                note = " (accumulate " + accumulatorName() + ")";
+            }
+            debugInfo.recordTransformation("Lowered " + node->getName() + " to " +
+                                           dataTypeName(policy_.target) + note);
+        }
+        const AttrKey loweredFromKey = context.getAttrKey("lowered_from");
+        uint64_t bytesSaved = 0;
+        for (IRNode* node : tensors) {
+            const TensorType* type = node->getTensorType();
+            const TensorType* narrow = lowerType(context, *type);
+            uint64_t saved = type->getByteSize() - narrow->getByteSize();
+            node->setTensorType(narrow);
+            node->setAttribute(loweredFromKey, std::string(dataTypeName(DataType::F32)));
+            bytesSaved += saved;
+            debugInfo.recordTransformation("Lowered tensor " + node->getName() + " to " +
+                                           dataTypeName(policy_.target) + " (saves " +
+                                           std::to_string(saved) + " bytes)");
+        }
+
+        Rebuild rebuild{module, lowered, {}, {}, 0};
+        std::vector<ValueId> body = module.getBody();
+        for (ValueId id : body) {
+            IRNode* node = module.getNode(id);
+            if (node->isErased()) {
+                continue;
+            }
+            if (lowered[id]) {
+                castOperands(*node, rebuild);
+                if (node->getType() != OpType::ALLOC) {
+                    castResult(node, rebuild);
+                    continue;
+                }
+            } else {
+                widenOperands(*node, rebuild);
+            }
+            rebuild.body.push_back(node->getId());
+        }
+        module.getBody() = std::move(rebuild.body);
+
+        RewritePatternSet patterns;
+        populateCastFoldingPatterns(patterns);
+        GreedyRewriteResult folded = applyPatternsGreedily(module, patterns, &debugInfo);
+
+        debugInfo.addPassCounter("bytes_saved", bytesSaved);
+        debugInfo.addPassCounter("casts_inserted", rebuild.castsInserted);
+        debugInfo.addPassCounter("casts_folded", folded.numRewrites);
+        return PreservedAnalyses::none();
+    }
+
+private:
+    // State of one run while the body is rewritten in program order
+    struct Rebuild {
+        IRModule& module;
+        std::vector<bool>& lowered;
+        std::vector<ValueId> body;
+        std::map<std::pair<ValueId, DataType>, IRNode*> casts;
+        uint64_t castsInserted;
+    };
+
+    std::string accumulatorName() const {
+        return dataTypeName(policy_.f32Accumulate ? DataType::F32 : policy_.target);
+    }
+
+    const TensorType* lowerType(IRContext& context, const TensorType& type) const {
+        return context.getTensorType(type.getShape(), policy_.target, type.getLayout());
+    }
+
+    bool lowersOp(const IRNode& node) const {
+        return policy_.ops.count(node.getType()) != 0 && isF32(node) &&
+               policy_.pinned.count(node.getName()) == 0;
+    }
+
+    // A tensor the host never sees, written only by lowered ops
+    bool lowersTensor(const IRNode& tensor, const std::vector<bool>& lowered) const {
+        if (tensor.getType() != OpType::ALLOC || !isF32(tensor) ||
+            policy_.pinned.count(tensor.getName()) != 0 || isHostVisible(tensor)) {
+            return false;
+        }
+        const IRModule& module = tensor.getModule();
+        for (ValueId userId : tensor.getUsers()) {
+            const IRNode* user = module.getNode(userId);
+            if (user->getType() == OpType::LOAD || user->getType() == OpType::STORE ||
+                (writes(*user, tensor.getId()) && !lowered[userId])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static bool isLowered(const Rebuild& rebuild, ValueId id) {
+        return id < rebuild.lowered.size() && rebuild.lowered[id];
+    }
+
+    // The cast of `source` to `dtype`, created before the op being placed
+    // the first time it is needed
+    static IRNode* castOf(IRNode* source, DataType dtype, Rebuild& rebuild) {
+        IRNode*& cast = rebuild.casts[{source->getId(), dtype}];
+        if (!cast) {
+            cast = createCast(rebuild.module, source->getName() + "_" + dataTypeName(dtype),
+                              source, dtype);
+            rebuild.body.push_back(cast->getId());
+            ++rebuild.castsInserted;
+        }
+        return cast;
+    }
+
+    // Lowered ops read f32 operands through a cast; a scale factor is a
+    // scalar multiplier and is left as it is
+    void castOperands(IRNode& node, Rebuild& rebuild) const {
+        for (size_t i = 0; i < node.getInputs().size(); ++i) {
+            IRNode* input = node.getInput(i);
+            if (isF32(*input) && !(node.getType() == OpType::SCALE && i == 1)) {
+                node.setInput(i, castOf(input, policy_.target, rebuild)->getId());
+            }
+        }
+    }
+
+    // Everything else, including ops nested in a loop or block, reads
+    // lowered values through a cast back to f32
+    static void widenOperands(IRNode& node, Rebuild& rebuild) {
+        for (size_t i = 0; i < node.getInputs().size(); ++i) {
+            IRNode* input = node.getInput(i);
+            if (isLowered(rebuild, input->getId())) {
+                node.setInput(i, castOf(input, DataType::F32, rebuild)->getId());
+            }
+        }
+        for (ValueId member : node.getRegion()) {
+            widenOperands(*rebuild.module.getNode(member), rebuild);
+        }
+    }
+
+    // Places a lowered op. One that writes an f32 tensor is replaced by a
+    // copy writing only lowered tensors, followed by a cast that writes
+    // the rest.
+    static void castResult(IRNode* node, Rebuild& rebuild) {
+        std::vector<ValueId> widened;
+        for (ValueId output : node->getOutputs()) {
+            if (!isLowered(rebuild, output)) {
+                widened.push_back(output);
+            }
+        }
+        if (widened.empty()) {
+            rebuild.body.push_back(node->getId());
+            return;
+        }
+        IRModule& module = rebuild.module;
+        IRNode* replacement = module.createNode(node->getType(), node->getNameId());
+        for (ValueId input : node->getInputs()) {
+            replacement->addInput(input);
+        }
+        for (ValueId output : node->getOutputs()) {
+            if (isLowered(rebuild, output)) {
+                replacement->addOutput(output);
+            }
+        }
+        for (const Attribute& attr : node->getAttributes()) {
+            replacement->setAttribute(attr.key, attr.value);
+        }
+        replacement->setTensorType(node->getTensorType());
+        replacement->setDebugLocation(node->getDebugLocation().first,
+                                      node->getDebugLocation().second);
+        node->replaceAllUsesWith(replacement);
+        node->erase();
+        rebuild.lowered.resize(module.getNumNodes(), false);
+        rebuild.lowered[replacement->getId()] = true;
+        rebuild.body.push_back(replacement->getId());
+
+        IRNode* cast = castOf(replacement, DataType::F32, rebuild);
+        for (ValueId output : widened) {
+            cast->addOutput(output);
+        }
+    }
+
+    PrecisionPolicy policy_;
+};
+
+std::unique_ptr<Pass> createMixedPrecisionPass(const PrecisionPolicy& policy) {
+    return std::make_unique<MixedPrecisionPass>(policy);
+}
+
+} // namespace compiler_sim
\ No newline at end of file
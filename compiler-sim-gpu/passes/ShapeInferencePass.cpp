@@ -0,0 +1,265 @@
+#include "compiler_sim/PassManager.h"
+#include "compiler_sim/IRNode.h"
+#include <algorithm>
+
+namespace compiler_sim {
+
+namespace {
+
+// Result shape of elementwise ops on `a` and `b`: dimensions are aligned
+// from the right, and a dimension of 1 stretches to match the other
+bool broadcastShapes(const std::vector<int64_t>& a, const std::vector<int64_t>& b,
+                     std::vector<int64_t>& result) {
+    result.assign(std::max(a.size(), b.size()), 1);
+    for (size_t i = 0; i < result.size(); ++i) {
+        int64_t x = i < a.size() ? a[a.size() - 1 - i] : 1;
+        int64_t y = i < b.size() ? b[b.size() - 1 - i] : 1;
+        if (x != y && x != 1 && y != 1) {
+            return false;
+        }
+        result[result.size() - 1 - i] = x == 1 ? y : x;
+    }
+    return true;
+}
+
+} // namespace
+
+// Derives every compute op's result type from its operands, in program
+// order, so types declared by hand are checked rather than trusted:
+//   matmul     [..., M, K] x [..., K, N] -> [..., M, N], batch dimensions
+//              broadcast, an operand flagged transpose_a/transpose_b is
+//              read transposed; fused epilogue operands broadcast into the
+//              result
+//   add, mul   operands broadcast together
+//   transpose  dimensions permuted by `perm` (default: the last two swap)
+//   scale      the tensor's type; the factor must be a scalar
+//   softmax    the input's type
+//   cast       the input's shape in the declared element type
+// Element types must agree; an op keeps the layout it was declared with,
+// which LayoutAssignmentPass may have chosen. An output tensor without a
+// type takes the inferred one; one declared with a different type is an
+// error, since the kernel would write past it or leave part of it unset.
+// Ops whose operands are untyped are left as they are.
+class ShapeInferencePass : public Pass {
+public:
+    std::string getName() const override {
+        return "ShapeInferencePass";
+    }
+
+    bool isFunctionLocal() const override {
+        return true;
+    }
+
+    PreservedAnalyses run(IRModule& module,
+                          AnalysisManager&,
+                          DebugInfo& debugInfo) override {
+        bool changed = false;
+        inferRegion(module, module.getBody(), debugInfo, changed);
+        return changed ? PreservedAnalyses::none() : PreservedAnalyses::all();
+    }
+
+private:
+    static void inferRegion(IRModule& module, const std::vector<ValueId>& region,
+                            DebugInfo& debugInfo, bool& changed) {
+        for (ValueId id : region) {
+            IRNode* node = module.getNode(id);
+            if (!node->getRegion().empty()) {
+                inferRegion(module, node->getRegion(), debugInfo, changed);
+                continue;
+            }
+            const TensorType* inferred = inferType(*node);
+            if (!inferred) {
+                continue;
+            }
+            
+            if (inferred != node->getTensorType()) {
+                std::string description = "Inferred " + inferred->toString() + " for " +
+                                          node->getName();
+                if (const TensorType* declared = node->getTensorType()) {
+                    description += " (declared " + declared->toString() + ")";
+                }
+                debugInfo.recordTransformation(description);
+                node->setTensorType(inferred);
+                changed = true;
+            }
+            for (size_t i = 0; i < node->getOutputs().size(); ++i) {
+                IRNode* output = node->getOutput(i);
+                if (!output->getTensorType()) {
+                    debugInfo.recordTransformation(
+                        "Derived " + inferred->toString() + " for output " + output->getName() +
+                        " of " + node->getName());
+                    output->setTensorType(inferred);
+                    changed = true;
+                } else if (output->getTensorType() != inferred) {
+                    throw std::runtime_error(
+                        "Output " + output->getName() + " of " + node->getName() +
+                        " is declared " + output->getTensorType()->toString() + " but " +
+                        node->getName() + " computes " + inferred->toString());
+                }
+            }
+        }
+    }
+
+    // Null if the op's type does not follow from its operands, or they are untyped
+    static const TensorType* inferType(const IRNode& node) {
+        std::vector<const TensorType*> operands;
+        for (size_t i = 0; i < node.getInputs().size(); ++i) {
+            const TensorType* type = node.getInput(i)->getTensorType();
+            if (!type) {
+                return nullptr;
+            }
+            operands.push_back(type);
+        }
+        
+        std::vector<int64_t> shape;
+        switch (node.getType()) {
+            case OpType::MATMUL: {
+                if (operands.size() < 2) {
+                    return nullptr;
+                }
+                const TensorType* lhs = operands[0];
+                const TensorType* rhs = operands[1];
+                if (lhs->getRank() < 2 || rhs->getRank() < 2) {
+                    fail(node, "cannot multiply " + lhs->toString() + " by " + rhs->toString());
+                }
+                std::vector<int64_t> lhsDims = operandDims(node, "transpose_a", lhs);
+                std::vector<int64_t> rhsDims = operandDims(node, "transpose_b", rhs);
+                if (lhsDims.back() != rhsDims[rhsDims.size() - 2]) {
+                    fail(node, "cannot multiply " + lhs->toString() + " by " + rhs->toString());
+                }
+                std::vector<int64_t> lhsBatch(lhsDims.begin(), lhsDims.end() - 2);
+                std::vector<int64_t> rhsBatch(rhsDims.begin(), rhsDims.end() - 2);
+                if (!broadcastShapes(lhsBatch, rhsBatch, shape)) {
+                    fail(node, "batch dimensions of " + lhs->toString() + " and " +
+                               rhs->toString() + " do not broadcast");
+                }
+                shape.push_back(lhsDims[lhsDims.size() - 2]);
+                shape.push_back(rhsDims.back());
+                for (size_t i = 2; i < operands.size(); ++i) {
+                    broadcastInto(node, shape, operands[i]);
+                }
+                break;
+            }
+            case OpType::ADD:
+            case OpType::MUL:
+                if (operands.empty()) {
+                    return nullptr;
+                }
+                shape = operands[0]->getShape();
+                for (size_t i = 1; i < operands.size(); ++i) {
+                    broadcastInto(node, shape, operands[i]);
+                }
+                break;
+            case OpType::TRANSPOSE:
+                if (operands.size() != 1) {
+                    return nullptr;
+                }
+                shape = permute(node, operands[0]);
+                break;
+            case OpType::SCALE:
+                if (operands.size() != 2) {
+                    return nullptr;
+                }
+                if (operands[1]->getNumElements() != 1) {
+                    fail(node, "factor " + operands[1]->toString() + " is not a scalar");
+                }
+                shape = operands[0]->getShape();
+                break;
+            case OpType::SOFTMAX:
+                if (operands.size() != 1) {
+                    return nullptr;
+                }
+                shape = operands[0]->getShape();
+                break;
+            case OpType::CAST:
+                // The target element type is the declared one
+                if (operands.size() != 1 || !node.getTensorType()) {
+                    return nullptr;
+                }
+                shape = operands[0]->getShape();
+                break;
+            default:
+                return nullptr;
+        }
+        
+        // A scale factor may be of any type; everything else must agree
+        const DataType dtype = node.getType() == OpType::CAST ? node.getTensorType()->getDataType()
+                                                              : operands[0]->getDataType();
+        size_t checked = node.getType() == OpType::SCALE ? 1 : operands.size();
+        for (size_t i = 1; i < checked; ++i) {
+            if (operands[i]->getDataType() != dtype) {
+                fail(node, "mixes " + std::string(dataTypeName(dtype)) + " and " +
+                           dataTypeName(operands[i]->getDataType()));
+            }
+        }
+        // The layout is a storage choice, kept from the declared type
+        const TensorType* declared = node.getTensorType();
+        return node.getModule().getContext().getTensorType(
+            shape, dtype, declared ? declared->getLayout() : Layout::ROW_MAJOR);
+    }
+
+    // The operand's dimensions as the matmul reads them: with `flag` set,
+    // its last two are swapped
+    static std::vector<int64_t> operandDims(const IRNode& node, const char* flag,
+                                            const TensorType* type) {
+        std::vector<int64_t> dims = type->getShape();
+        if (node.hasAttribute(flag) && node.getAttribute<int>(flag) != 0) {
+            std::swap(dims[dims.size() - 2], dims.back());
+        }
+        return dims;
+    }
+
+    static void broadcastInto(const IRNode& node, std::vector<int64_t>& shape,
+                              const TensorType* operand) {
+        std::vector<int64_t> result;
+        if (!broadcastShapes(shape, operand->getShape(), result)) {
+            fail(node, "operand " + operand->toString() + " does not broadcast to [" +
+                       joinDims(shape) + "]");
+        }
+        shape = std::move(result);
+    }
+
+    static std::vector<int64_t> permute(const IRNode& node, const TensorType* input) {
+        const std::vector<int64_t>& dims = input->getShape();
+        std::vector<int64_t> shape = dims;
+        if (!node.hasAttribute("perm")) {
+            if (dims.size() < 2) {
+                fail(node, "needs at least 2 dimensions, got " + input->toString());
+            }
+            std::swap(shape[shape.size() - 2], shape.back());
+            return shape;
+        }
+        const std::vector<int>& perm = node.getAttribute<std::vector<int>>("perm");
+        std::vector<bool> seen(dims.size(), false);
+        if (perm.size() != dims.size()) {
+            fail(node, "perm does not match " + input->toString());
+        }
+        for (size_t i = 0; i < perm.size(); ++i) {
+            if (perm[i] < 0 || static_cast<size_t>(perm[i]) >= dims.size() || seen[perm[i]]) {
+                fail(node, "perm is not a permutation of " + std::to_string(dims.size()) +
+                           " dimensions");
+            }
+            seen[perm[i]] = true;
+            shape[i] = dims[perm[i]];
+        }
+        return shape;
+    }
+
+    static std::string joinDims(const std::vector<int64_t>& shape) {
+        std::string result;
+        for (size_t i = 0; i < shape.size(); ++i) {
+            result += (i ? ", " : "") + std::to_string(shape[i]);
+        }
+        return result;
+    }
+
+    [[noreturn]] static void fail(const IRNode& node, const std::string& reason) {
+        throw std::runtime_error("Shape inference failed for " + node.getName() + ": " + reason);
+    }
+};
+
+std::unique_ptr<Pass> createShapeInferencePass() {
+    return std::make_unique<ShapeInferencePass>();
+}
+
+} // namespace compiler_sim
\ No newline at end of file
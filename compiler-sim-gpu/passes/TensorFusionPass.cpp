@@ -1,84 +1,169 @@
 #include "compiler_sim/PassManager.h"
+#include "compiler_sim/PatternRewriter.h"
 #include "compiler_sim/IRNode.h"
-#include <unordered_set>
+#include "compiler_sim/CostModel.h"
 
 namespace compiler_sim {
 
+// Pattern: an elementwise add or mul whose operand is produced by a matmul,
+// add or mul with no other users. The producer is computed inside the
+// consumer's kernel (a matmul epilogue, or one elementwise loop) when the
+// cost model says that beats writing its result out and reading it back.
+// The two need not be adjacent in the body. A producer that writes an
+// output tensor must materialize its result, so it is never fused.
+//
+// A fused node keeps the producer's op type and lists what it runs in
+// fused_ops, e.g. "matmul_add_mul". Its inputs are the root op's operands
+// followed by one operand per later op, so fused nodes can be extended
+// and fused again. AutotunePass tags a matmul and its epilogue with fuse:
+// producers tagged fuse = 1 are fused whatever the cost model says, and
+// those tagged fuse = 0 stay separate kernels.
+class FuseElementwiseConsumerPattern : public RewritePattern {
+public:
+    FuseElementwiseConsumerPattern(IRContext& context, OpType rootType,
+                                   const CostModelParams& params)
+        : RewritePattern(rootType),
+          fusedOpsKey_(context.getAttrKey("fused_ops")),
+          fuseKey_(context.getAttrKey("fuse")),
+          params_(params) {}
+
+    bool matchAndRewrite(IRNode* consumer, PatternRewriter& rewriter) const override {
+        if (consumer->getInputs().size() < 2) {
+            return false;
+        }
+
+        // Only the root op's operands can be replaced by a producer
+        size_t producerOperand = 0;
+        IRNode* producer = nullptr;
+        double bestGain = 0.0;
+        for (size_t i = 0; i < 2; ++i) {
+            IRNode* candidate = consumer->getInput(i);
+            if (!isFusableProducer(candidate)) {
+                continue;
+            }
+            if (fuseTag(*candidate) == 1) {
+                producerOperand = i;
+                producer = candidate;
+                break;
+            }
+            double gain = estimateNodeCost(*candidate, params_) +
+                          estimateNodeCost(*consumer, params_) -
+                          estimateFusedCost(*candidate, *consumer, params_);
+            if (gain > bestGain) {
+                producerOperand = i;
+                producer = candidate;
+                bestGain = gain;
+            }
+        }
+        if (!producer) {
+            return false;
+        }
+
+        // Create fused operation, keeping the producer's name and attributes
+        IRNode* fused = rewriter.create(producer->getType(), producer->getNameId());
+        for (const Attribute& attr : producer->getAttributes()) {
+            fused->setAttribute(attr.key, attr.value);
+        }
+
+        // The producer's operands, then the consumer's other operands
+        for (ValueId input : producer->getInputs()) {
+            fused->addInput(input);
+        }
+        for (size_t i = 0; i < consumer->getInputs().size(); ++i) {
+            if (i != producerOperand) {
+                fused->addInput(consumer->getInputs()[i]);
+            }
+        }
+
+        fused->setAttribute(fusedOpsKey_, fusedOps(*producer) + "_" + fusedOps(*consumer));
+        fused->setTensorType(consumer->getTensorType() ? consumer->getTensorType()
+                                                       : producer->getTensorType());
+
+        // Copy outputs from the consumer
+        for (ValueId output : consumer->getOutputs()) {
+            fused->addOutput(output);
+        }
+
+        rewriter.notifyTransformation(
+            "Fused " + producer->getName() + " and " + consumer->getName()
+        );
+        rewriter.addPassCounter("intermediate_bytes_saved", fusionSavedBytes(*producer));
+
+        // The fused op takes the consumer's slot, after its operands are defined
+        rewriter.replaceOp(consumer, fused);
+        rewriter.eraseOp(producer);
+        return true;
+    }
+
+private:
+    bool isFusableProducer(const IRNode* node) const {
+        switch (node->getType()) {
+            case OpType::MATMUL:
+            case OpType::ADD:
+            case OpType::MUL:
+                return fuseTag(*node) != 0 && node->hasOneUse() && node->getOutputs().empty();
+            default:
+                return false;
+        }
+    }
+
+    // The tuned decision: 1 to fuse, 0 not to, -1 if untuned
+    int fuseTag(const IRNode& node) const {
+        const AttributeValue* fuse = node.findAttribute(fuseKey_);
+        return fuse ? std::get<int>(*fuse) : -1;
+    }
+
+    std::string fusedOps(const IRNode& node) const {
+        if (const AttributeValue* ops = node.findAttribute(fusedOpsKey_)) {
+            return std::get<std::string>(*ops);
+        }
+        return opTypeName(node.getType());
+    }
+
+    AttrKey fusedOpsKey_;
+    AttrKey fuseKey_;
+    CostModelParams params_;
+};
+
+void populateTensorFusionPatterns(RewritePatternSet& patterns, IRContext& context,
+                                  const CostModelParams& params) {
+    patterns.add<FuseElementwiseConsumerPattern>(context, OpType::ADD, params);
+    patterns.add<FuseElementwiseConsumerPattern>(context, OpType::MUL, params);
+}
+
 class TensorFusionPass : public Pass {
 public:
+    explicit TensorFusionPass(const CostModelParams& params) : params_(params) {}
+
     std::string getName() const override {
         return "TensorFusionPass";
     }
-    
-    void run(std::vector<std::shared_ptr<IRNode>>& nodes,
-            DebugInfo& debugInfo) override {
-        
-        std::vector<std::shared_ptr<IRNode>> fusedNodes;
-        std::unordered_set<size_t> fusedIndices;
-        
-        // Look for fusable patterns
-        for (size_t i = 0; i < nodes.size(); i++) {
-            if (fusedIndices.count(i)) continue;
-            
-            auto& node = nodes[i];
-            
-            // Pattern: matmul followed by add (common in neural networks)
-            if (node->getType() == OpType::MATMUL && i + 1 < nodes.size()) {
-                auto& next = nodes[i + 1];
-                
-                if (next->getType() == OpType::ADD &&
-                    !next->getInputs().empty() &&
-                    next->getInputs()[0] == node) {
-                    
-                    // Create fused operation
-                    auto fused = std::make_shared<IRNode>(
-                        OpType::MATMUL,
-                        node->getName() + "_fused_add"
-                    );
-                    
-                    // Copy inputs from matmul
-                    for (auto& input : node->getInputs()) {
-                        fused->addInput(input);
-                    }
-                    
-                    // Add bias input from add operation
-                    if (next->getInputs().size() > 1) {
-                        fused->addInput(next->getInputs()[1]);
-                    }
-                    
-                    // Set fusion attribute
-                    fused->setAttribute("fused_ops", std::string("matmul_add"));
-                    
-                    // Copy outputs from add
-                    for (auto& output : next->getOutputs()) {
-                        fused->addOutput(output);
-                    }
-                    
-                    fusedNodes.push_back(fused);
-                    fusedIndices.insert(i);
-                    fusedIndices.insert(i + 1);
-                    
-                    debugInfo.recordTransformation(
-                        "Fused " + node->getName() + " and " + 
-                        next->getName() + " into " + fused->getName()
-                    );
-                    
-                    i++; // Skip next node
-                    continue;
-                }
-            }
-            
-            if (!fusedIndices.count(i)) {
-                fusedNodes.push_back(node);
-            }
-        }
-        
-        nodes = std::move(fusedNodes);
+
+    std::string getOptions() const override {
+        return "flops=" + std::to_string(params_.flopsPerCycle) +
+               " bytes=" + std::to_string(params_.bytesPerCycle) +
+               " launch=" + std::to_string(params_.launchCycles);
     }
+
+    bool isFunctionLocal() const override {
+        return true;
+    }
+
+    PreservedAnalyses run(IRModule& module,
+                          AnalysisManager&,
+                          DebugInfo& debugInfo) override {
+        RewritePatternSet patterns;
+        populateTensorFusionPatterns(patterns, module.getContext(), params_);
+        GreedyRewriteResult result = applyPatternsGreedily(module, patterns, &debugInfo);
+        return result.numRewrites ? PreservedAnalyses::none() : PreservedAnalyses::all();
+    }
+
+private:
+    CostModelParams params_;
 };
 
-std::unique_ptr<Pass> createTensorFusionPass() {
-    return std::make_unique<TensorFusionPass>();
+std::unique_ptr<Pass> createTensorFusionPass(const CostModelParams& params) {
+    return std::make_unique<TensorFusionPass>(params);
 }
 
 } // namespace compiler_sim
\ No newline at end of file
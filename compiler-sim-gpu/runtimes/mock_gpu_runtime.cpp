@@ -3,6 +3,10 @@
 #include <chrono>
 #include <random>
 #include <iomanip>
+#include <stdexcept>
+#include "compiler_sim/DeviceInfo.h"
+#include "compiler_sim/IRNode.h"
+#include "compiler_sim/KernelPlan.h"
 
 namespace compiler_sim {
 
@@ -21,10 +25,14 @@ struct MemoryAllocation {
 
 class MockGPURuntime {
 public:
-    MockGPURuntime() : totalMemoryAllocated_(0), peakMemoryUsage_(0) {
-        std::cout << "MockGPU: Initialized with 8GB memory\n";
+    explicit MockGPURuntime(const DeviceInfo& device = DeviceInfo())
+        : device_(device), totalMemoryAllocated_(0), peakMemoryUsage_(0) {
+        std::cout << "MockGPU: Initialized " << device_.name << " with "
+                  << formatBytes(device_.globalMemoryBytes) << " memory\n";
     }
     
+    const DeviceInfo& getDevice() const { return device_; }
+    
     void* allocate(size_t size, const std::string& name) {
         // Mock allocation
         void* ptr = reinterpret_cast<void*>(nextAddress_);
@@ -59,6 +67,12 @@ public:
     }
     
     void launchKernel(const KernelConfig& config) {
+        uint64_t threads = uint64_t(config.blockDim.x) * config.blockDim.y * config.blockDim.z;
+        if (threads > device_.maxThreadsPerBlock ||
+            config.sharedMemBytes > device_.sharedMemoryPerBlock) {
+            throw std::runtime_error("MockGPU: launch of '" + config.name +
+                                     "' exceeds the limits of " + device_.name);
+        }
         std::cout << "\nMockGPU: Launching kernel '" << config.name << "'\n";
         std::cout << "  Grid: (" << config.gridDim.x << ", " 
                   << config.gridDim.y << ", " << config.gridDim.z << ")\n";
@@ -102,6 +116,7 @@ public:
     }
     
 private:
+    DeviceInfo device_;
     std::vector<MemoryAllocation> allocations_;
     size_t totalMemoryAllocated_;
     size_t peakMemoryUsage_;
@@ -124,21 +139,36 @@ private:
     }
 };
 
-// Simulation helper for matmul kernel
-void simulateMatmulKernel(MockGPURuntime& gpu, 
-                         int M, int N, int K,
-                         void* A, void* B, void* C) {
-    // Calculate grid and block dimensions
-    const int TILE_SIZE = 32;
-    dim3 grid((N + TILE_SIZE - 1) / TILE_SIZE, 
-              (M + TILE_SIZE - 1) / TILE_SIZE);
-    dim3 block(TILE_SIZE, TILE_SIZE);
+// Allocates a tensor as MemoryMapPass planned it: memory_size covers its
+// layout, including the padding of partial tiles
+void* allocateTensor(MockGPURuntime& gpu, const IRNode& tensor) {
+    if (!tensor.hasAttribute("memory_size")) {
+        throw std::runtime_error("Tensor " + tensor.getName() +
+                                 " has no memory plan; run MemoryMapPass first");
+    }
+    std::string name = tensor.getName();
+    const TensorType* type = tensor.getTensorType();
+    if (type && type->getLayout() != Layout::ROW_MAJOR) {
+        name += std::string(" (") + layoutName(type->getLayout()) + ")";
+    }
+    return gpu.allocate(static_cast<size_t>(tensor.getAttribute<int64_t>("memory_size")), name);
+}
+
+// Simulation helper for matmul kernel. Launch resources come from the
+// attributes LoopTilingPass and MemoryMapPass planned on `matmul`
+// (getMatmulLaunch).
+void simulateMatmulKernel(MockGPURuntime& gpu, const IRNode& matmul) {
+    MatmulLaunch launch;
+    if (!getMatmulLaunch(matmul, launch)) {
+        throw std::runtime_error("Kernel " + matmul.getName() +
+                                 " has no memory plan; run MemoryMapPass first");
+    }
     
     KernelConfig config{
-        "matmul_kernel",
-        grid,
-        block,
-        2 * TILE_SIZE * TILE_SIZE * sizeof(float)  // Shared memory for tiles
+        launch.kernel,
+        dim3(launch.grid[0], launch.grid[1], launch.grid[2]),
+        dim3(launch.block[0], launch.block[1], launch.block[2]),
+        static_cast<size_t>(launch.sharedBytes)
     };
     
     gpu.launchKernel(config);
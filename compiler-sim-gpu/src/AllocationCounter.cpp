@@ -0,0 +1,193 @@
+#include "compiler_sim/AllocationCounter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace compiler_sim {
+
+namespace {
+
+std::atomic<int> enableCount{0};
+std::atomic<uint64_t> bytesAllocated{0};
+std::atomic<uint64_t> numAllocations{0};
+std::atomic<int64_t> liveBytes{0};
+std::atomic<int64_t> peakLiveBytes{0};
+
+// The live heap is tracked in usable block sizes, which delete can recover
+// without a header; elsewhere only totals are counted
+size_t blockSize(void* ptr) {
+#if defined(__GLIBC__)
+    return malloc_usable_size(ptr);
+#else
+    (void)ptr;
+    return 0;
+#endif
+}
+
+void recordAllocation(void* ptr, size_t size) {
+    if (!ptr || enableCount.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+    bytesAllocated.fetch_add(size, std::memory_order_relaxed);
+    numAllocations.fetch_add(1, std::memory_order_relaxed);
+    int64_t block = static_cast<int64_t>(blockSize(ptr));
+    int64_t live = liveBytes.fetch_add(block, std::memory_order_relaxed) + block;
+    int64_t peak = peakLiveBytes.load(std::memory_order_relaxed);
+    while (live > peak &&
+           !peakLiveBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+}
+
+void recordFree(void* ptr) {
+    if (ptr && enableCount.load(std::memory_order_relaxed) != 0) {
+        liveBytes.fetch_sub(blockSize(ptr), std::memory_order_relaxed);
+    }
+}
+
+void* allocate(size_t size) {
+    // malloc(0) may return null, which new must not
+    void* ptr = std::malloc(size ? size : 1);
+    recordAllocation(ptr, size);
+    return ptr;
+}
+
+void* allocateAligned(size_t size, std::align_val_t alignment) {
+    size_t align = static_cast<size_t>(alignment);
+    if (align < sizeof(void*)) {
+        align = sizeof(void*);
+    }
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, align, size ? size : 1) != 0) {
+        return nullptr;
+    }
+    recordAllocation(ptr, size);
+    return ptr;
+}
+
+void deallocate(void* ptr) {
+    recordFree(ptr);
+    std::free(ptr);
+}
+
+} // namespace
+
+void AllocationCounter::enable() {
+    enableCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void AllocationCounter::disable() {
+    enableCount.fetch_sub(1, std::memory_order_relaxed);
+}
+
+bool AllocationCounter::isEnabled() {
+    return enableCount.load(std::memory_order_relaxed) != 0;
+}
+
+AllocationStats AllocationCounter::getStats() {
+    AllocationStats stats;
+    stats.bytesAllocated = bytesAllocated.load(std::memory_order_relaxed);
+    stats.numAllocations = numAllocations.load(std::memory_order_relaxed);
+    stats.liveBytes = liveBytes.load(std::memory_order_relaxed);
+    stats.peakLiveBytes = peakLiveBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void AllocationCounter::resetPeak() {
+    peakLiveBytes.store(liveBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+} // namespace compiler_sim
+
+// Replacements for the global allocation functions. Every other form of
+// new and delete forwards to these.
+
+void* operator new(std::size_t size) {
+    if (void* ptr = compiler_sim::allocate(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return compiler_sim::allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return compiler_sim::allocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    if (void* ptr = compiler_sim::allocateAligned(size, alignment)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment,
+                   const std::nothrow_t&) noexcept {
+    return compiler_sim::allocateAligned(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment,
+                     const std::nothrow_t&) noexcept {
+    return compiler_sim::allocateAligned(size, alignment);
+}
+
+void operator delete(void* ptr) noexcept {
+    compiler_sim::deallocate(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    compiler_sim::deallocate(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    compiler_sim::deallocate(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    compiler_sim::deallocate(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+    compiler_sim::deallocate(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+    compiler_sim::deallocate(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+    compiler_sim::deallocate(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+    compiler_sim::deallocate(ptr);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept {
+    compiler_sim::deallocate(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept {
+    compiler_sim::deallocate(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept {
+    compiler_sim::deallocate(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept {
+    compiler_sim::deallocate(ptr);
+}
\ No newline at end of file
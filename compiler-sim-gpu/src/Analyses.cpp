@@ -0,0 +1,113 @@
+#include "compiler_sim/Analyses.h"
+#include "compiler_sim/AnalysisManager.h"
+#include "compiler_sim/IRModule.h"
+#include <algorithm>
+
+namespace compiler_sim {
+
+namespace {
+
+// Assigns `position` to `node` and everything nested in its region
+void assignPosition(const IRModule& module, const IRNode* node, uint32_t position,
+                    std::vector<uint32_t>& positions) {
+    positions[node->getId()] = position;
+    for (ValueId member : node->getRegion()) {
+        const IRNode* nested = module.getNode(member);
+        if (!nested->isErased()) {
+            assignPosition(module, nested, position, positions);
+        }
+    }
+}
+
+} // namespace
+
+DefUseAnalysis::Result DefUseAnalysis::run(IRModule& module, AnalysisManager&) {
+    const size_t numNodes = module.getNumNodes();
+    Result result;
+    result.position.assign(numNodes, kNotInBody);
+
+    uint32_t position = 0;
+    for (ValueId id : module.getBody()) {
+        const IRNode* node = module.getNode(id);
+        if (!node->isErased()) {
+            assignPosition(module, node, position++, result.position);
+        }
+    }
+    result.numPositions = position;
+
+    // Users are listed once per operand slot, so sort and dedupe per value
+    result.useOffsets.resize(numNodes + 1);
+    for (ValueId id = 0; id < numNodes; ++id) {
+        result.useOffsets[id] = static_cast<uint32_t>(result.uses.size());
+        const IRNode* node = module.getNode(id);
+        if (node->isErased()) {
+            continue;
+        }
+        size_t begin = result.uses.size();
+        for (ValueId user : node->getUsers()) {
+            if (result.position[user] != kNotInBody) {
+                result.uses.push_back(result.position[user]);
+            }
+        }
+        std::sort(result.uses.begin() + begin, result.uses.end());
+        result.uses.erase(std::unique(result.uses.begin() + begin, result.uses.end()),
+                          result.uses.end());
+    }
+    result.useOffsets[numNodes] = static_cast<uint32_t>(result.uses.size());
+    return result;
+}
+
+LivenessAnalysis::Result LivenessAnalysis::run(IRModule& module, AnalysisManager& analyses) {
+    const DefUseAnalysis::Result& defUse = analyses.getResult<DefUseAnalysis>(module);
+    const size_t numNodes = module.getNumNodes();
+    Result result;
+    result.intervals.resize(numNodes);
+    result.deadAfterDef.assign(numNodes, false);
+
+    for (ValueId id = 0; id < numNodes; ++id) {
+        uint32_t def = defUse.getPosition(id);
+        if (def == DefUseAnalysis::kNotInBody) {
+            continue;
+        }
+        DefUseAnalysis::Result::Positions uses = defUse.getUsePositions(id);
+        Interval& interval = result.intervals[id];
+        interval.start = uses.empty() ? def : std::min(def, *uses.begin());
+        interval.end = uses.empty() ? def : std::max(def, *(uses.end() - 1));
+        result.deadAfterDef[id] = uses.empty();
+    }
+    return result;
+}
+
+ShapeInfoAnalysis::Result ShapeInfoAnalysis::run(IRModule& module, AnalysisManager&) {
+    Result result;
+    result.types.assign(module.getNumNodes(), nullptr);
+    for (ValueId id = 0; id < module.getNumNodes(); ++id) {
+        const IRNode* node = module.getNode(id);
+        if (!node->isErased()) {
+            result.types[id] = node->getTensorType();
+        }
+    }
+    for (ValueId id : module.getBody()) {
+        if (const TensorType* type = result.types[id]) {
+            result.totalBytes += type->getByteSize();
+        }
+    }
+    return result;
+}
+
+CostAnalysis::Result CostAnalysis::run(IRModule& module, AnalysisManager&) {
+    Result result;
+    result.nodeCosts.assign(module.getNumNodes(), 0.0);
+    for (ValueId id = 0; id < module.getNumNodes(); ++id) {
+        const IRNode* node = module.getNode(id);
+        if (!node->isErased()) {
+            result.nodeCosts[id] = estimateNodeCost(*node);
+        }
+    }
+    for (ValueId id : module.getBody()) {
+        result.total += result.nodeCosts[id];
+    }
+    return result;
+}
+
+} // namespace compiler_sim
\ No newline at end of file
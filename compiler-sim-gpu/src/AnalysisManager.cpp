@@ -0,0 +1,99 @@
+#include "compiler_sim/AnalysisManager.h"
+#include <algorithm>
+
+namespace compiler_sim {
+
+PreservedAnalyses& PreservedAnalyses::preserve(AnalysisKey key) {
+    if (!isPreserved(key)) {
+        preserved_.push_back(key);
+    }
+    return *this;
+}
+
+bool PreservedAnalyses::isPreserved(AnalysisKey key) const {
+    return all_ || std::find(preserved_.begin(), preserved_.end(), key) != preserved_.end();
+}
+
+const AnalysisManager::ResultConcept* AnalysisManager::lookup(const IRModule& module,
+                                                              AnalysisKey key,
+                                                              const char* name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    AnalysisStats& stats = stats_[name];
+    auto moduleIt = results_.find(&module);
+    if (moduleIt != results_.end()) {
+        auto it = moduleIt->second.find(key);
+        if (it != moduleIt->second.end()) {
+            ++stats.hits;
+            return it->second.result.get();
+        }
+    }
+    ++stats.misses;
+    return nullptr;
+}
+
+const AnalysisManager::ResultConcept* AnalysisManager::insert(
+    const IRModule& module, AnalysisKey key, const char* name,
+    std::unique_ptr<ResultConcept> result) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Keeps an existing entry, so references handed out stay valid
+    auto [it, inserted] = results_[&module].try_emplace(key, CachedResult{std::move(result), name});
+    return it->second.result.get();
+}
+
+void AnalysisManager::invalidate(const IRModule& module, const PreservedAnalyses& preserved) {
+    if (preserved.areAllPreserved()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto moduleIt = results_.find(&module);
+    if (moduleIt == results_.end()) {
+        return;
+    }
+    ModuleResults& cached = moduleIt->second;
+    for (auto it = cached.begin(); it != cached.end();) {
+        if (preserved.isPreserved(it->first)) {
+            ++it;
+        } else {
+            ++stats_[it->second.name].invalidations;
+            it = cached.erase(it);
+        }
+    }
+    if (cached.empty()) {
+        results_.erase(moduleIt);
+    }
+}
+
+void AnalysisManager::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    results_.clear();
+}
+
+void AnalysisManager::resetStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.clear();
+}
+
+std::map<std::string, AnalysisStats> AnalysisManager::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+size_t AnalysisManager::getNumHits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t hits = 0;
+    for (const auto& [name, stats] : stats_) {
+        hits += stats.hits;
+    }
+    return hits;
+}
+
+size_t AnalysisManager::getNumMisses() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t misses = 0;
+    for (const auto& [name, stats] : stats_) {
+        misses += stats.misses;
+    }
+    return misses;
+}
+
+} // namespace compiler_sim
\ No newline at end of file
@@ -0,0 +1,63 @@
+#include "compiler_sim/BatchCompile.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace compiler_sim {
+
+std::vector<std::string> collectBatchInputs(const std::string& source) {
+    namespace fs = std::filesystem;
+    std::vector<std::string> inputs;
+    if (fs::is_directory(source)) {
+        for (const auto& entry : fs::directory_iterator(source)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".dsl") {
+                inputs.push_back(entry.path().string());
+            }
+        }
+        std::sort(inputs.begin(), inputs.end());
+        return inputs;
+    }
+    
+    std::ifstream list(source);
+    if (!list) {
+        throw std::runtime_error("Cannot open batch list " + source);
+    }
+    std::string line;
+    while (std::getline(list, line)) {
+        line.erase(0, line.find_first_not_of(" \t"));
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+        if (!line.empty() && line[0] != '#') {
+            inputs.push_back(line);
+        }
+    }
+    return inputs;
+}
+
+std::vector<std::string> batchTraceNames(const std::vector<std::string>& inputs) {
+    std::unordered_map<std::string, size_t> stemCounts;
+    for (const std::string& input : inputs) {
+        ++stemCounts[std::filesystem::path(input).stem().string()];
+    }
+    std::vector<std::string> names;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        std::string stem = std::filesystem::path(inputs[i]).stem().string();
+        if (stemCounts[stem] > 1) {
+            stem += "." + std::to_string(i);
+        }
+        names.push_back(stem + ".trace.json");
+    }
+    return names;
+}
+
+double nearestRankPercentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * sorted.size()));
+    return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
+
+} // namespace compiler_sim
\ No newline at end of file
@@ -0,0 +1,238 @@
+#include "compiler_sim/CompileCache.h"
+#include "compiler_sim/IRBytecode.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
+
+namespace compiler_sim {
+
+namespace {
+
+constexpr char kEntryMagic[4] = {'C', 'S', 'P', 'C'};
+constexpr uint32_t kEntryVersion = 3;
+
+// FNV-1a over 64-bit words (bytes for the tail), with a final avalanche.
+// Entries are large and the key only has to spread well, so word-at-a-time
+// is worth the weaker mixing per step.
+uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, sizeof(word));
+        hash ^= word;
+        hash *= 0x100000001b3ull;
+        hash ^= hash >> 29;
+    }
+    for (; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+uint64_t finalize(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    return hash ^ (hash >> 33);
+}
+
+class EntryWriter {
+public:
+    template<typename T>
+    void put(const T& value) {
+        out_.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+    void putString(std::string_view str) {
+        put(static_cast<uint32_t>(str.size()));
+        out_.append(str.data(), str.size());
+    }
+    const std::string& data() const { return out_; }
+
+private:
+    std::string out_;
+};
+
+// Reads fail softly: a short or malformed entry is just a miss
+class EntryReader {
+public:
+    explicit EntryReader(const std::vector<char>& data) : data_(data) {}
+
+    template<typename T>
+    bool get(T& value) {
+        if (data_.size() - pos_ < sizeof(value)) {
+            return false;
+        }
+        std::memcpy(&value, data_.data() + pos_, sizeof(value));
+        pos_ += sizeof(value);
+        return true;
+    }
+    bool getBytes(size_t size, const char*& bytes) {
+        if (data_.size() - pos_ < size) {
+            return false;
+        }
+        bytes = data_.data() + pos_;
+        pos_ += size;
+        return true;
+    }
+    bool getString(std::string& str) {
+        uint32_t size;
+        const char* bytes;
+        if (!get(size) || !getBytes(size, bytes)) {
+            return false;
+        }
+        str.assign(bytes, size);
+        return true;
+    }
+    bool atEnd() const { return pos_ == data_.size(); }
+
+private:
+    const std::vector<char>& data_;
+    size_t pos_ = 0;
+};
+
+} // namespace
+
+CompileCache::CompileCache(std::string directory) : directory_(std::move(directory)) {
+    std::error_code error;
+    std::filesystem::create_directories(directory_, error);
+    if (error) {
+        throw std::runtime_error("Compile cache: cannot create " + directory_ + ": " +
+                                 error.message());
+    }
+}
+
+uint64_t CompileCache::fingerprint(std::string_view passName, std::string_view options,
+                                   const std::vector<char>& bytecode) {
+    // Format versions are part of the key, so old entries are never read
+    uint64_t hash = 0xcbf29ce484222325ull;
+    hash = hashBytes(hash, &kEntryVersion, sizeof(kEntryVersion));
+    hash = hashBytes(hash, &bc::kVersion, sizeof(bc::kVersion));
+    for (std::string_view part : {passName, options}) {
+        uint64_t size = part.size();
+        hash = hashBytes(hash, &size, sizeof(size));
+        hash = hashBytes(hash, part.data(), part.size());
+    }
+    return finalize(hashBytes(hash, bytecode.data(), bytecode.size()));
+}
+
+std::string CompileCache::pathFor(uint64_t key) const {
+    char name[17];
+    for (int i = 15; i >= 0; --i, key >>= 4) {
+        name[i] = "0123456789abcdef"[key & 0xF];
+    }
+    name[16] = '\0';
+    return directory_ + "/" + name + ".cspc";
+}
+
+bool CompileCache::lookup(uint64_t key, Entry& entry) const {
+    std::ifstream file(pathFor(key), std::ios::binary | std::ios::ate);
+    if (!file) {
+        return false;
+    }
+    std::vector<char> data(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    if (!file.read(data.data(), static_cast<std::streamsize>(data.size()))) {
+        return false;
+    }
+
+    EntryReader reader(data);
+    char magic[4];
+    uint32_t version;
+    uint32_t numTransformations;
+    if (!reader.get(magic) || std::memcmp(magic, kEntryMagic, sizeof(magic)) != 0 ||
+        !reader.get(version) || version != kEntryVersion ||
+        !reader.get(entry.passTimeMs) || !reader.get(numTransformations)) {
+        return false;
+    }
+    entry.transformations.resize(numTransformations);
+    for (std::string& description : entry.transformations) {
+        if (!reader.getString(description)) {
+            return false;
+        }
+    }
+    uint32_t numMappings;
+    if (!reader.get(numMappings)) {
+        return false;
+    }
+    entry.memoryMappings.resize(numMappings);
+    for (MemoryMapping& mapping : entry.memoryMappings) {
+        uint32_t space;
+        if (!reader.getString(mapping.tensor) || !reader.get(mapping.offset) ||
+            !reader.get(mapping.size) || !reader.get(space) ||
+            space > static_cast<uint32_t>(MemorySpace::REGISTER)) {
+            return false;
+        }
+        mapping.space = static_cast<MemorySpace>(space);
+    }
+    uint32_t numCounters;
+    if (!reader.get(numCounters)) {
+        return false;
+    }
+    entry.counters.resize(numCounters);
+    for (auto& [name, value] : entry.counters) {
+        if (!reader.getString(name) || !reader.get(value)) {
+            return false;
+        }
+    }
+    uint64_t bytecodeSize;
+    const char* bytecode;
+    if (!reader.get(bytecodeSize) || !reader.getBytes(bytecodeSize, bytecode) ||
+        !reader.atEnd()) {
+        return false;
+    }
+    entry.bytecode.assign(bytecode, bytecode + bytecodeSize);
+    return true;
+}
+
+bool CompileCache::store(uint64_t key, const Entry& entry) const {
+    EntryWriter writer;
+    writer.put(kEntryMagic);
+    writer.put(kEntryVersion);
+    writer.put(entry.passTimeMs);
+    writer.put(static_cast<uint32_t>(entry.transformations.size()));
+    for (const std::string& description : entry.transformations) {
+        writer.putString(description);
+    }
+    writer.put(static_cast<uint32_t>(entry.memoryMappings.size()));
+    for (const MemoryMapping& mapping : entry.memoryMappings) {
+        writer.putString(mapping.tensor);
+        writer.put(mapping.offset);
+        writer.put(mapping.size);
+        writer.put(static_cast<uint32_t>(mapping.space));
+    }
+    writer.put(static_cast<uint32_t>(entry.counters.size()));
+    for (const auto& [name, value] : entry.counters) {
+        writer.putString(name);
+        writer.put(value);
+    }
+    writer.put(static_cast<uint64_t>(entry.bytecode.size()));
+
+    // Unique per process and thread, so concurrent writers never collide
+    std::string path = pathFor(key);
+    std::string temp = path + ".tmp." + std::to_string(::getpid()) + "." +
+                       std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    std::ofstream file(temp, std::ios::binary);
+    file.write(writer.data().data(), static_cast<std::streamsize>(writer.data().size()));
+    file.write(entry.bytecode.data(), static_cast<std::streamsize>(entry.bytecode.size()));
+    file.close();
+    std::error_code error;
+    if (!file) {
+        std::filesystem::remove(temp, error);
+        return false;
+    }
+    std::filesystem::rename(temp, path, error);
+    if (error) {
+        std::filesystem::remove(temp, error);
+        return false;
+    }
+    return true;
+}
+
+} // namespace compiler_sim
\ No newline at end of file
@@ -0,0 +1,263 @@
+#include "compiler_sim/CompileServer.h"
+#include "compiler_sim/ThreadPool.h"
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace compiler_sim {
+
+namespace {
+
+// Guards against a corrupt length word allocating without bound
+constexpr uint32_t kMaxMessageSize = 256u << 20;
+
+std::string systemError(const std::string& what) {
+    return what + ": " + std::strerror(errno);
+}
+
+sockaddr_un makeAddress(const std::string& path) {
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Socket path too long: " + path);
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+}
+
+// Reads exactly `size` bytes; false on end of stream before the first byte
+bool readFully(int fd, char* data, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = read(fd, data + done, size - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            throw std::runtime_error(systemError("Socket read failed"));
+        }
+        if (n == 0) {
+            if (done == 0) {
+                return false;
+            }
+            throw std::runtime_error("Connection closed mid-message");
+        }
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+void writeFully(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        // MSG_NOSIGNAL: a client that went away is an error, not SIGPIPE
+        ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            throw std::runtime_error(systemError("Socket write failed"));
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+}
+
+Json::Value typedMessage(const char* type) {
+    Json::Value message(Json::objectValue);
+    message["type"] = type;
+    return message;
+}
+
+} // namespace
+
+namespace wire {
+
+bool readMessage(int fd, Json::Value& message) {
+    unsigned char header[4];
+    if (!readFully(fd, reinterpret_cast<char*>(header), sizeof(header))) {
+        return false;
+    }
+    uint32_t size = header[0] | header[1] << 8 | header[2] << 16 |
+                    static_cast<uint32_t>(header[3]) << 24;
+    if (size > kMaxMessageSize) {
+        throw std::runtime_error("Message too large: " + std::to_string(size) + " bytes");
+    }
+    std::string text(size, '\0');
+    if (size > 0 && !readFully(fd, text.data(), size)) {
+        throw std::runtime_error("Connection closed mid-message");
+    }
+    
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    std::string errors;
+    if (!reader->parse(text.data(), text.data() + text.size(), &message, &errors) ||
+        !message.isObject()) {
+        throw std::runtime_error("Malformed message: " + errors);
+    }
+    return true;
+}
+
+void writeMessage(int fd, const Json::Value& message) {
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    std::string text = Json::writeString(builder, message);
+    if (text.size() > kMaxMessageSize) {
+        throw std::runtime_error("Message too large: " + std::to_string(text.size()) + " bytes");
+    }
+    uint32_t size = static_cast<uint32_t>(text.size());
+    char header[4] = {
+        static_cast<char>(size), static_cast<char>(size >> 8),
+        static_cast<char>(size >> 16), static_cast<char>(size >> 24),
+    };
+    writeFully(fd, header, sizeof(header));
+    writeFully(fd, text.data(), text.size());
+}
+
+} // namespace wire
+
+CompileServer::CompileServer(std::string socketPath, size_t numThreads, Handler handler)
+    : socketPath_(std::move(socketPath)), numThreads_(numThreads),
+      handler_(std::move(handler)) {
+    if (pipe(wakeFds_) != 0) {
+        throw std::runtime_error(systemError("Cannot create wake pipe"));
+    }
+}
+
+CompileServer::~CompileServer() {
+    if (listenFd_ >= 0) {
+        close(listenFd_);
+        unlink(socketPath_.c_str());
+    }
+    close(wakeFds_[0]);
+    close(wakeFds_[1]);
+}
+
+void CompileServer::listen() {
+    sockaddr_un address = makeAddress(socketPath_);
+    listenFd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd_ < 0) {
+        throw std::runtime_error(systemError("Cannot create socket"));
+    }
+    // A socket file left by a server that died would make bind fail
+    unlink(socketPath_.c_str());
+    if (bind(listenFd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(listenFd_, SOMAXCONN) != 0) {
+        std::string message = systemError("Cannot listen on " + socketPath_);
+        close(listenFd_);
+        listenFd_ = -1;
+        throw std::runtime_error(message);
+    }
+}
+
+void CompileServer::serve() {
+    if (listenFd_ < 0) {
+        throw std::runtime_error("CompileServer::serve called before listen");
+    }
+    ThreadPool pool(numThreads_);
+    
+    while (!stopping_) {
+        pollfd fds[2] = {{listenFd_, POLLIN, 0}, {wakeFds_[0], POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error(systemError("poll failed"));
+        }
+        if (fds[1].revents || stopping_) {
+            break;
+        }
+        int fd = accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            // The client may have given up between poll and accept
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lock(connectionsMutex_);
+            connections_.insert(fd);
+        }
+        pool.submit([this, fd] { handleConnection(fd); });
+    }
+    
+    // Readers blocked on idle clients see end of stream; requests already
+    // running still get their replies
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex_);
+        for (int fd : connections_) {
+            shutdown(fd, SHUT_RD);
+        }
+    }
+    pool.wait();
+    close(listenFd_);
+    listenFd_ = -1;
+    unlink(socketPath_.c_str());
+}
+
+void CompileServer::stop() {
+    stopping_ = true;
+    char byte = 0;
+    // Only async-signal-safe calls here; a full pipe already wakes the loop
+    ssize_t ignored = write(wakeFds_[1], &byte, 1);
+    (void)ignored;
+}
+
+void CompileServer::handleConnection(int fd) {
+    try {
+        Json::Value request;
+        while (!stopping_ && wire::readMessage(fd, request)) {
+            try {
+                handler_(request, [fd](const Json::Value& message) {
+                    wire::writeMessage(fd, message);
+                });
+            } catch (const std::exception& e) {
+                Json::Value error = typedMessage("error");
+                error["message"] = e.what();
+                wire::writeMessage(fd, error);
+            }
+            wire::writeMessage(fd, typedMessage("done"));
+        }
+    } catch (const std::exception&) {
+        // A broken connection only ends that client's session
+    }
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex_);
+        connections_.erase(fd);
+    }
+    close(fd);
+}
+
+void sendCompileRequest(const std::string& socketPath, const Json::Value& request,
+                        const std::function<void(const Json::Value&)>& onReply) {
+    sockaddr_un address = makeAddress(socketPath);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw std::runtime_error(systemError("Cannot create socket"));
+    }
+    try {
+        if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            throw std::runtime_error(systemError("Cannot connect to " + socketPath));
+        }
+        wire::writeMessage(fd, request);
+        Json::Value message;
+        while (true) {
+            if (!wire::readMessage(fd, message)) {
+                throw std::runtime_error("Server closed the connection");
+            }
+            if (message["type"].asString() == "done") {
+                break;
+            }
+            onReply(message);
+        }
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+    close(fd);
+}
+
+} // namespace compiler_sim
\ No newline at end of file
@@ -0,0 +1,125 @@
+#include "compiler_sim/CostModel.h"
+#include "compiler_sim/IRModule.h"
+#include <algorithm>
+
+namespace compiler_sim {
+
+namespace {
+
+double typeBytes(const IRNode* node) {
+    const TensorType* type = node->getTensorType();
+    return type ? static_cast<double>(type->getByteSize()) : 0.0;
+}
+
+double nodeFlops(const IRNode& node) {
+    const TensorType* result = node.getTensorType();
+    double elements = result ? static_cast<double>(result->getNumElements()) : 0.0;
+    size_t numInputs = node.getInputs().size();
+    
+    switch (node.getType()) {
+        case OpType::MATMUL: {
+            // 2*M*N*K, plus one op per element for each fused epilogue input
+            const TensorType* lhs = numInputs == 0 ? nullptr : node.getInput(0)->getTensorType();
+            if (!result || !lhs || lhs->getRank() < 2) {
+                return 0.0;
+            }
+            const bool transposeA = node.hasAttribute("transpose_a") &&
+                                    node.getAttribute<int>("transpose_a") != 0;
+            double k = static_cast<double>(lhs->getShape()[lhs->getRank() - (transposeA ? 2 : 1)]);
+            double flops = 2.0 * elements * k;
+            if (numInputs > 2) {
+                flops += elements * (numInputs - 2);
+            }
+            return flops;
+        }
+        case OpType::ADD:
+        case OpType::MUL:
+            // A fused chain applies one op per input after the first
+            return elements * (std::max<size_t>(numInputs, 2) - 1);
+        case OpType::SCALE:
+        case OpType::CAST:
+            return elements;
+        case OpType::SOFTMAX:
+            // max, subtract, exp, sum and divide per element
+            return 5.0 * elements;
+        default:
+            return 0.0;
+    }
+}
+
+double nodeBytes(const IRNode& node) {
+    double bytes = typeBytes(&node);
+    for (size_t i = 0; i < node.getInputs().size(); ++i) {
+        bytes += typeBytes(node.getInput(i));
+    }
+    return bytes;
+}
+
+// ALLOC, LOOP, BLOCK and CONSTANT launch nothing, and neither does a
+// transpose LayoutAssignmentPass turned into a view of its input
+bool isKernel(const IRNode& node) {
+    switch (node.getType()) {
+        case OpType::MATMUL:
+        case OpType::ADD:
+        case OpType::MUL:
+        case OpType::LOAD:
+        case OpType::STORE:
+        case OpType::SCALE:
+        case OpType::SOFTMAX:
+        case OpType::CAST:
+            return true;
+        case OpType::TRANSPOSE:
+            return !node.hasAttribute("view");
+        default:
+            return false;
+    }
+}
+
+double kernelCost(double flops, double bytes, const CostModelParams& params) {
+    return params.launchCycles + std::max(flops / params.flopsPerCycle,
+                                          bytes / params.bytesPerCycle);
+}
+
+} // namespace
+
+double estimateNodeCost(const IRNode& node, const CostModelParams& params) {
+    if (!isKernel(node)) {
+        return 0.0;
+    }
+    return kernelCost(nodeFlops(node), nodeBytes(node), params);
+}
+
+double estimateFusedCost(const IRNode& producer, const IRNode& consumer,
+                         const CostModelParams& params) {
+    double repeat = 1.0;
+    const TensorType* produced = producer.getTensorType();
+    const TensorType* consumed = consumer.getTensorType();
+    if (produced && consumed && produced->getNumElements() > 0 &&
+        consumed->getNumElements() > produced->getNumElements()) {
+        repeat = static_cast<double>(consumed->getNumElements()) / produced->getNumElements();
+    }
+    double flops = nodeFlops(consumer) + nodeFlops(producer) * repeat;
+    double bytes = nodeBytes(consumer) + nodeBytes(producer) - 2.0 * typeBytes(&producer);
+    return kernelCost(flops, bytes, params);
+}
+
+uint64_t fusionSavedBytes(const IRNode& producer) {
+    const TensorType* type = producer.getTensorType();
+    return type ? 2 * type->getByteSize() : 0;
+}
+
+double estimateModuleCost(const IRModule& module, const CostModelParams& params) {
+    double total = 0.0;
+    for (ValueId id : module.getBody()) {
+        const IRNode* node = module.getNode(id);
+        if (!node->isErased()) {
+            total += estimateNodeCost(*node, params);
+        }
+    }
+    for (const auto& function : module.getFunctions()) {
+        total += estimateModuleCost(*function, params);
+    }
+    return total;
+}
+
+} // namespace compiler_sim
\ No newline at end of file
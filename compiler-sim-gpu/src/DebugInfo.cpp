@@ -1,5 +1,5 @@
 #include "compiler_sim/DebugInfo.h"
-#include "compiler_sim/IRNode.h"
+#include "compiler_sim/IRModule.h"
 #include <chrono>
 #include <fstream>
 #include <iomanip>
@@ -25,8 +25,15 @@ void DebugInfo::beginPass(const std::string& passName) {
 }
 
 void DebugInfo::endPass(const std::string& irAfter) {
+    PassTrace* pass = currentPass_;
+    endPass();
+    if (pass) {
+        pass->irAfter = irAfter;
+    }
+}
+
+void DebugInfo::endPass() {
     if (currentPass_) {
-        currentPass_->irAfter = irAfter;
         auto endTime = std::chrono::steady_clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
             endTime - passStartTime_
@@ -36,25 +43,122 @@ void DebugInfo::endPass(const std::string& irAfter) {
     }
 }
 
+void DebugInfo::recordPassIR(const std::string& irAfter) {
+    if (!passTraces_.empty()) {
+        passTraces_.back().irAfter = irAfter;
+    }
+}
+
 void DebugInfo::recordTransformation(const std::string& description) {
     if (currentPass_) {
         currentPass_->transformations.push_back(description);
     }
 }
 
+TraceCheckpoint DebugInfo::checkpoint() const {
+    TraceCheckpoint checkpoint;
+    if (currentPass_) {
+        checkpoint.transformations = currentPass_->transformations.size();
+        checkpoint.counters = currentPass_->counters;
+    }
+    checkpoint.memoryMap = memoryMap_;
+    checkpoint.symbolTable = symbolTable_;
+    return checkpoint;
+}
+
+void DebugInfo::restore(const TraceCheckpoint& checkpoint) {
+    if (currentPass_) {
+        currentPass_->transformations.resize(checkpoint.transformations);
+        currentPass_->counters = checkpoint.counters;
+    }
+    memoryMap_ = checkpoint.memoryMap;
+    symbolTable_ = checkpoint.symbolTable;
+}
+
+void DebugInfo::mergePassTrace(const DebugInfo& function, const std::string& scope) {
+    const std::string prefix = scope.empty() ? "" : "@" + scope + ": ";
+    const std::string keyPrefix = scope.empty() ? "" : scope + "/";
+    if (currentPass_ && !function.passTraces_.empty()) {
+        const PassTrace& trace = function.passTraces_.back();
+        for (const std::string& description : trace.transformations) {
+            currentPass_->transformations.push_back(prefix + description);
+        }
+        currentPass_->cacheHits += trace.cacheHits;
+        currentPass_->cacheMisses += trace.cacheMisses;
+        currentPass_->cacheTimeSavedMs += trace.cacheTimeSavedMs;
+        for (const auto& [name, value] : trace.counters) {
+            addPassCounter(name, value);
+        }
+    }
+    for (const auto& [tensor, mapping] : function.memoryMap_) {
+        memoryMap_[keyPrefix + tensor] = mapping;
+    }
+    for (const auto& [name, info] : function.symbolTable_) {
+        symbolTable_[keyPrefix + name] = info;
+    }
+}
+
+void DebugInfo::recordAnalysisCounts(size_t hits, size_t misses) {
+    if (currentPass_) {
+        currentPass_->analysisHits = hits;
+        currentPass_->analysisMisses = misses;
+    }
+}
+
+void DebugInfo::recordAnalysisStats(std::map<std::string, AnalysisStats> stats) {
+    analysisStats_ = std::move(stats);
+}
+
+void DebugInfo::recordCacheHit(double timeSavedMs) {
+    if (currentPass_) {
+        ++currentPass_->cacheHits;
+        currentPass_->cacheTimeSavedMs += timeSavedMs;
+    }
+}
+
+void DebugInfo::recordCacheMiss() {
+    if (currentPass_) {
+        ++currentPass_->cacheMisses;
+    }
+}
+
+void DebugInfo::recordPassCounter(const std::string& name, uint64_t value) {
+    if (passTraces_.empty()) {
+        return;
+    }
+    auto& counters = passTraces_.back().counters;
+    for (auto& [counter, existing] : counters) {
+        if (counter == name) {
+            existing = value;
+            return;
+        }
+    }
+    counters.emplace_back(name, value);
+}
+
+void DebugInfo::addPassCounter(const std::string& name, uint64_t value) {
+    if (!currentPass_) {
+        return;
+    }
+    for (auto& [counter, existing] : currentPass_->counters) {
+        if (counter == name) {
+            existing += value;
+            return;
+        }
+    }
+    currentPass_->counters.emplace_back(name, value);
+}
+
 void DebugInfo::recordMemoryMapping(const std::string& tensor,
                                    size_t offset,
-                                   size_t size) {
-    memoryMap_[tensor] = {offset, size};
+                                   size_t size,
+                                   MemorySpace space) {
+    memoryMap_[tensor] = {offset, size, space};
 }
 
 void DebugInfo::recordIRSnapshot(const std::string& stage,
-                                const std::vector<std::shared_ptr<IRNode>>& nodes) {
-    std::string snapshot;
-    for (const auto& node : nodes) {
-        snapshot += node->toString() + "\n";
-    }
-    irSnapshots_.emplace_back(stage, snapshot);
+                                const IRModule& module) {
+    irSnapshots_.emplace_back(stage, module.toString());
 }
 
 void DebugInfo::exportTrace(const std::string& filename) const {
@@ -91,6 +195,9 @@ Json::Value DebugInfo::toJson() const {
     
     // Pass traces
     Json::Value passes(Json::arrayValue);
+    size_t cacheHits = 0;
+    size_t cacheMisses = 0;
+    double cacheTimeSavedMs = 0.0;
     for (const auto& trace : passTraces_) {
         Json::Value pass;
         pass["name"] = trace.passName;
@@ -99,6 +206,26 @@ Json::Value DebugInfo::toJson() const {
         for (const auto& transform : trace.transformations) {
             pass["transformations"].append(transform);
         }
+        pass["analysis_cache"]["hits"] = static_cast<Json::UInt64>(trace.analysisHits);
+        pass["analysis_cache"]["misses"] = static_cast<Json::UInt64>(trace.analysisMisses);
+        if (trace.cacheHits + trace.cacheMisses > 0) {
+            pass["compile_cache"]["hits"] = static_cast<Json::UInt64>(trace.cacheHits);
+            pass["compile_cache"]["misses"] = static_cast<Json::UInt64>(trace.cacheMisses);
+            pass["compile_cache"]["time_saved_ms"] = trace.cacheTimeSavedMs;
+            cacheHits += trace.cacheHits;
+            cacheMisses += trace.cacheMisses;
+            cacheTimeSavedMs += trace.cacheTimeSavedMs;
+        }
+        if (!trace.counters.empty()) {
+            Json::Value counters(Json::objectValue);
+            for (const auto& [name, value] : trace.counters) {
+                counters[name] = static_cast<Json::UInt64>(value);
+            }
+            pass["counters"] = counters;
+        }
+        if (!trace.irAfter.empty()) {
+            pass["ir_after"] = trace.irAfter;
+        }
         passes.append(pass);
     }
     root["passes"] = passes;
@@ -107,12 +234,31 @@ Json::Value DebugInfo::toJson() const {
     Json::Value memory(Json::objectValue);
     for (const auto& [tensor, mapping] : memoryMap_) {
         Json::Value mem;
-        mem["offset"] = static_cast<Json::UInt64>(mapping.first);
-        mem["size"] = static_cast<Json::UInt64>(mapping.second);
+        mem["offset"] = static_cast<Json::UInt64>(mapping.offset);
+        mem["size"] = static_cast<Json::UInt64>(mapping.size);
+        mem["space"] = getMemorySpaceName(mapping.space);
         memory[tensor] = mem;
     }
     root["memory_map"] = memory;
     
+    // Analysis cache
+    Json::Value analyses(Json::objectValue);
+    for (const auto& [name, stats] : analysisStats_) {
+        Json::Value entry;
+        entry["hits"] = static_cast<Json::UInt64>(stats.hits);
+        entry["misses"] = static_cast<Json::UInt64>(stats.misses);
+        entry["invalidations"] = static_cast<Json::UInt64>(stats.invalidations);
+        analyses[name] = entry;
+    }
+    root["analysis_cache"] = analyses;
+    
+    // Compile cache totals, only when a cache was used
+    if (cacheHits + cacheMisses > 0) {
+        root["compile_cache"]["hits"] = static_cast<Json::UInt64>(cacheHits);
+        root["compile_cache"]["misses"] = static_cast<Json::UInt64>(cacheMisses);
+        root["compile_cache"]["time_saved_ms"] = cacheTimeSavedMs;
+    }
+    
     return root;
 }
 
@@ -0,0 +1,68 @@
+#include "compiler_sim/DeviceInfo.h"
+#include <algorithm>
+
+namespace compiler_sim {
+
+const char* getMemorySpaceName(MemorySpace space) {
+    switch (space) {
+        case MemorySpace::GLOBAL: return "global";
+        case MemorySpace::SHARED: return "shared";
+        case MemorySpace::REGISTER: return "registers";
+    }
+    return "unknown";
+}
+
+std::string DeviceInfo::describe() const {
+    return name +
+           " global=" + std::to_string(globalMemoryBytes) +
+           " shared=" + std::to_string(sharedMemoryPerBlock) +
+           "/" + std::to_string(sharedMemoryPerSM) +
+           " regs=" + std::to_string(maxRegistersPerThread) +
+           "/" + std::to_string(registersPerSM) +
+           " threads=" + std::to_string(maxThreadsPerBlock) +
+           "/" + std::to_string(maxThreadsPerSM) +
+           " blocks=" + std::to_string(maxBlocksPerSM) +
+           " warp=" + std::to_string(warpSize) +
+           " sms=" + std::to_string(numSMs);
+}
+
+Occupancy computeOccupancy(const DeviceInfo& device, uint32_t threadsPerBlock,
+                           uint32_t sharedBytesPerBlock, uint32_t registersPerThread) {
+    Occupancy result;
+    if (threadsPerBlock == 0 || threadsPerBlock > device.maxThreadsPerBlock ||
+        sharedBytesPerBlock > device.sharedMemoryPerBlock ||
+        registersPerThread > device.maxRegistersPerThread) {
+        result.limiter = threadsPerBlock > device.maxThreadsPerBlock ? "threads"
+                       : sharedBytesPerBlock > device.sharedMemoryPerBlock ? "shared"
+                       : "registers";
+        return result;
+    }
+    
+    // Resources are handed out in whole warps
+    uint32_t warpsPerBlock = (threadsPerBlock + device.warpSize - 1) / device.warpSize;
+    uint32_t threadSlots = warpsPerBlock * device.warpSize;
+    
+    struct Limit {
+        uint32_t blocks;
+        const char* name;
+    };
+    Limit limits[] = {
+        {device.maxThreadsPerSM / threadSlots, "threads"},
+        {device.maxBlocksPerSM, "blocks"},
+        {sharedBytesPerBlock ? device.sharedMemoryPerSM / sharedBytesPerBlock
+                             : device.maxBlocksPerSM, "shared"},
+        {registersPerThread ? device.registersPerSM / (registersPerThread * threadSlots)
+                            : device.maxBlocksPerSM, "registers"},
+    };
+    const Limit* tightest = std::min_element(
+        std::begin(limits), std::end(limits),
+        [](const Limit& a, const Limit& b) { return a.blocks < b.blocks; });
+    
+    result.blocksPerSM = tightest->blocks;
+    result.limiter = tightest->name;
+    uint32_t maxWarps = device.maxThreadsPerSM / device.warpSize;
+    result.occupancy = static_cast<double>(result.blocksPerSM * warpsPerBlock) / maxWarps;
+    return result;
+}
+
+} // namespace compiler_sim
\ No newline at end of file
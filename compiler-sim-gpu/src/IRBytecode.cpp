@@ -0,0 +1,509 @@
+#include "compiler_sim/IRBytecode.h"
+#include "compiler_sim/IRModule.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace compiler_sim {
+
+namespace {
+
+uint64_t alignTo8(uint64_t offset) {
+    return (offset + 7) & ~uint64_t(7);
+}
+
+void checkRange(uint64_t begin, uint64_t count, uint64_t total, const char* what) {
+    if (begin > total || count > total - begin) {
+        throw std::runtime_error(std::string("Bytecode: ") + what + " out of range");
+    }
+}
+
+class Writer {
+public:
+    uint32_t internString(const std::string& str) {
+        auto it = stringIds_.find(str);
+        if (it != stringIds_.end()) {
+            return it->second;
+        }
+        uint32_t id = static_cast<uint32_t>(stringOffsets_.size() - 1);
+        stringData_ += str;
+        stringOffsets_.push_back(static_cast<uint32_t>(stringData_.size()));
+        stringIds_.emplace(str, id);
+        return id;
+    }
+
+    uint32_t internType(const TensorType* type) {
+        if (!type) {
+            return bc::kNone;
+        }
+        auto it = typeIds_.find(type);
+        if (it != typeIds_.end()) {
+            return it->second;
+        }
+        uint32_t id = static_cast<uint32_t>(types_.size());
+        types_.push_back({static_cast<uint32_t>(type->getDataType()),
+                          static_cast<uint32_t>(type->getLayout()),
+                          static_cast<uint32_t>(dims_.size()),
+                          static_cast<uint32_t>(type->getRank())});
+        dims_.insert(dims_.end(), type->getShape().begin(), type->getShape().end());
+        typeIds_.emplace(type, id);
+        return id;
+    }
+
+    explicit Writer(const BytecodeWriteOptions& options) : options_(options) {}
+
+    std::vector<char> write(const IRModule& module) {
+        const IRContext& context = module.getContext();
+        writeUnit(module, bc::kNone);
+        if (options_.includeFunctions) {
+            for (const auto& function : module.getFunctions()) {
+                writeUnit(*function,
+                          internString(context.getIdentifierName(function->getFunctionName())));
+            }
+        }
+        return layout();
+    }
+
+private:
+    // Appends one module's nodes and body as a FunctionRecord
+    void writeUnit(const IRModule& module, uint32_t name) {
+        const IRContext& context = module.getContext();
+        bc::FunctionRecord unit{};
+        unit.name = name;
+        unit.nodesBegin = static_cast<uint32_t>(nodes_.size());
+        unit.bodyBegin = static_cast<uint32_t>(body_.size());
+
+        // Dense renumbering of live nodes, after those of earlier units
+        std::vector<uint32_t> index(module.getNumNodes(), bc::kNone);
+        uint32_t numLive = unit.nodesBegin;
+        for (ValueId id = 0; id < module.getNumNodes(); ++id) {
+            if (!module.getNode(id)->isErased()) {
+                index[id] = numLive++;
+            }
+        }
+
+        auto remap = [&](ValueId id, const IRNode* user) {
+            if (index[id] == bc::kNone) {
+                throw std::runtime_error("Bytecode: " + user->getName() +
+                                         " references an erased node");
+            }
+            return index[id];
+        };
+
+        nodes_.reserve(numLive);
+        for (ValueId id = 0; id < module.getNumNodes(); ++id) {
+            const IRNode* node = module.getNode(id);
+            if (node->isErased()) {
+                continue;
+            }
+
+            bc::NodeRecord record{};
+            record.opType = static_cast<uint32_t>(node->getType());
+            record.name = internString(node->getName());
+            record.type = internType(node->getTensorType());
+            record.debugLine = node->getDebugLocation().first;
+            record.debugCol = node->getDebugLocation().second;
+
+            record.inputsBegin = static_cast<uint32_t>(operands_.size());
+            record.numInputs = static_cast<uint32_t>(node->getInputs().size());
+            for (ValueId input : node->getInputs()) {
+                operands_.push_back(remap(input, node));
+            }
+            record.outputsBegin = static_cast<uint32_t>(operands_.size());
+            record.numOutputs = static_cast<uint32_t>(node->getOutputs().size());
+            for (ValueId output : node->getOutputs()) {
+                operands_.push_back(remap(output, node));
+            }
+            record.regionBegin = static_cast<uint32_t>(operands_.size());
+            for (ValueId member : node->getRegion()) {
+                // Erased members are dropped, as in the body
+                if (index[member] != bc::kNone) {
+                    operands_.push_back(index[member]);
+                }
+            }
+            record.numRegion = static_cast<uint32_t>(operands_.size() - record.regionBegin);
+
+            record.attrsBegin = static_cast<uint32_t>(attributes_.size());
+            record.numAttrs = static_cast<uint32_t>(node->getAttributes().size());
+            sortedAttrs_.clear();
+            for (const Attribute& attr : node->getAttributes()) {
+                sortedAttrs_.push_back(&attr);
+            }
+            if (options_.canonicalAttributeOrder) {
+                std::sort(sortedAttrs_.begin(), sortedAttrs_.end(),
+                          [&](const Attribute* a, const Attribute* b) {
+                              return context.getAttrName(a->key) < context.getAttrName(b->key);
+                          });
+            }
+            for (const Attribute* attr : sortedAttrs_) {
+                attributes_.push_back(encodeAttribute(context.getAttrName(attr->key), attr->value));
+            }
+            nodes_.push_back(record);
+        }
+
+        for (ValueId id : module.getBody()) {
+            if (!module.getNode(id)->isErased()) {
+                body_.push_back(index[id]);
+            }
+        }
+
+        unit.numNodes = static_cast<uint32_t>(nodes_.size()) - unit.nodesBegin;
+        unit.numBody = static_cast<uint32_t>(body_.size()) - unit.bodyBegin;
+        functions_.push_back(unit);
+    }
+
+    bc::AttributeRecord encodeAttribute(const std::string& key, const AttributeValue& value) {
+        bc::AttributeRecord record{};
+        record.key = internString(key);
+        record.kind = static_cast<bc::AttrKind>(value.index());
+        std::visit([&](const auto& v) {
+            using T = std::decay_t<decltype(v)>;
+            if constexpr (std::is_same_v<T, int>) {
+                record.payload = static_cast<uint64_t>(static_cast<int64_t>(v));
+            } else if constexpr (std::is_same_v<T, int64_t>) {
+                record.payload = static_cast<uint64_t>(v);
+            } else if constexpr (std::is_same_v<T, float>) {
+                uint32_t bits;
+                std::memcpy(&bits, &v, sizeof(bits));
+                record.payload = bits;
+            } else if constexpr (std::is_same_v<T, std::string>) {
+                record.payload = internString(v);
+            } else {
+                record.payload = (static_cast<uint64_t>(ints_.size()) << 32) | v.size();
+                ints_.insert(ints_.end(), v.begin(), v.end());
+            }
+        }, value);
+        return record;
+    }
+
+    template<typename T>
+    static void copySection(std::vector<char>& out, uint64_t offset, const std::vector<T>& items) {
+        if (!items.empty()) {
+            std::memcpy(out.data() + offset, items.data(), items.size() * sizeof(T));
+        }
+    }
+
+    std::vector<char> layout() {
+        bc::Header header{};
+        std::memcpy(header.magic, bc::kMagic, sizeof(header.magic));
+        header.version = bc::kVersion;
+        header.numStrings = static_cast<uint32_t>(stringOffsets_.size() - 1);
+        header.numTypes = static_cast<uint32_t>(types_.size());
+        header.numDims = static_cast<uint32_t>(dims_.size());
+        header.numNodes = static_cast<uint32_t>(nodes_.size());
+        header.numOperands = static_cast<uint32_t>(operands_.size());
+        header.numAttributes = static_cast<uint32_t>(attributes_.size());
+        header.numInts = static_cast<uint32_t>(ints_.size());
+        header.numBody = static_cast<uint32_t>(body_.size());
+        header.numFunctions = static_cast<uint32_t>(functions_.size());
+
+        uint64_t offset = alignTo8(sizeof(bc::Header));
+        auto place = [&offset](uint64_t bytes) {
+            uint64_t start = offset;
+            offset = alignTo8(offset + bytes);
+            return start;
+        };
+        header.stringOffsetsOffset = place(stringOffsets_.size() * sizeof(uint32_t));
+        header.stringDataOffset = place(stringData_.size());
+        header.typesOffset = place(types_.size() * sizeof(bc::TypeRecord));
+        header.dimsOffset = place(dims_.size() * sizeof(int64_t));
+        header.nodesOffset = place(nodes_.size() * sizeof(bc::NodeRecord));
+        header.operandsOffset = place(operands_.size() * sizeof(uint32_t));
+        header.attributesOffset = place(attributes_.size() * sizeof(bc::AttributeRecord));
+        header.intsOffset = place(ints_.size() * sizeof(int32_t));
+        header.bodyOffset = place(body_.size() * sizeof(uint32_t));
+        header.functionsOffset = place(functions_.size() * sizeof(bc::FunctionRecord));
+        header.fileSize = offset;
+
+        std::vector<char> out(offset, 0);
+        std::memcpy(out.data(), &header, sizeof(header));
+        copySection(out, header.stringOffsetsOffset, stringOffsets_);
+        std::memcpy(out.data() + header.stringDataOffset, stringData_.data(), stringData_.size());
+        copySection(out, header.typesOffset, types_);
+        copySection(out, header.dimsOffset, dims_);
+        copySection(out, header.nodesOffset, nodes_);
+        copySection(out, header.operandsOffset, operands_);
+        copySection(out, header.attributesOffset, attributes_);
+        copySection(out, header.intsOffset, ints_);
+        copySection(out, header.bodyOffset, body_);
+        copySection(out, header.functionsOffset, functions_);
+        return out;
+    }
+
+    std::vector<uint32_t> stringOffsets_{0};
+    std::string stringData_;
+    std::unordered_map<std::string, uint32_t> stringIds_;
+    std::unordered_map<const TensorType*, uint32_t> typeIds_;
+    std::vector<bc::TypeRecord> types_;
+    std::vector<int64_t> dims_;
+    std::vector<bc::NodeRecord> nodes_;
+    std::vector<uint32_t> operands_;
+    std::vector<bc::AttributeRecord> attributes_;
+    std::vector<int32_t> ints_;
+    std::vector<uint32_t> body_;
+    std::vector<bc::FunctionRecord> functions_;
+    BytecodeWriteOptions options_;
+    std::vector<const Attribute*> sortedAttrs_;
+};
+
+} // namespace
+
+std::vector<char> writeBytecode(const IRModule& module, const BytecodeWriteOptions& options) {
+    return Writer(options).write(module);
+}
+
+void writeBytecodeFile(const IRModule& module, const std::string& path) {
+    std::vector<char> data = writeBytecode(module);
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Cannot open " + path + " for writing");
+    }
+    file.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+BytecodeReader::BytecodeReader(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open bytecode file: " + path);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        throw std::runtime_error("Cannot read bytecode file: " + path);
+    }
+    mappedSize_ = static_cast<size_t>(st.st_size);
+    void* addr = ::mmap(nullptr, mappedSize_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        throw std::runtime_error("Cannot map bytecode file: " + path);
+    }
+    base_ = static_cast<const char*>(addr);
+    mapped_ = true;
+
+    try {
+        validate(mappedSize_);
+    } catch (...) {
+        ::munmap(const_cast<char*>(base_), mappedSize_);
+        throw;
+    }
+}
+
+BytecodeReader::BytecodeReader(const void* data, size_t size)
+    : base_(static_cast<const char*>(data)) {
+    validate(size);
+}
+
+BytecodeReader::~BytecodeReader() {
+    if (mapped_) {
+        ::munmap(const_cast<char*>(base_), mappedSize_);
+    }
+}
+
+void BytecodeReader::validate(size_t size) {
+    if (size < sizeof(bc::Header) || reinterpret_cast<uintptr_t>(base_) % 8 != 0) {
+        throw std::runtime_error("Bytecode: truncated or misaligned header");
+    }
+    header_ = reinterpret_cast<const bc::Header*>(base_);
+    if (std::memcmp(header_->magic, bc::kMagic, sizeof(bc::kMagic)) != 0) {
+        throw std::runtime_error("Bytecode: bad magic");
+    }
+    if (header_->version != bc::kVersion) {
+        throw std::runtime_error("Bytecode: unsupported version " +
+                                 std::to_string(header_->version));
+    }
+    if (header_->fileSize != size) {
+        throw std::runtime_error("Bytecode: size mismatch");
+    }
+
+    auto section = [&](uint64_t offset, uint64_t count, size_t elementSize, const char* what) {
+        if (offset % 8 != 0) {
+            throw std::runtime_error(std::string("Bytecode: misaligned ") + what);
+        }
+        checkRange(offset, count * elementSize, size, what);
+        return base_ + offset;
+    };
+
+    const auto& h = *header_;
+    stringOffsets_ = reinterpret_cast<const uint32_t*>(
+        section(h.stringOffsetsOffset, uint64_t(h.numStrings) + 1, sizeof(uint32_t), "string offsets"));
+    stringData_ = section(h.stringDataOffset, stringOffsets_[h.numStrings], 1, "string data");
+    types_ = reinterpret_cast<const bc::TypeRecord*>(
+        section(h.typesOffset, h.numTypes, sizeof(bc::TypeRecord), "types"));
+    dims_ = reinterpret_cast<const int64_t*>(
+        section(h.dimsOffset, h.numDims, sizeof(int64_t), "dims"));
+    nodes_ = reinterpret_cast<const bc::NodeRecord*>(
+        section(h.nodesOffset, h.numNodes, sizeof(bc::NodeRecord), "nodes"));
+    operands_ = reinterpret_cast<const uint32_t*>(
+        section(h.operandsOffset, h.numOperands, sizeof(uint32_t), "operands"));
+    attributes_ = reinterpret_cast<const bc::AttributeRecord*>(
+        section(h.attributesOffset, h.numAttributes, sizeof(bc::AttributeRecord), "attributes"));
+    ints_ = reinterpret_cast<const int32_t*>(
+        section(h.intsOffset, h.numInts, sizeof(int32_t), "ints"));
+    body_ = reinterpret_cast<const uint32_t*>(
+        section(h.bodyOffset, h.numBody, sizeof(uint32_t), "body"));
+    functions_ = reinterpret_cast<const bc::FunctionRecord*>(
+        section(h.functionsOffset, h.numFunctions, sizeof(bc::FunctionRecord), "functions"));
+    if (h.numFunctions == 0) {
+        throw std::runtime_error("Bytecode: missing top-level module record");
+    }
+}
+
+std::string_view BytecodeReader::getString(uint32_t id) const {
+    checkRange(id, 1, header_->numStrings, "string id");
+    uint32_t begin = stringOffsets_[id];
+    uint32_t end = stringOffsets_[id + 1];
+    if (begin > end || end > stringOffsets_[header_->numStrings]) {
+        throw std::runtime_error("Bytecode: corrupt string table");
+    }
+    return std::string_view(stringData_ + begin, end - begin);
+}
+
+ArrayView<int64_t> BytecodeReader::getTypeDims(const bc::TypeRecord& type) const {
+    checkRange(type.dimsBegin, type.rank, header_->numDims, "type dims");
+    return {dims_ + type.dimsBegin, type.rank};
+}
+
+ArrayView<uint32_t> BytecodeReader::getInputs(const bc::NodeRecord& node) const {
+    checkRange(node.inputsBegin, node.numInputs, header_->numOperands, "node inputs");
+    return {operands_ + node.inputsBegin, node.numInputs};
+}
+
+ArrayView<uint32_t> BytecodeReader::getOutputs(const bc::NodeRecord& node) const {
+    checkRange(node.outputsBegin, node.numOutputs, header_->numOperands, "node outputs");
+    return {operands_ + node.outputsBegin, node.numOutputs};
+}
+
+ArrayView<uint32_t> BytecodeReader::getRegion(const bc::NodeRecord& node) const {
+    checkRange(node.regionBegin, node.numRegion, header_->numOperands, "node region");
+    return {operands_ + node.regionBegin, node.numRegion};
+}
+
+ArrayView<bc::AttributeRecord> BytecodeReader::getAttributes(const bc::NodeRecord& node) const {
+    checkRange(node.attrsBegin, node.numAttrs, header_->numAttributes, "node attributes");
+    return {attributes_ + node.attrsBegin, node.numAttrs};
+}
+
+ArrayView<uint32_t> BytecodeReader::getBody(const bc::FunctionRecord& function) const {
+    checkRange(function.bodyBegin, function.numBody, header_->numBody, "function body");
+    return {body_ + function.bodyBegin, function.numBody};
+}
+
+ArrayView<int32_t> BytecodeReader::getInts(const bc::AttributeRecord& attr) const {
+    uint32_t begin = static_cast<uint32_t>(attr.payload >> 32);
+    uint32_t count = static_cast<uint32_t>(attr.payload & 0xFFFFFFFFu);
+    checkRange(begin, count, header_->numInts, "attribute ints");
+    return {ints_ + begin, count};
+}
+
+namespace {
+
+void readUnit(const BytecodeReader& reader, const bc::FunctionRecord& unit,
+              const std::vector<const TensorType*>& types, IRModule& module) {
+    IRContext& context = module.getContext();
+
+    // Create every node first so operands can refer forward
+    checkRange(unit.nodesBegin, unit.numNodes, reader.getNumNodes(), "function nodes");
+    std::vector<IRNode*> nodes(unit.numNodes);
+    for (uint32_t i = 0; i < unit.numNodes; ++i) {
+        const bc::NodeRecord& record = reader.getNodeRecord(unit.nodesBegin + i);
+        if (record.opType >= kNumOpTypes) {
+            throw std::runtime_error("Bytecode: unknown op type");
+        }
+        IRNode* node = module.createNode(static_cast<OpType>(record.opType),
+                                         reader.getString(record.name));
+        if (record.type != bc::kNone) {
+            checkRange(record.type, 1, types.size(), "node type");
+            node->setTensorType(types[record.type]);
+        }
+        if (record.debugLine >= 0) {
+            node->setDebugLocation(record.debugLine, record.debugCol);
+        }
+
+        for (const bc::AttributeRecord& attr : reader.getAttributes(record)) {
+            AttrKey key = context.getAttrKey(std::string(reader.getString(attr.key)));
+            switch (attr.kind) {
+                case bc::AttrKind::INT:
+                    node->setAttribute(key, static_cast<int>(static_cast<int64_t>(attr.payload)));
+                    break;
+                case bc::AttrKind::INT64:
+                    node->setAttribute(key, static_cast<int64_t>(attr.payload));
+                    break;
+                case bc::AttrKind::FLOAT: {
+                    uint32_t bits = static_cast<uint32_t>(attr.payload);
+                    float value;
+                    std::memcpy(&value, &bits, sizeof(value));
+                    node->setAttribute(key, value);
+                    break;
+                }
+                case bc::AttrKind::STRING:
+                    node->setAttribute(key, std::string(
+                        reader.getString(static_cast<uint32_t>(attr.payload))));
+                    break;
+                case bc::AttrKind::INT_VECTOR: {
+                    ArrayView<int32_t> ints = reader.getInts(attr);
+                    node->setAttribute(key, std::vector<int>(ints.begin(), ints.end()));
+                    break;
+                }
+                default:
+                    throw std::runtime_error("Bytecode: unknown attribute kind");
+            }
+        }
+        nodes[i] = node;
+    }
+
+    // Indices are file-wide; anything outside this unit's range is rejected
+    auto local = [&](uint32_t index, const char* what) {
+        checkRange(index - unit.nodesBegin, 1, nodes.size(), what);
+        return nodes[index - unit.nodesBegin];
+    };
+    for (uint32_t i = 0; i < unit.numNodes; ++i) {
+        const bc::NodeRecord& record = reader.getNodeRecord(unit.nodesBegin + i);
+        for (uint32_t input : reader.getInputs(record)) {
+            nodes[i]->addInput(local(input, "operand"));
+        }
+        for (uint32_t output : reader.getOutputs(record)) {
+            nodes[i]->addOutput(local(output, "operand"));
+        }
+        for (uint32_t member : reader.getRegion(record)) {
+            nodes[i]->appendToRegion(local(member, "region member"));
+        }
+    }
+
+    for (uint32_t index : reader.getBody(unit)) {
+        module.append(local(index, "body entry"));
+    }
+}
+
+} // namespace
+
+void readModule(const BytecodeReader& reader, IRModule& module) {
+    IRContext& context = module.getContext();
+
+    std::vector<const TensorType*> types(reader.getNumTypes());
+    for (uint32_t i = 0; i < reader.getNumTypes(); ++i) {
+        const bc::TypeRecord& record = reader.getTypeRecord(i);
+        if (record.dtype > static_cast<uint32_t>(DataType::I32) ||
+            record.layout > static_cast<uint32_t>(Layout::TILED)) {
+            throw std::runtime_error("Bytecode: unknown dtype or layout");
+        }
+        ArrayView<int64_t> dims = reader.getTypeDims(record);
+        types[i] = context.getTensorType(std::vector<int64_t>(dims.begin(), dims.end()),
+                                         static_cast<DataType>(record.dtype),
+                                         static_cast<Layout>(record.layout));
+    }
+
+    readUnit(reader, reader.getFunctionRecord(0), types, module);
+    for (uint32_t i = 1; i < reader.getNumFunctions(); ++i) {
+        const bc::FunctionRecord& function = reader.getFunctionRecord(i);
+        readUnit(reader, function, types,
+                 module.addFunction(reader.getString(function.name)));
+    }
+}
+
+} // namespace compiler_sim
\ No newline at end of file
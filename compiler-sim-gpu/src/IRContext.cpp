@@ -0,0 +1,81 @@
+#include "compiler_sim/IRContext.h"
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
+
+namespace compiler_sim {
+
+uint32_t StringInterner::intern(std::string_view str) {
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto it = ids_.find(str);
+        if (it != ids_.end()) {
+            return it->second;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto it = ids_.find(str);
+    if (it != ids_.end()) {
+        return it->second;
+    }
+
+    uint32_t id = size_.load(std::memory_order_relaxed);
+    if (id == kNotFound) {
+        throw std::length_error("StringInterner: id space exhausted");
+    }
+    uint32_t chunk, offset;
+    locate(id, chunk, offset);
+    if (offset == 0) {
+        chunks_[chunk].reset(new std::string[size_t(1) << (chunk + kFirstChunkShift)]);
+    }
+    std::string& stored = chunks_[chunk][offset];
+    stored.assign(str.data(), str.size());
+    ids_.emplace(stored, id);
+    size_.store(id + 1, std::memory_order_release);
+    return id;
+}
+
+uint32_t StringInterner::lookup(std::string_view str) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = ids_.find(str);
+    return it != ids_.end() ? it->second : kNotFound;
+}
+
+size_t IRContext::TensorTypeKeyHash::operator()(const TensorTypeKey& key) const {
+    size_t hash = std::hash<int>()(static_cast<int>(key.dtype) * 8 + static_cast<int>(key.layout));
+    for (int64_t dim : key.shape) {
+        hash ^= std::hash<int64_t>()(dim) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+    }
+    return hash;
+}
+
+const TensorType* IRContext::getTensorType(const std::vector<int64_t>& shape,
+                                           DataType dtype,
+                                           Layout layout) {
+    TensorTypeKey key{shape, dtype, layout};
+    {
+        std::shared_lock<std::shared_mutex> lock(tensorTypesMutex_);
+        auto it = tensorTypes_.find(key);
+        if (it != tensorTypes_.end()) {
+            return &it->second;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(tensorTypesMutex_);
+    auto it = tensorTypes_.find(key);
+    if (it == tensorTypes_.end()) {
+        it = tensorTypes_.emplace(std::piecewise_construct,
+                                  std::forward_as_tuple(key),
+                                  std::forward_as_tuple(shape, dtype, layout)).first;
+    }
+    return &it->second;
+}
+
+size_t IRContext::getNumTensorTypes() const {
+    std::shared_lock<std::shared_mutex> lock(tensorTypesMutex_);
+    return tensorTypes_.size();
+}
+
+} // namespace compiler_sim
\ No newline at end of file
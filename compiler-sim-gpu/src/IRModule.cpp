@@ -0,0 +1,205 @@
+#include "compiler_sim/IRModule.h"
+#include <algorithm>
+#include <charconv>
+#include <new>
+
+namespace compiler_sim {
+
+IRModule::IRModule()
+    : ownedContext_(std::make_unique<IRContext>()), context_(ownedContext_.get()) {}
+
+IRModule::IRModule(IRContext& context)
+    : context_(&context) {}
+
+IRModule::~IRModule() {
+    if (snapshot_) {
+        snapshot_->module_ = nullptr;
+    }
+    // Slabs only hold raw storage, so run node destructors explicitly
+    for (uint32_t id = numNodes_; id-- > 0;) {
+        slotAt(id)->~IRNode();
+    }
+}
+
+IRNode* IRModule::createNode(OpType type, NameId name) {
+    if (numNodes_ == kInvalidValueId) {
+        throw std::length_error("IRModule: value id space exhausted");
+    }
+
+    ValueId id = numNodes_;
+    if ((id >> kSlabShift) >= slabs_.size()) {
+        slabs_.push_back(std::unique_ptr<Slab>(new Slab));
+    }
+
+    IRNode* node = new (slotAt(id)) IRNode(*this, id, type, name);
+    ++numNodes_;
+    return node;
+}
+
+void IRModule::compact() {
+    if (numErased_ == 0) {
+        return;
+    }
+    if (snapshot_) {
+        snapshot_->saveBody(body_);
+    }
+    body_.erase(std::remove_if(body_.begin(), body_.end(),
+                               [this](ValueId id) { return getNode(id)->isErased(); }),
+                body_.end());
+    numErased_ = 0;
+}
+
+void IRModule::clear() {
+    if (snapshot_) {
+        throw std::runtime_error("IRModule: cannot clear while a snapshot is active");
+    }
+    for (uint32_t id = numNodes_; id-- > 0;) {
+        slotAt(id)->~IRNode();
+    }
+    numNodes_ = 0;
+    slabs_.clear();
+    body_.clear();
+    numErased_ = 0;
+}
+
+ValueNamer::ValueNamer(const IRModule& module)
+    : module_(module),
+      suffix_(module.getNumNodes(), kUnassigned),
+      nextSuffix_(module.getContext().getNumIdentifiers(), 0) {}
+
+void ValueNamer::appendName(std::string& out, const IRNode* node) {
+    const IRContext& context = module_.getContext();
+    const std::string& base = node->getName();
+    out += base;
+    
+    uint32_t& suffix = suffix_[node->getId()];
+    if (suffix == kUnassigned) {
+        uint32_t& next = nextSuffix_[node->getNameId()];
+        if (next == 0) {
+            suffix = 0;
+            next = 1;
+        } else {
+            std::string candidate;
+            do {
+                suffix = next++;
+                candidate = base + '_' + std::to_string(suffix);
+            } while (context.lookupIdentifier(candidate) != kInvalidNameId);
+        }
+    }
+    
+    if (suffix != 0) {
+        out += '_';
+        char buf[16];
+        auto result = std::to_chars(buf, buf + sizeof(buf), suffix);
+        out.append(buf, result.ptr);
+    }
+}
+
+IRModule& IRModule::addFunction(std::string_view name) {
+    if (parent_) {
+        throw std::runtime_error("IRModule: functions cannot be nested");
+    }
+    NameId nameId = context_->getIdentifier(name);
+    for (const auto& function : functions_) {
+        if (function->functionName_ == nameId) {
+            throw std::runtime_error("IRModule: duplicate function " + std::string(name));
+        }
+    }
+    functions_.push_back(std::make_unique<IRModule>(*context_));
+    IRModule& function = *functions_.back();
+    function.parent_ = this;
+    function.functionName_ = nameId;
+    return function;
+}
+
+IRModule* IRModule::getFunction(std::string_view name) const {
+    NameId nameId = context_->lookupIdentifier(name);
+    for (const auto& function : functions_) {
+        if (function->functionName_ == nameId) {
+            return function.get();
+        }
+    }
+    return nullptr;
+}
+
+void IRModule::printBody(std::string& out, int indent) const {
+    ValueNamer names(*this);
+    for (ValueId id : body_) {
+        const IRNode* node = getNode(id);
+        if (!node->isErased()) {
+            node->print(out, indent, names);
+            out += '\n';
+        }
+    }
+}
+
+void IRModule::print(std::string& out) const {
+    printBody(out, 0);
+    for (const auto& function : functions_) {
+        out += "func @";
+        out += context_->getIdentifierName(function->functionName_);
+        out += " {\n";
+        function->printBody(out, 1);
+        out += "}\n";
+    }
+}
+
+std::string IRModule::toString() const {
+    std::string result;
+    print(result);
+    return result;
+}
+
+void IRModule::cloneInto(IRModule& dest, IRMapping& mapping) const {
+    for (ValueId id : body_) {
+        const IRNode* node = getNode(id);
+        if (!node->isErased()) {
+            dest.append(node->cloneInto(dest, mapping));
+        }
+    }
+}
+
+ModuleSnapshot::ModuleSnapshot(IRModule& module, uint32_t numNodes, size_t numErased)
+    : module_(&module), numNodes_(numNodes), numErased_(numErased), saved_(numNodes, false) {}
+
+ModuleSnapshot::~ModuleSnapshot() {
+    if (module_) {
+        module_->snapshot_ = nullptr;
+    }
+}
+
+std::unique_ptr<ModuleSnapshot> IRModule::snapshot() {
+    if (snapshot_) {
+        throw std::runtime_error("IRModule: a snapshot is already active");
+    }
+    std::unique_ptr<ModuleSnapshot> snapshot(new ModuleSnapshot(*this, numNodes_, numErased_));
+    snapshot_ = snapshot.get();
+    return snapshot;
+}
+
+void IRModule::restore(ModuleSnapshot& snapshot) {
+    if (snapshot_ != &snapshot) {
+        throw std::runtime_error("IRModule: snapshot is not active on this module");
+    }
+    
+    // Drop nodes created since the snapshot, then their slabs
+    for (uint32_t id = numNodes_; id-- > snapshot.numNodes_;) {
+        slotAt(id)->~IRNode();
+    }
+    numNodes_ = snapshot.numNodes_;
+    slabs_.resize((numNodes_ + kSlabSize - 1) >> kSlabShift);
+    
+    for (IRNode& saved : snapshot.savedNodes_) {
+        *slotAt(saved.getId()) = std::move(saved);
+    }
+    if (snapshot.bodySaved_) {
+        body_ = std::move(snapshot.body_);
+    }
+    numErased_ = snapshot.numErased_;
+    
+    snapshot.savedNodes_.clear();
+    snapshot.module_ = nullptr;
+    snapshot_ = nullptr;
+}
+
+} // namespace compiler_sim
\ No newline at end of file
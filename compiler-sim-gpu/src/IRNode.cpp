@@ -1,147 +1,545 @@
 #include "compiler_sim/IRNode.h"
-#include <sstream>
-#include <iomanip>
+#include "compiler_sim/IRModule.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <unordered_set>
 
 namespace compiler_sim {
 
-IRNode::IRNode(OpType type, const std::string& name)
-    : type_(type), name_(name) {}
+IRNode::IRNode(IRModule& module, ValueId id, OpType type, NameId name)
+    : module_(&module), id_(id), type_(type), name_(name) {}
 
-IRNode& IRNode::addInput(std::shared_ptr<IRNode> input) {
+void IRNode::willModify() {
+    if (ModuleSnapshot* snapshot = module_->snapshot_) {
+        snapshot->save(*this);
+    }
+}
+
+IRNode& IRNode::addInput(ValueId input) {
+    IRNode* producer = module_->getNode(input);
+    willModify();
+    producer->willModify();
     inputs_.push_back(input);
+    producer->users_.push_back(id_);
     return *this;
 }
 
-IRNode& IRNode::addOutput(std::shared_ptr<IRNode> output) {
+IRNode& IRNode::addOutput(ValueId output) {
+    IRNode* target = module_->getNode(output);
+    willModify();
+    target->willModify();
     outputs_.push_back(output);
+    target->users_.push_back(id_);
+    return *this;
+}
+
+IRNode& IRNode::setInput(size_t index, ValueId input) {
+    if (inputs_.at(index) != input) {
+        willModify();
+        ValueId& slot = inputs_[index];
+        module_->getNode(slot)->removeUser(id_);
+        slot = input;
+        IRNode* producer = module_->getNode(input);
+        producer->willModify();
+        producer->users_.push_back(id_);
+    }
+    return *this;
+}
+
+void IRNode::removeUser(ValueId user) {
+    willModify();
+    for (auto it = users_.begin(); it != users_.end(); ++it) {
+        if (*it == user) {
+            users_.erase(it);
+            return;
+        }
+    }
+}
+
+void IRNode::replaceAllUsesWith(IRNode* replacement) {
+    if (replacement == this) {
+        return;
+    }
+    
+    willModify();
+    replacement->willModify();
+    
+    // Each entry in users_ accounts for exactly one operand slot
+    for (ValueId userId : users_) {
+        IRNode* user = module_->getNode(userId);
+        user->willModify();
+        bool replaced = false;
+        for (ValueId& slot : user->inputs_) {
+            if (slot == id_) {
+                slot = replacement->id_;
+                replaced = true;
+                break;
+            }
+        }
+        if (!replaced) {
+            for (ValueId& slot : user->outputs_) {
+                if (slot == id_) {
+                    slot = replacement->id_;
+                    break;
+                }
+            }
+        }
+        replacement->users_.push_back(userId);
+    }
+    users_.clear();
+}
+
+void IRNode::erase() {
+    if (erased_) {
+        return;
+    }
+    if (!users_.empty()) {
+        throw std::runtime_error("Cannot erase " + getName() + ": value still has uses");
+    }
+    willModify();
+    
+    for (ValueId input : inputs_) {
+        module_->getNode(input)->removeUser(id_);
+    }
+    for (ValueId output : outputs_) {
+        module_->getNode(output)->removeUser(id_);
+    }
+    inputs_.clear();
+    outputs_.clear();
+    
+    erased_ = true;
+    module_->numErased_++;
+}
+
+IRNode& IRNode::appendToRegion(const IRNode* node) {
+    willModify();
+    region_.push_back(node->getId());
+    return *this;
+}
+
+IRNode& IRNode::setRegion(std::vector<ValueId> region) {
+    willModify();
+    region_ = std::move(region);
     return *this;
 }
 
+IRNode* IRNode::getInput(size_t index) const {
+    return module_->getNode(inputs_.at(index));
+}
+
+IRNode* IRNode::getOutput(size_t index) const {
+    return module_->getNode(outputs_.at(index));
+}
+
 IRNode& IRNode::setAttribute(const std::string& key, AttributeValue value) {
-    attributes_[key] = value;
+    return setAttribute(getContext().getAttrKey(key), std::move(value));
+}
+
+IRNode& IRNode::setAttribute(AttrKey key, AttributeValue value) {
+    willModify();
+    auto it = attributes_.begin();
+    while (it != attributes_.end() && it->key < key) {
+        ++it;
+    }
+    if (it != attributes_.end() && it->key == key) {
+        it->value = std::move(value);
+    } else {
+        attributes_.insert(it, Attribute{key, std::move(value)});
+    }
+    return *this;
+}
+
+IRNode& IRNode::setTensorType(const TensorType* type) {
+    willModify();
+    tensorType_ = type;
     return *this;
 }
 
+IRContext& IRNode::getContext() const {
+    return module_->getContext();
+}
+
+const std::string& IRNode::getName() const {
+    return module_->getContext().getIdentifierName(name_);
+}
+
+AttrKey IRNode::lookupAttrKey(const std::string& key) const {
+    return getContext().lookupAttrKey(key);
+}
+
 void IRNode::setDebugLocation(int line, int col) {
+    willModify();
     debug_line_ = line;
     debug_col_ = col;
 }
 
-std::shared_ptr<IRNode> IRNode::clone() const {
-    auto cloned = std::make_shared<IRNode>(type_, name_);
-    cloned->attributes_ = attributes_;
+IRNode* IRNode::clone() const {
+    IRMapping mapping;
+    return clone(mapping);
+}
+
+IRNode* IRNode::clone(IRMapping& mapping) const {
+    IRNode* cloned = cloneShell(*module_);
+    for (ValueId input : inputs_) {
+        cloned->addInput(mapping.lookupOrDefault(input));
+    }
+    for (ValueId output : outputs_) {
+        cloned->addOutput(mapping.lookupOrDefault(output));
+    }
+    mapping.map(id_, cloned->id_);
+    
+    // Members may refer to earlier members, so clone them in order
+    for (ValueId member : region_) {
+        cloned->region_.push_back(module_->getNode(member)->clone(mapping)->id_);
+    }
+    return cloned;
+}
+
+IRNode* IRNode::cloneShell(IRModule& dest) const {
+    IRContext& context = getContext();
+    IRContext& destContext = dest.getContext();
+    if (&context == &destContext) {
+        IRNode* cloned = dest.createNode(type_, name_);
+        cloned->debug_line_ = debug_line_;
+        cloned->debug_col_ = debug_col_;
+        cloned->tensorType_ = tensorType_;
+        cloned->attributes_ = attributes_;
+        return cloned;
+    }
+    
+    // Re-intern the name, types and keys; key order may differ between
+    // contexts
+    IRNode* cloned = dest.createNode(type_, getName());
     cloned->debug_line_ = debug_line_;
     cloned->debug_col_ = debug_col_;
+    if (tensorType_) {
+        cloned->tensorType_ = destContext.getTensorType(tensorType_->getShape(),
+                                                        tensorType_->getDataType(),
+                                                        tensorType_->getLayout());
+    }
+    for (const Attribute& attr : attributes_) {
+        cloned->setAttribute(context.getAttrName(attr.key), attr.value);
+    }
+    return cloned;
+}
+
+IRNode* IRNode::cloneInto(IRModule& dest, IRMapping& mapping) const {
+    if (mapping.contains(id_)) {
+        return dest.getNode(mapping.lookup(id_));
+    }
     
-    // Note: This creates a shallow copy of inputs/outputs
-    // Deep cloning would require a more complex graph traversal
-    cloned->inputs_ = inputs_;
-    cloned->outputs_ = outputs_;
+    // Post-order walk over the operands and region members still to be
+    // cloned, iterative so long chains don't exhaust the stack
+    std::vector<const IRNode*> order;
+    std::vector<std::pair<const IRNode*, size_t>> stack{{this, 0}};
+    std::unordered_set<ValueId> visited{id_};
+    while (!stack.empty()) {
+        const IRNode* node = stack.back().first;
+        size_t next = stack.back().second++;
+        size_t numInputs = node->inputs_.size();
+        size_t numOperands = numInputs + node->outputs_.size();
+        if (next < numOperands + node->region_.size()) {
+            ValueId operand = next < numInputs ? node->inputs_[next]
+                            : next < numOperands ? node->outputs_[next - numInputs]
+                                                 : node->region_[next - numOperands];
+            if (!mapping.contains(operand) && visited.insert(operand).second) {
+                stack.push_back({module_->getNode(operand), 0});
+            }
+        } else {
+            order.push_back(node);
+            stack.pop_back();
+        }
+    }
     
-    return cloned;
+    // Create every clone before wiring operands so cycles resolve
+    for (const IRNode* node : order) {
+        mapping.map(node->id_, node->cloneShell(dest)->id_);
+    }
+    for (const IRNode* node : order) {
+        IRNode* cloned = dest.getNode(mapping.lookup(node->id_));
+        for (ValueId input : node->inputs_) {
+            cloned->addInput(mapping.lookup(input));
+        }
+        for (ValueId output : node->outputs_) {
+            cloned->addOutput(mapping.lookup(output));
+        }
+        for (ValueId member : node->region_) {
+            cloned->region_.push_back(mapping.lookup(member));
+        }
+    }
+    return dest.getNode(mapping.lookup(id_));
 }
 
-std::string IRNode::toString(int indent) const {
-    std::stringstream ss;
-    std::string ind(indent * 2, ' ');
-    
-    ss << ind << "%" << name_ << " = ";
-    
-    switch (type_) {
-        case OpType::MATMUL:
-            ss << "matmul";
-            break;
-        case OpType::ADD:
-            ss << "add";
-            break;
-        case OpType::MUL:
-            ss << "mul";
-            break;
-        case OpType::LOAD:
-            ss << "load";
-            break;
-        case OpType::STORE:
-            ss << "store";
-            break;
-        case OpType::ALLOC:
-            ss << "alloc";
-            break;
-        case OpType::LOOP:
-            ss << "loop";
-            break;
-        case OpType::BLOCK:
-            ss << "block";
-            break;
+const char* opTypeName(OpType type) {
+    switch (type) {
+        case OpType::MATMUL: return "matmul";
+        case OpType::ADD: return "add";
+        case OpType::MUL: return "mul";
+        case OpType::LOAD: return "load";
+        case OpType::STORE: return "store";
+        case OpType::ALLOC: return "alloc";
+        case OpType::LOOP: return "loop";
+        case OpType::BLOCK: return "block";
+        case OpType::TRANSPOSE: return "transpose";
+        case OpType::SCALE: return "scale";
+        case OpType::SOFTMAX: return "softmax";
+        case OpType::CONSTANT: return "constant";
+        case OpType::CAST: return "cast";
     }
+    return "unknown";
+}
+
+namespace {
+
+void appendInt(std::string& out, int64_t value) {
+    char buf[24];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, result.ptr);
+}
+
+void appendFloat(std::string& out, float value) {
+    char buf[32];
+    int len = std::snprintf(buf, sizeof(buf), "%g", value);
+    out.append(buf, len);
+}
+
+} // namespace
+
+void IRNode::print(std::string& out, int indent) const {
+    printImpl(out, indent, nullptr);
+}
+
+void IRNode::print(std::string& out, int indent, ValueNamer& names) const {
+    printImpl(out, indent, &names);
+}
+
+void IRNode::printImpl(std::string& out, int indent, ValueNamer* names) const {
+    auto appendName = [&](const IRNode* node) {
+        out += '%';
+        if (names) {
+            names->appendName(out, node);
+        } else {
+            out += node->getName();
+        }
+    };
+    
+    out.append(indent * 2, ' ');
+    appendName(this);
+    out += " = ";
+    out += opTypeName(type_);
     
     // Print operands
     if (!inputs_.empty()) {
-        ss << "(";
+        out += '(';
         for (size_t i = 0; i < inputs_.size(); ++i) {
-            if (i > 0) ss << ", ";
-            ss << "%" << inputs_[i]->getName();
+            if (i > 0) out += ", ";
+            appendName(module_->getNode(inputs_[i]));
         }
-        ss << ")";
+        out += ')';
     }
     
-    // Print attributes
+    // Print attributes in name order, so the text doesn't depend on the
+    // order the context interned their keys
     if (!attributes_.empty()) {
-        ss << " {";
+        out += " {";
         bool first = true;
-        for (const auto& [key, value] : attributes_) {
-            if (!first) ss << ", ";
+        const IRContext& context = getContext();
+        SmallVector<const Attribute*, 8> sorted;
+        for (const Attribute& attr : attributes_) {
+            sorted.push_back(&attr);
+        }
+        if (sorted.size() > 1) {
+            std::sort(sorted.begin(), sorted.end(), [&](const Attribute* a, const Attribute* b) {
+                return context.getAttrName(a->key) < context.getAttrName(b->key);
+            });
+        }
+        for (const Attribute* attr : sorted) {
+            const AttributeValue& value = attr->value;
+            if (!first) out += ", ";
             first = false;
-            ss << key << " = ";
+            out += context.getAttrName(attr->key);
+            out += " = ";
             
-            std::visit([&ss](const auto& v) {
+            std::visit([&out](const auto& v) {
                 using T = std::decay_t<decltype(v)>;
                 if constexpr (std::is_same_v<T, std::vector<int>>) {
-                    ss << "[";
+                    out += '[';
                     for (size_t i = 0; i < v.size(); ++i) {
-                        if (i > 0) ss << ", ";
-                        ss << v[i];
+                        if (i > 0) out += ", ";
+                        appendInt(out, v[i]);
                     }
-                    ss << "]";
+                    out += ']';
+                } else if constexpr (std::is_same_v<T, std::string>) {
+                    out += v;
+                } else if constexpr (std::is_same_v<T, float>) {
+                    appendFloat(out, v);
                 } else {
-                    ss << v;
+                    appendInt(out, v);
                 }
             }, value);
         }
-        ss << "}";
+        out += '}';
+    }
+    
+    // Result type
+    if (tensorType_) {
+        out += " : ";
+        tensorType_->print(out);
     }
     
     // Debug location
     if (debug_line_ >= 0) {
-        ss << " !loc(" << debug_line_ << ":" << debug_col_ << ")";
+        out += " !loc(";
+        appendInt(out, debug_line_);
+        out += ':';
+        appendInt(out, debug_col_);
+        out += ')';
     }
     
-    return ss.str();
+    // Nested region, one member per line
+    bool openRegion = false;
+    for (ValueId member : region_) {
+        const IRNode* node = module_->getNode(member);
+        if (node->isErased()) {
+            continue;
+        }
+        if (!openRegion) {
+            out += " {";
+            openRegion = true;
+        }
+        out += '\n';
+        node->printImpl(out, indent + 1, names);
+    }
+    if (openRegion) {
+        out += '\n';
+        out.append(indent * 2, ' ');
+        out += '}';
+    }
+}
+
+std::string IRNode::toString(int indent) const {
+    std::string out;
+    print(out, indent);
+    return out;
 }
 
 // Helper factory functions
-std::shared_ptr<IRNode> createMatmul(const std::string& name,
-                                     std::shared_ptr<IRNode> a,
-                                     std::shared_ptr<IRNode> b) {
-    auto node = std::make_shared<IRNode>(OpType::MATMUL, name);
+IRNode* createMatmul(IRModule& module,
+                     const std::string& name,
+                     const IRNode* a,
+                     const IRNode* b) {
+    IRNode* node = module.createNode(OpType::MATMUL, name);
     node->addInput(a).addInput(b);
+    
+    // [..., M, K] x [..., K, N] -> [..., M, N]
+    const TensorType* lhs = a->getTensorType();
+    const TensorType* rhs = b->getTensorType();
+    if (lhs && rhs && lhs->getRank() >= 2 && rhs->getRank() >= 2) {
+        std::vector<int64_t> shape(lhs->getShape().begin(), lhs->getShape().end() - 1);
+        shape.push_back(rhs->getShape().back());
+        node->setTensorType(module.getContext().getTensorType(shape, lhs->getDataType()));
+    }
     return node;
 }
 
-std::shared_ptr<IRNode> createTensor(const std::string& name,
-                                     const std::vector<int>& shape,
-                                     const std::string& dtype) {
-    auto node = std::make_shared<IRNode>(OpType::ALLOC, name);
-    node->setAttribute("shape", shape);
-    node->setAttribute("dtype", dtype);
-    
-    // Calculate size
-    int size = 1;
-    for (int dim : shape) {
-        size *= dim;
+IRNode* createTensor(IRModule& module,
+                     const std::string& name,
+                     const std::vector<int64_t>& shape,
+                     const std::string& dtype) {
+    IRNode* node = module.createNode(OpType::ALLOC, name);
+    node->setTensorType(module.getContext().getTensorType(shape, parseDataType(dtype)));
+    return node;
+}
+
+IRNode* createTranspose(IRModule& module,
+                        const std::string& name,
+                        const IRNode* input,
+                        const std::vector<int>& perm) {
+    IRNode* node = module.createNode(OpType::TRANSPOSE, name);
+    node->addInput(input);
+    if (!perm.empty()) {
+        node->setAttribute("perm", perm);
     }
-    node->setAttribute("size", size);
     
+    const TensorType* type = input->getTensorType();
+    if (type && type->getRank() >= 2) {
+        std::vector<int64_t> shape = type->getShape();
+        if (perm.empty()) {
+            std::swap(shape[shape.size() - 2], shape.back());
+        } else if (perm.size() == shape.size()) {
+            for (size_t i = 0; i < perm.size(); ++i) {
+                shape[i] = type->getShape().at(perm[i]);
+            }
+        }
+        node->setTensorType(module.getContext().getTensorType(shape, type->getDataType()));
+    }
+    return node;
+}
+
+IRNode* createScale(IRModule& module,
+                    const std::string& name,
+                    const IRNode* input,
+                    const IRNode* factor) {
+    IRNode* node = module.createNode(OpType::SCALE, name);
+    node->addInput(input).addInput(factor);
+    node->setTensorType(input->getTensorType());
+    return node;
+}
+
+IRNode* createSoftmax(IRModule& module,
+                      const std::string& name,
+                      const IRNode* input) {
+    IRNode* node = module.createNode(OpType::SOFTMAX, name);
+    node->addInput(input);
+    node->setTensorType(input->getTensorType());
+    return node;
+}
+
+IRNode* createConstant(IRModule& module,
+                       const std::string& name,
+                       float value,
+                       const std::string& dtype) {
+    IRNode* node = module.createNode(OpType::CONSTANT, name);
+    node->setAttribute("value", value);
+    node->setTensorType(module.getContext().getTensorType({}, parseDataType(dtype)));
+    return node;
+}
+
+IRNode* createCast(IRModule& module,
+                   const std::string& name,
+                   const IRNode* input,
+                   DataType dtype) {
+    IRNode* node = module.createNode(OpType::CAST, name);
+    node->addInput(input);
+    if (const TensorType* type = input->getTensorType()) {
+        node->setTensorType(module.getContext().getTensorType(type->getShape(), dtype,
+                                                              type->getLayout()));
+    }
     return node;
 }
 
+bool isHostVisible(const IRNode& tensor) {
+    const IRModule& module = tensor.getModule();
+    bool written = false;
+    bool read = false;
+    for (ValueId userId : tensor.getUsers()) {
+        const IRNode* user = module.getNode(userId);
+        bool writes = std::find(user->getOutputs().begin(), user->getOutputs().end(),
+                                tensor.getId()) != user->getOutputs().end();
+        // A store writes every operand after its value
+        const std::vector<ValueId>& inputs = user->getInputs();
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            if (inputs[i] == tensor.getId()) {
+                (user->getType() == OpType::STORE && i > 0 ? writes : read) = true;
+            }
+        }
+        if (writes) {
+            written = true;
+            read = read || !user->useEmpty();
+        }
+    }
+    return !written || !read;
+}
+
 } // namespace compiler_sim
\ No newline at end of file
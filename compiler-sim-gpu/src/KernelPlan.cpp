@@ -0,0 +1,316 @@
+#include "compiler_sim/KernelPlan.h"
+#include "compiler_sim/IRNode.h"
+#include "compiler_sim/IRModule.h"
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace compiler_sim {
+
+namespace {
+
+// Addresses, indices and loop counters
+const uint32_t kBaseRegisters = 16;
+
+// Tile edges tried by candidateMatmulTiles
+const uint32_t kTileEdges[] = {8, 16, 32, 64, 128};
+const uint32_t kTileDepths[] = {8, 16, 32, 64};
+
+int64_t ceilDiv(int64_t a, int64_t b) {
+    return (a + b - 1) / b;
+}
+
+// Smallest power of two >= value, so odd sizes still try the tile that
+// just covers them
+int64_t roundUpPow2(int64_t value) {
+    int64_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+// Blocks of the kernel and the global memory each one reads and writes
+struct TiledWork {
+    int64_t steps;
+    int64_t blocks;
+    double blockBytes;
+};
+
+TiledWork tiledWork(const MatmulShape& shape, const KernelPlan& plan) {
+    const MatmulTile& tile = plan.tile;
+    TiledWork work;
+    work.steps = ceilDiv(shape.k, tile.k);
+    work.blocks = shape.batch * ceilDiv(shape.m, tile.m) * ceilDiv(shape.n, tile.n);
+    // Shared-memory padding is not read from global memory
+    work.blockBytes = static_cast<double>(work.steps) * (tile.m + tile.n) * tile.k *
+                          plan.elementSize +
+                      static_cast<double>(tile.m) * tile.n * plan.elementSize;
+    return work;
+}
+
+int64_t loopTripCount(const IRNode& loop) {
+    int64_t start = loop.getAttribute<int>("start");
+    int64_t end = loop.getAttribute<int>("end");
+    int64_t step = loop.getAttribute<int>("step");
+    if (step <= 0) {
+        throw std::runtime_error("Loop " + loop.getName() + " has non-positive step");
+    }
+    return end > start ? (end - start + step - 1) / step : 0;
+}
+
+// One iteration of a loop body: instructions issued, the longest chain of
+// dependent results through it, and the values it keeps in registers
+struct BodyCost {
+    double issue = 0.0;
+    double latency = 0.0;
+    uint32_t values = 0;
+};
+
+BodyCost measureBody(const IRModule& module, const std::vector<ValueId>& region,
+                     const CostModelParams& params) {
+    BodyCost cost;
+    std::unordered_map<ValueId, double> ready;
+    for (ValueId id : region) {
+        const IRNode* node = module.getNode(id);
+        double issue = 1.0;
+        double latency = node->getType() == OpType::LOAD ? params.memoryLatencyCycles
+                                                         : params.aluLatencyCycles;
+        // Nested loops and blocks run their bodies in sequence
+        if (node->getType() == OpType::LOOP || node->getType() == OpType::BLOCK) {
+            BodyCost inner = measureBody(module, node->getRegion(), params);
+            double trip = node->getType() == OpType::LOOP
+                              ? static_cast<double>(loopTripCount(*node)) : 1.0;
+            issue = trip * inner.issue;
+            latency = trip * inner.latency;
+            cost.values += inner.values;
+        } else if (node->getType() != OpType::STORE) {
+            ++cost.values;
+        }
+        
+        double start = 0.0;
+        for (ValueId input : node->getInputs()) {
+            auto it = ready.find(input);
+            if (it != ready.end()) {
+                start = std::max(start, it->second);
+            }
+        }
+        ready[id] = start + latency;
+        cost.issue += issue;
+        cost.latency = std::max(cost.latency, start + latency);
+    }
+    return cost;
+}
+
+} // namespace
+
+bool getMatmulShape(const IRNode& matmul, MatmulShape& shape) {
+    const TensorType* result = matmul.getTensorType();
+    const TensorType* lhs = matmul.getInputs().empty() ? nullptr
+                                                       : matmul.getInput(0)->getTensorType();
+    if (!result || !lhs || result->getRank() < 2 || lhs->getRank() < 2) {
+        return false;
+    }
+    const auto& dims = result->getShape();
+    shape.batch = 1;
+    for (size_t i = 0; i + 2 < dims.size(); ++i) {
+        shape.batch *= dims[i];
+    }
+    shape.m = dims[dims.size() - 2];
+    shape.n = dims.back();
+    const bool flagA = matmul.hasAttribute("transpose_a") &&
+                       matmul.getAttribute<int>("transpose_a") != 0;
+    const bool flagB = matmul.hasAttribute("transpose_b") &&
+                       matmul.getAttribute<int>("transpose_b") != 0;
+    shape.k = lhs->getShape()[lhs->getRank() - (flagA ? 2 : 1)];
+    shape.transposeA = flagA != (lhs->getLayout() == Layout::COL_MAJOR);
+    const TensorType* rhs = matmul.getInputs().size() < 2 ? nullptr
+                                                          : matmul.getInput(1)->getTensorType();
+    shape.transposeB = flagB != (rhs && rhs->getLayout() == Layout::COL_MAJOR);
+    const size_t elementSize = getElementSize(result->getDataType());
+    shape.accumulatorSize = static_cast<uint32_t>(
+        matmul.hasAttribute("accumulate")
+            ? getElementSize(parseDataType(matmul.getAttribute<std::string>("accumulate")))
+            : std::max<size_t>(elementSize, 4));
+    return true;
+}
+
+bool getMatmulLaunch(const IRNode& matmul, MatmulLaunch& launch) {
+    MatmulShape shape;
+    if (!matmul.hasAttribute("tile_m") || !matmul.hasAttribute("tile_n") ||
+        !matmul.hasAttribute("block_threads") || !matmul.hasAttribute("shared_memory_bytes") ||
+        !getMatmulShape(matmul, shape)) {
+        return false;
+    }
+    const int64_t tileM = matmul.getAttribute<int>("tile_m");
+    const int64_t tileN = matmul.getAttribute<int>("tile_n");
+    const int64_t threads = matmul.getAttribute<int>("block_threads");
+    launch.kernel = "matmul_kernel";
+    if (shape.transposeA || shape.transposeB) {
+        launch.kernel += std::string("_") + (shape.transposeA ? "t" : "n") +
+                         (shape.transposeB ? "t" : "n");
+    }
+    launch.grid[0] = static_cast<uint32_t>((shape.n + tileN - 1) / tileN);
+    launch.grid[1] = static_cast<uint32_t>((shape.m + tileM - 1) / tileM);
+    launch.grid[2] = static_cast<uint32_t>(shape.batch);
+    const int64_t blockX = std::min(tileN, threads);
+    launch.block[0] = static_cast<uint32_t>(blockX);
+    launch.block[1] = static_cast<uint32_t>(std::max<int64_t>(1, threads / blockX));
+    launch.block[2] = 1;
+    launch.sharedBytes = static_cast<uint64_t>(matmul.getAttribute<int64_t>("shared_memory_bytes"));
+    return true;
+}
+
+std::string formatLaunch(const MatmulLaunch& launch) {
+    return launch.kernel + "<<<(" + std::to_string(launch.grid[0]) + ", " +
+           std::to_string(launch.grid[1]) + ", " + std::to_string(launch.grid[2]) + "), (" +
+           std::to_string(launch.block[0]) + ", " + std::to_string(launch.block[1]) + ", " +
+           std::to_string(launch.block[2]) + ")>>>";
+}
+
+KernelPlan planMatmul(const MatmulTile& tile, size_t elementSize, const DeviceInfo& device,
+                      bool transposeB, size_t accumulatorSize) {
+    KernelPlan plan;
+    plan.tile = tile;
+    plan.elementSize = static_cast<uint32_t>(elementSize);
+    uint32_t outputsPerTile = tile.m * tile.n;
+    plan.threadsPerBlock = std::min(outputsPerTile, device.maxThreadsPerBlock);
+    plan.tileABytes = static_cast<uint32_t>(tile.m * tile.k * elementSize);
+    plan.tileBBytes = static_cast<uint32_t>((transposeB ? tile.n * (tile.k + 1)
+                                                        : tile.k * tile.n) * elementSize);
+    plan.tileBOffset = (plan.tileABytes + 15) / 16 * 16;
+    plan.sharedBytes = plan.tileBOffset + plan.tileBBytes;
+    
+    // Half-precision inputs accumulate in f32 unless told otherwise
+    if (accumulatorSize == 0) {
+        accumulatorSize = std::max<size_t>(elementSize, 4);
+    }
+    uint32_t accumulatorsPerThread = (outputsPerTile + plan.threadsPerBlock - 1) /
+                                     plan.threadsPerBlock;
+    plan.accumulatorBytes = accumulatorsPerThread * static_cast<uint32_t>(accumulatorSize);
+    plan.registersPerThread = kBaseRegisters + (plan.accumulatorBytes + 3) / 4;
+    plan.occupancy = computeOccupancy(device, plan.threadsPerBlock, plan.sharedBytes,
+                                      plan.registersPerThread);
+    return plan;
+}
+
+bool fitsDevice(const KernelPlan& plan, const DeviceInfo& device) {
+    return plan.sharedBytes <= device.sharedMemoryPerBlock &&
+           plan.registersPerThread <= device.maxRegistersPerThread &&
+           plan.occupancy.blocksPerSM > 0;
+}
+
+double estimateMatmulCycles(const MatmulShape& shape, const KernelPlan& plan,
+                            const DeviceInfo& device, const CostModelParams& params) {
+    const MatmulTile& tile = plan.tile;
+    const TiledWork work = tiledWork(shape, plan);
+    const int64_t steps = work.steps;
+    const int64_t blocks = work.blocks;
+    const double blockBytes = work.blockBytes;
+    const double blockFlops = 2.0 * tile.m * tile.n * steps * tile.k;
+    
+    // Compute scales with the SMs a wave keeps busy; bandwidth is shared.
+    // Each K step waits for its tiles, so a wave takes at least that long.
+    const double latencyCycles = steps * params.memoryLatencyCycles;
+    auto waveCycles = [&](int64_t numBlocks) {
+        int64_t activeSMs = std::min<int64_t>(device.numSMs,
+                                              ceilDiv(numBlocks, plan.occupancy.blocksPerSM));
+        double flopsPerCycle = params.flopsPerCycle * activeSMs / device.numSMs;
+        return std::max({numBlocks * blockFlops / flopsPerCycle,
+                         numBlocks * blockBytes / params.bytesPerCycle,
+                         latencyCycles});
+    };
+    
+    int64_t blocksPerWave = static_cast<int64_t>(device.numSMs) * plan.occupancy.blocksPerSM;
+    double cycles = params.launchCycles +
+                    static_cast<double>(blocks / blocksPerWave) * waveCycles(blocksPerWave);
+    if (blocks % blocksPerWave) {
+        cycles += waveCycles(blocks % blocksPerWave);
+    }
+    return cycles;
+}
+
+std::vector<MatmulTile> candidateMatmulTiles(const MatmulShape& shape, size_t elementSize,
+                                             const DeviceInfo& device) {
+    // Tiles much larger than the problem only add padding
+    const int64_t maxM = roundUpPow2(shape.m);
+    const int64_t maxN = roundUpPow2(shape.n);
+    const int64_t maxK = roundUpPow2(shape.k);
+    
+    std::vector<MatmulTile> tiles;
+    for (uint32_t m : kTileEdges) {
+        for (uint32_t n : kTileEdges) {
+            for (uint32_t k : kTileDepths) {
+                if ((m > maxM && m != kTileEdges[0]) || (n > maxN && n != kTileEdges[0]) ||
+                    (k > maxK && k != kTileDepths[0])) {
+                    continue;
+                }
+                if (fitsDevice(planMatmul({m, n, k}, elementSize, device, shape.transposeB,
+                                          shape.accumulatorSize),
+                               device)) {
+                    tiles.push_back({m, n, k});
+                }
+            }
+        }
+    }
+    return tiles;
+}
+
+MatmulTile selectMatmulTile(const MatmulShape& shape, size_t elementSize,
+                            const DeviceInfo& device, const CostModelParams& params) {
+    // Ties go to the tile moving less data
+    bool found = false;
+    MatmulTile best;
+    double bestCycles = 0.0;
+    double bestBytes = 0.0;
+    for (const MatmulTile& tile : candidateMatmulTiles(shape, elementSize, device)) {
+        KernelPlan plan = planMatmul(tile, elementSize, device, shape.transposeB,
+                                     shape.accumulatorSize);
+        double cycles = estimateMatmulCycles(shape, plan, device, params);
+        TiledWork work = tiledWork(shape, plan);
+        double bytes = work.blocks * work.blockBytes;
+        if (!found || cycles < bestCycles || (cycles == bestCycles && bytes < bestBytes)) {
+            found = true;
+            best = tile;
+            bestCycles = cycles;
+            bestBytes = bytes;
+        }
+    }
+    if (!found) {
+        throw std::runtime_error("No matmul tile fits " + device.name);
+    }
+    return best;
+}
+
+double estimateLoopCycles(const IRNode& loop, int unrollFactor, const DeviceInfo& device,
+                          const CostModelParams& params) {
+    const int64_t trip = loopTripCount(loop);
+    const BodyCost body = measureBody(loop.getModule(), loop.getRegion(), params);
+    
+    // Cycles per group of `factor` iterations: the copies issue back to
+    // back and their latency is hidden by the other resident warps
+    auto groupCycles = [&](int64_t factor) {
+        uint32_t registers = kBaseRegisters + body.values * static_cast<uint32_t>(factor);
+        double issue = factor * body.issue;
+        double latency = body.latency;
+        // Each spilled value is stored to local memory and loaded back
+        if (registers > device.maxRegistersPerThread) {
+            issue += 2.0 * (registers - device.maxRegistersPerThread);
+            latency += params.memoryLatencyCycles;
+            registers = device.maxRegistersPerThread;
+        }
+        Occupancy occupancy = computeOccupancy(device, device.warpSize * 8, 0, registers);
+        double residentWarps = std::max(
+            1.0, occupancy.occupancy * device.maxThreadsPerSM / device.warpSize);
+        return params.loopOverheadCycles + std::max(issue, latency / residentWarps);
+    };
+    
+    const int64_t factor = std::max(1, unrollFactor);
+    double cycles = static_cast<double>(trip / factor) * groupCycles(factor);
+    if (trip % factor) {
+        cycles += static_cast<double>(trip % factor) * groupCycles(1);
+    }
+    return cycles;
+}
+
+} // namespace compiler_sim
\ No newline at end of file
@@ -1,53 +1,318 @@
 #include "compiler_sim/PassManager.h"
+#include "compiler_sim/ThreadPool.h"
+#include "compiler_sim/CompileCache.h"
+#include "compiler_sim/IRBytecode.h"
+#include <algorithm>
 #include <iostream>
 #include <chrono>
 
 namespace compiler_sim {
 
+namespace {
+
+// Canonical, so keys don't depend on the order attribute names were interned
+const BytecodeWriteOptions kCacheBytecode{false, true};
+
+bool isReadableBytecode(const std::vector<char>& bytecode) {
+    try {
+        BytecodeReader reader(bytecode.data(), bytecode.size());
+        return true;
+    } catch (const std::runtime_error&) {
+        return false;
+    }
+}
+
+} // namespace
+
 PassManager::PassManager(bool emitIR, bool debug)
     : emitIR_(emitIR), debug_(debug) {}
 
+PassManager::~PassManager() = default;
+
+void PassManager::setNumThreads(size_t numThreads) {
+    numThreads_ = numThreads;
+    pool_.reset();
+}
+
+void PassManager::setCompileCache(const std::string& directory) {
+    cache_ = directory.empty() ? nullptr : std::make_unique<CompileCache>(directory);
+}
+
+void PassManager::resetDebugInfo() {
+    bool captureIR = debugInfo_.isIRCaptureEnabled();
+    debugInfo_ = DebugInfo();
+    debugInfo_.setIRCaptureEnabled(captureIR);
+}
+
 void PassManager::addPass(std::unique_ptr<Pass> pass) {
     passes_.push_back(std::move(pass));
 }
 
-void PassManager::runPasses(std::vector<std::shared_ptr<IRNode>>& nodes) {
-    for (auto& pass : passes_) {
-        if (debug_) {
-            std::cout << "Running pass: " << pass->getName() << "\n";
+void PassManager::addInstrumentation(std::unique_ptr<PassInstrumentation> instrumentation) {
+    instrumentations_.push_back(std::move(instrumentation));
+}
+
+void PassManager::runPasses(IRModule& module) {
+    // The module may have been changed since the last run, and its trace
+    // counts only this run's lookups
+    analyses_.clear();
+    analyses_.resetStats();
+    cachedUnits_.clear();
+    if (cache_) {
+        cachedUnits_[&module];
+        for (const auto& function : module.getFunctions()) {
+            cachedUnits_[function.get()];
+        }
+    }
+    
+    try {
+        for (auto& pass : passes_) {
+            runPass(*pass, module);
+        }
+    } catch (...) {
+        materializeAll(module);
+        cachedUnits_.clear();
+        throw;
+    }
+    materializeAll(module);
+    cachedUnits_.clear();
+    
+    debugInfo_.recordAnalysisStats(analyses_.getStats());
+}
+
+void PassManager::runPass(Pass& pass, IRModule& module) {
+    if (debug_) {
+        std::cout << "Running pass: " << pass.getName() << "\n";
+    }
+    
+    // Capture IR before pass
+    if (emitIR_) {
+        materializeAll(module);
+        irBuffer_.clear();
+        module.print(irBuffer_);
+        emitIRSnapshot("Before " + pass.getName(), irBuffer_);
+    }
+    
+    for (auto& instrumentation : instrumentations_) {
+        instrumentation->beforePass(pass, module);
+    }
+    
+    // Run the pass; only the pass itself is timed
+    debugInfo_.beginPass(pass.getName());
+    size_t hitsBefore = analyses_.getNumHits();
+    size_t missesBefore = analyses_.getNumMisses();
+    if (pass.isFunctionLocal() && !module.getFunctions().empty()) {
+        runOnFunctions(pass, module);
+    } else {
+        runOnUnit(pass, module, debugInfo_);
+    }
+    debugInfo_.recordAnalysisCounts(analyses_.getNumHits() - hitsBefore,
+                                    analyses_.getNumMisses() - missesBefore);
+    debugInfo_.endPass();
+    
+    for (auto it = instrumentations_.rbegin(); it != instrumentations_.rend(); ++it) {
+        (*it)->afterPass(pass, module, debugInfo_);
+    }
+    
+    // Print the IR at most once, and only when something will read it
+    bool captureIR = debugInfo_.isIRCaptureEnabled();
+    if (emitIR_ || captureIR) {
+        materializeAll(module);
+        irBuffer_.clear();
+        module.print(irBuffer_);
+    }
+    
+    // Capture IR after pass
+    if (emitIR_) {
+        emitIRSnapshot("After " + pass.getName(), irBuffer_);
+    }
+    
+    // Record IR snapshot for debug trace
+    if (captureIR) {
+        debugInfo_.recordPassIR(irBuffer_);
+    }
+}
+
+void PassManager::runOnFunctions(Pass& pass, IRModule& module) {
+    // The top-level body goes first, on this thread, so a cost model that
+    // walks the whole module never sees a function mid-rewrite
+    materialize(module);
+    if (!module.getBody().empty()) {
+        runOnUnit(pass, module, debugInfo_);
+    }
+    
+    // Each function records into its own trace; merging them in function
+    // order keeps the result independent of scheduling
+    const auto& functions = module.getFunctions();
+    std::vector<DebugInfo> traces(functions.size());
+    auto runFunction = [&](size_t i) {
+        traces[i].beginPass(pass.getName());
+        runOnUnit(pass, *functions[i], traces[i]);
+        traces[i].endPass();
+    };
+    
+    if (numThreads_ == 1 || functions.size() == 1) {
+        for (size_t i = 0; i < functions.size(); ++i) {
+            runFunction(i);
+        }
+    } else {
+        if (!pool_) {
+            pool_ = std::make_unique<ThreadPool>(numThreads_);
+        }
+        pool_->parallelFor(functions.size(), runFunction);
+    }
+    
+    const IRContext& context = module.getContext();
+    for (size_t i = 0; i < functions.size(); ++i) {
+        debugInfo_.mergePassTrace(
+            traces[i], context.getIdentifierName(functions[i]->getFunctionName()));
+    }
+}
+
+void PassManager::runOnUnit(Pass& pass, IRModule& unit, DebugInfo& debugInfo) {
+    // Replacing a unit from the cache keeps its functions, so a pass that
+    // could have changed them is never cached
+    if (cache_ && pass.isCacheable() &&
+        (pass.isFunctionLocal() || unit.getFunctions().empty())) {
+        runCached(pass, unit, debugInfo);
+        return;
+    }
+    if (cache_) {
+        // The pass may read or change any function
+        materializeAll(unit);
+        for (auto& [module, state] : cachedUnits_) {
+            state.bytecode.clear();
         }
-        
-        debugInfo_.beginPass(pass->getName());
-        
-        // Capture IR before pass
-        if (emitIR_) {
-            emitIRSnapshot("Before " + pass->getName(), nodes);
+    }
+    runUncached(pass, unit, debugInfo);
+}
+
+void PassManager::runCached(Pass& pass, IRModule& unit, DebugInfo& debugInfo) {
+    auto start = std::chrono::steady_clock::now();
+    CachedUnit& state = cachedUnits_.at(&unit);
+    if (state.bytecode.empty()) {
+        state.bytecode = writeBytecode(unit, kCacheBytecode);
+    }
+    uint64_t key = CompileCache::fingerprint(pass.getName(), pass.getOptions(),
+                                             state.bytecode);
+    
+    // Damaged entries are recomputed and overwritten
+    CompileCache::Entry entry;
+    if (cache_->lookup(key, entry) && isReadableBytecode(entry.bytecode)) {
+        // The unit is rebuilt only when something needs its nodes, so a run
+        // of hits just chains entries
+        state.bytecode = std::move(entry.bytecode);
+        state.pending = true;
+        analyses_.invalidate(unit, PreservedAnalyses::none());
+        for (const std::string& description : entry.transformations) {
+            debugInfo.recordTransformation(description);
         }
-        
-        // Run the pass
-        pass->run(nodes, debugInfo_);
-        
-        // Capture IR after pass
-        if (emitIR_) {
-            emitIRSnapshot("After " + pass->getName(), nodes);
+        for (const CompileCache::MemoryMapping& mapping : entry.memoryMappings) {
+            debugInfo.recordMemoryMapping(mapping.tensor, mapping.offset, mapping.size,
+                                          mapping.space);
         }
-        
-        // Record IR snapshot for debug trace
-        std::string irAfter;
-        for (const auto& node : nodes) {
-            irAfter += node->toString() + "\n";
+        for (const auto& [name, value] : entry.counters) {
+            debugInfo.addPassCounter(name, value);
         }
-        debugInfo_.endPass(irAfter);
+        // Net of the lookup, so a pass cheaper than its lookup shows a loss
+        std::chrono::duration<double, std::milli> overhead =
+            std::chrono::steady_clock::now() - start;
+        debugInfo.recordCacheHit(entry.passTimeMs - overhead.count());
+        return;
+    }
+    
+    // Traced on its own so the entry holds exactly what this unit recorded
+    materialize(unit);
+    DebugInfo unitTrace;
+    unitTrace.beginPass(pass.getName());
+    runUncached(pass, unit, unitTrace);
+    unitTrace.endPass();
+    
+    const PassTrace& trace = unitTrace.getPassTraces().back();
+    entry = CompileCache::Entry();
+    entry.passTimeMs = trace.executionTimeMs;
+    entry.transformations = trace.transformations;
+    entry.counters = trace.counters;
+    for (const auto& [tensor, mapping] : unitTrace.getMemoryMap()) {
+        entry.memoryMappings.push_back({tensor, mapping.offset, mapping.size, mapping.space});
     }
+    std::sort(entry.memoryMappings.begin(), entry.memoryMappings.end(),
+              [](const auto& a, const auto& b) { return a.tensor < b.tensor; });
+    entry.bytecode = writeBytecode(unit, kCacheBytecode);
+    cache_->store(key, entry);
+    state.bytecode = std::move(entry.bytecode);
+    
+    debugInfo.mergePassTrace(unitTrace, "");
+    debugInfo.recordCacheMiss();
 }
 
-void PassManager::emitIRSnapshot(const std::string& passName,
-                                const std::vector<std::shared_ptr<IRNode>>& nodes) {
-    std::cout << "\n=== " << passName << " ===\n";
-    for (const auto& node : nodes) {
-        std::cout << node->toString() << "\n";
+void PassManager::materialize(IRModule& unit) {
+    auto it = cachedUnits_.find(&unit);
+    if (it == cachedUnits_.end() || !it->second.pending) {
+        return;
     }
-    std::cout << "\n";
+    BytecodeReader reader(it->second.bytecode.data(), it->second.bytecode.size());
+    unit.clear();
+    readModule(reader, unit);
+    it->second.pending = false;
+}
+
+void PassManager::materializeAll(IRModule& module) {
+    materialize(module);
+    for (const auto& function : module.getFunctions()) {
+        materialize(*function);
+    }
+}
+
+void PassManager::runUncached(Pass& pass, IRModule& unit, DebugInfo& debugInfo) {
+    if (costModel_) {
+        runWithRollback(pass, unit, debugInfo);
+    } else {
+        PreservedAnalyses preserved = PreservedAnalyses::none();
+        try {
+            preserved = pass.run(unit, analyses_, debugInfo);
+        } catch (...) {
+            analyses_.invalidate(unit, PreservedAnalyses::none());
+            throw;
+        }
+        analyses_.invalidate(unit, preserved);
+        unit.compact();
+    }
+}
+
+void PassManager::runWithRollback(Pass& pass, IRModule& unit, DebugInfo& debugInfo) {
+    double costBefore = costModel_(unit);
+    auto checkpoint = unit.snapshot();
+    TraceCheckpoint trace = debugInfo.checkpoint();
+    PreservedAnalyses preserved = PreservedAnalyses::none();
+    try {
+        preserved = pass.run(unit, analyses_, debugInfo);
+    } catch (...) {
+        // Leave the module as it was before the failing pass; results
+        // computed while it ran may describe the discarded IR
+        unit.restore(*checkpoint);
+        analyses_.invalidate(unit, PreservedAnalyses::none());
+        throw;
+    }
+    analyses_.invalidate(unit, preserved);
+    unit.compact();
+    
+    double costAfter = costModel_(unit);
+    if (costAfter > costBefore) {
+        unit.restore(*checkpoint);
+        analyses_.invalidate(unit, PreservedAnalyses::none());
+        debugInfo.restore(trace);
+        debugInfo.recordTransformation("Rolled back: cost " + std::to_string(costBefore) +
+                                       " -> " + std::to_string(costAfter));
+        if (debug_) {
+            std::cout << ("Rolled back pass: " + pass.getName() + "\n");
+        }
+    }
+}
+
+void PassManager::emitIRSnapshot(const std::string& passName,
+                                const std::string& ir) {
+    std::cout << "\n=== " << passName << " ===\n" << ir << "\n";
 }
 
 } // namespace compiler_sim
\ No newline at end of file
@@ -0,0 +1,181 @@
+#include "compiler_sim/PassProfiler.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace compiler_sim {
+
+namespace {
+
+// Trace counter names, hardware events first in PassProfiler's order
+const char* const kEventNames[] = {"cycles", "instructions", "cache_misses", "branch_misses"};
+const char* const kHeapNames[] = {"bytes_allocated", "allocations", "peak_heap_bytes"};
+
+#if defined(__linux__)
+const uint64_t kEventConfigs[] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+// Counts user-space events of the calling thread on any CPU. The enabled
+// and running times let reads be scaled when the kernel multiplexes.
+int openEvent(uint64_t config) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+}
+#endif
+
+} // namespace
+
+PassProfiler::PassProfiler() {
+    fds_.fill(-1);
+#if defined(__linux__)
+    for (size_t i = 0; i < kNumEvents; ++i) {
+        fds_[i] = openEvent(kEventConfigs[i]);
+        if (fds_[i] < 0 && unavailableReason_.empty()) {
+            unavailableReason_ = std::string("perf_event_open failed for ") +
+                                 kEventNames[i] + ": " + std::strerror(errno);
+        }
+    }
+#else
+    unavailableReason_ = "hardware counters need Linux perf events";
+#endif
+    AllocationCounter::enable();
+}
+
+PassProfiler::~PassProfiler() {
+    AllocationCounter::disable();
+#if defined(__linux__)
+    for (int fd : fds_) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+#endif
+}
+
+bool PassProfiler::hasHardwareCounters() const {
+    return std::any_of(fds_.begin(), fds_.end(), [](int fd) { return fd >= 0; });
+}
+
+uint64_t PassProfiler::readEvent(size_t event) const {
+#if defined(__linux__)
+    // value, time enabled, time running
+    uint64_t values[3] = {};
+    if (read(fds_[event], values, sizeof(values)) != sizeof(values) || values[2] == 0) {
+        return 0;
+    }
+    if (values[2] >= values[1]) {
+        return values[0];
+    }
+    return static_cast<uint64_t>(static_cast<long double>(values[0]) * values[1] / values[2]);
+#else
+    (void)event;
+    return 0;
+#endif
+}
+
+void PassProfiler::beforePass(const Pass&, const IRModule&) {
+    AllocationCounter::resetPeak();
+    allocStart_ = AllocationCounter::getStats();
+    // Read last so the reads above aren't counted
+    for (size_t i = 0; i < kNumEvents; ++i) {
+        if (fds_[i] >= 0) {
+            start_[i] = readEvent(i);
+        }
+    }
+}
+
+void PassProfiler::afterPass(const Pass&, const IRModule&, DebugInfo& debugInfo) {
+    std::array<uint64_t, kNumEvents> end{};
+    for (size_t i = 0; i < kNumEvents; ++i) {
+        if (fds_[i] >= 0) {
+            end[i] = readEvent(i);
+        }
+    }
+    AllocationStats alloc = AllocationCounter::getStats();
+    
+    for (size_t i = 0; i < kNumEvents; ++i) {
+        if (fds_[i] >= 0) {
+            debugInfo.recordPassCounter(kEventNames[i], end[i] - start_[i]);
+        }
+    }
+    int64_t peak = std::max<int64_t>(alloc.peakLiveBytes - allocStart_.liveBytes, 0);
+    debugInfo.recordPassCounter(kHeapNames[0], alloc.bytesAllocated - allocStart_.bytesAllocated);
+    debugInfo.recordPassCounter(kHeapNames[1], alloc.numAllocations - allocStart_.numAllocations);
+    debugInfo.recordPassCounter(kHeapNames[2], static_cast<uint64_t>(peak));
+}
+
+void printPassTimings(const DebugInfo& debugInfo, std::ostream& os) {
+    std::vector<std::string> columns(std::begin(kEventNames), std::end(kEventNames));
+    columns.insert(columns.end(), std::begin(kHeapNames), std::end(kHeapNames));
+    const std::vector<PassTrace>& traces = debugInfo.getPassTraces();
+    
+    size_t nameWidth = 4;
+    for (const PassTrace& trace : traces) {
+        nameWidth = std::max(nameWidth, trace.passName.size());
+    }
+    
+    // Totals sum every column except the peak, which takes the maximum
+    std::vector<uint64_t> totals(columns.size(), 0);
+    std::vector<bool> present(columns.size(), false);
+    double totalMs = 0.0;
+    
+    auto cell = [](bool known, uint64_t value) {
+        return known ? std::to_string(value) : std::string("-");
+    };
+    
+    std::ostringstream out;
+    out << std::left << std::setw(nameWidth) << "Pass" << std::right
+        << std::setw(12) << "time_ms";
+    for (const std::string& column : columns) {
+        out << std::setw(16) << column;
+    }
+    out << "\n";
+    
+    out << std::fixed << std::setprecision(3);
+    for (const PassTrace& trace : traces) {
+        out << std::left << std::setw(nameWidth) << trace.passName << std::right
+            << std::setw(12) << trace.executionTimeMs;
+        totalMs += trace.executionTimeMs;
+        for (size_t c = 0; c < columns.size(); ++c) {
+            auto it = std::find_if(trace.counters.begin(), trace.counters.end(),
+                                   [&](const auto& counter) { return counter.first == columns[c]; });
+            bool known = it != trace.counters.end();
+            if (known) {
+                present[c] = true;
+                totals[c] = columns[c] == kHeapNames[2] ? std::max(totals[c], it->second)
+                                                         : totals[c] + it->second;
+            }
+            out << std::setw(16) << cell(known, known ? it->second : 0);
+        }
+        out << "\n";
+    }
+    
+    out << std::left << std::setw(nameWidth) << "Total" << std::right
+        << std::setw(12) << totalMs;
+    for (size_t c = 0; c < columns.size(); ++c) {
+        out << std::setw(16) << cell(present[c], totals[c]);
+    }
+    out << "\n";
+    os << out.str();
+}
+
+} // namespace compiler_sim
\ No newline at end of file
@@ -0,0 +1,182 @@
+#include "compiler_sim/PatternRewriter.h"
+#include "compiler_sim/IRModule.h"
+#include "compiler_sim/DebugInfo.h"
+#include <algorithm>
+
+namespace compiler_sim {
+
+void RewritePatternSet::add(std::unique_ptr<RewritePattern> pattern) {
+    auto& bucket = byRoot_[static_cast<size_t>(pattern->getRootType())];
+    // Stable for equal benefits, so registration order breaks ties
+    auto it = std::upper_bound(bucket.begin(), bucket.end(), pattern->getBenefit(),
+                               [](unsigned benefit, const std::unique_ptr<RewritePattern>& p) {
+                                   return benefit > p->getBenefit();
+                               });
+    bucket.insert(it, std::move(pattern));
+    ++size_;
+}
+
+PatternRewriter::PatternRewriter(IRModule& module, DebugInfo* debugInfo)
+    : module_(module), debugInfo_(debugInfo), topLevel_(module.getNumNodes(), false) {
+    for (ValueId id : module.getBody()) {
+        topLevel_[id] = true;
+    }
+}
+
+IRContext& PatternRewriter::getContext() const {
+    return module_.getContext();
+}
+
+void PatternRewriter::enqueue(ValueId id) {
+    // Region members keep their place only in their region, which the
+    // body rebuild does not touch
+    if (id >= topLevel_.size() || !topLevel_[id]) {
+        return;
+    }
+    if (id >= inWorklist_.size()) {
+        inWorklist_.resize(std::max<size_t>(id + 1, inWorklist_.size() * 2), false);
+    }
+    if (!inWorklist_[id]) {
+        inWorklist_[id] = true;
+        worklist_.push_back(id);
+    }
+}
+
+void PatternRewriter::enqueueUsers(const IRNode* op) {
+    for (ValueId user : op->getUsers()) {
+        enqueue(user);
+    }
+}
+
+ValueId PatternRewriter::pop() {
+    ValueId id = worklist_.front();
+    worklist_.pop_front();
+    inWorklist_[id] = false;
+    return id;
+}
+
+IRNode* PatternRewriter::create(OpType type, NameId name) {
+    IRNode* node = module_.createNode(type, name);
+    topLevel_.resize(module_.getNumNodes(), false);
+    topLevel_[node->getId()] = true;
+    unplaced_.insert(node->getId());
+    enqueue(node->getId());
+    return node;
+}
+
+void PatternRewriter::insertBefore(const IRNode* anchor, IRNode* node) {
+    if (unplaced_.erase(node->getId())) {
+        insertions_[anchor->getId()].push_back(node->getId());
+    }
+}
+
+void PatternRewriter::replaceOp(IRNode* op, IRNode* replacement) {
+    enqueueUsers(op);
+    op->replaceAllUsesWith(replacement);
+    if (unplaced_.erase(replacement->getId())) {
+        slotReplacement_[op->getId()] = replacement->getId();
+    }
+    enqueue(replacement->getId());
+    eraseOp(op);
+}
+
+void PatternRewriter::eraseOp(IRNode* op) {
+    // Producers lose a use, which may enable further rewrites
+    for (ValueId input : op->getInputs()) {
+        enqueue(input);
+    }
+    for (ValueId output : op->getOutputs()) {
+        enqueue(output);
+    }
+    op->erase();
+}
+
+void PatternRewriter::notifyModified(IRNode* op) {
+    enqueue(op->getId());
+    enqueueUsers(op);
+}
+
+void PatternRewriter::notifyTransformation(const std::string& description) {
+    if (debugInfo_) {
+        debugInfo_->recordTransformation(description);
+    }
+}
+
+void PatternRewriter::addPassCounter(const std::string& name, uint64_t value) {
+    if (debugInfo_) {
+        debugInfo_->addPassCounter(name, value);
+    }
+}
+
+void PatternRewriter::rebuildBody() {
+    if (slotReplacement_.empty() && insertions_.empty()) {
+        return;
+    }
+    
+    std::vector<ValueId>& body = module_.getBody();
+    std::vector<ValueId> newBody;
+    newBody.reserve(body.size() + insertions_.size());
+    for (ValueId id : body) {
+        // Follow the chain of replacements, emitting nodes inserted before
+        // any node along it
+        while (true) {
+            auto inserted = insertions_.find(id);
+            if (inserted != insertions_.end()) {
+                newBody.insert(newBody.end(), inserted->second.begin(), inserted->second.end());
+            }
+            auto next = slotReplacement_.find(id);
+            if (next == slotReplacement_.end()) {
+                break;
+            }
+            id = next->second;
+        }
+        newBody.push_back(id);
+    }
+    body = std::move(newBody);
+}
+
+GreedyRewriteResult applyPatternsGreedily(IRModule& module,
+                                          const RewritePatternSet& patterns,
+                                          DebugInfo* debugInfo,
+                                          const GreedyRewriteConfig& config) {
+    GreedyRewriteResult result;
+    if (patterns.empty()) {
+        return result;
+    }
+    
+    PatternRewriter rewriter(module, debugInfo);
+    for (ValueId id : module.getBody()) {
+        rewriter.enqueue(id);
+    }
+    size_t maxRewrites = config.maxRewrites ? config.maxRewrites
+                                            : 10 * module.getNumNodes() + 1000;
+    
+    while (!rewriter.worklist_.empty()) {
+        IRNode* op = module.getNode(rewriter.pop());
+        if (op->isErased()) {
+            continue;
+        }
+        
+        for (const auto& pattern : patterns.getPatterns(op->getType())) {
+            if (pattern->matchAndRewrite(op, rewriter)) {
+                ++result.numRewrites;
+                break;
+            }
+        }
+        
+        if (result.numRewrites >= maxRewrites) {
+            result.converged = rewriter.worklist_.empty();
+            break;
+        }
+    }
+    
+    rewriter.rebuildBody();
+    if (!result.converged) {
+        rewriter.notifyTransformation("Pattern rewriting stopped after " +
+                                      std::to_string(result.numRewrites) +
+                                      " rewrites without converging");
+    }
+    return result;
+}
+
+} // namespace compiler_sim
\ No newline at end of file
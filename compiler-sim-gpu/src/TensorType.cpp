@@ -0,0 +1,81 @@
+#include "compiler_sim/TensorType.h"
+#include <charconv>
+#include <stdexcept>
+
+namespace compiler_sim {
+
+size_t getElementSize(DataType dtype) {
+    switch (dtype) {
+        case DataType::F32: return 4;
+        case DataType::F16: return 2;
+        case DataType::BF16: return 2;
+        case DataType::F64: return 8;
+        case DataType::I32: return 4;
+    }
+    return 4;
+}
+
+const char* dataTypeName(DataType dtype) {
+    switch (dtype) {
+        case DataType::F32: return "f32";
+        case DataType::F16: return "f16";
+        case DataType::BF16: return "bf16";
+        case DataType::F64: return "f64";
+        case DataType::I32: return "i32";
+    }
+    return "f32";
+}
+
+DataType parseDataType(const std::string& name) {
+    if (name == "f32") return DataType::F32;
+    if (name == "f16") return DataType::F16;
+    if (name == "bf16") return DataType::BF16;
+    if (name == "f64") return DataType::F64;
+    if (name == "i32") return DataType::I32;
+    throw std::invalid_argument("Unknown dtype: " + name);
+}
+
+const char* layoutName(Layout layout) {
+    switch (layout) {
+        case Layout::ROW_MAJOR: return "row_major";
+        case Layout::COL_MAJOR: return "col_major";
+        case Layout::TILED: return "tiled";
+    }
+    return "row_major";
+}
+
+TensorType::TensorType(std::vector<int64_t> shape, DataType dtype, Layout layout)
+    : shape_(std::move(shape)), dtype_(dtype), layout_(layout) {
+    numElements_ = 1;
+    for (int64_t dim : shape_) {
+        if (dim < 0) {
+            throw std::invalid_argument("Negative tensor dimension: " + std::to_string(dim));
+        }
+        numElements_ *= dim;
+    }
+    byteSize_ = static_cast<uint64_t>(numElements_) * getElementSize(dtype_);
+}
+
+void TensorType::print(std::string& out) const {
+    out += "tensor<";
+    for (int64_t dim : shape_) {
+        char buf[24];
+        auto result = std::to_chars(buf, buf + sizeof(buf), dim);
+        out.append(buf, result.ptr);
+        out += 'x';
+    }
+    out += dataTypeName(dtype_);
+    if (layout_ != Layout::ROW_MAJOR) {
+        out += ", ";
+        out += layoutName(layout_);
+    }
+    out += '>';
+}
+
+std::string TensorType::toString() const {
+    std::string out;
+    print(out);
+    return out;
+}
+
+} // namespace compiler_sim
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include "compiler_sim/ThreadPool.h"
+
+namespace compiler_sim {
+
+ThreadPool::ThreadPool(size_t numThreads) {
+    if (numThreads == 0) {
+        numThreads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+    queues_.reserve(numThreads);
+    for (size_t i = 0; i < numThreads; ++i) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+    workers_.reserve(numThreads);
+    for (size_t i = 0; i < numThreads; ++i) {
+        workers_.emplace_back([this, i] { workerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(stateMutex_);
+        stopping_ = true;
+    }
+    wakeCv_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    size_t target;
+    {
+        std::lock_guard<std::mutex> lock(stateMutex_);
+        target = nextQueue_;
+        nextQueue_ = (nextQueue_ + 1) % queues_.size();
+        ++pending_;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queues_[target]->mutex);
+        queues_[target]->tasks.push_back(std::move(task));
+    }
+    // Counted only once the task is reachable, so a woken worker finds it
+    {
+        std::lock_guard<std::mutex> lock(stateMutex_);
+        ++queued_;
+    }
+    wakeCv_.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(stateMutex_);
+    doneCv_.wait(lock, [this] { return pending_ == 0; });
+    if (firstError_) {
+        std::exception_ptr error = firstError_;
+        firstError_ = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void ThreadPool::parallelFor(size_t n, const std::function<void(size_t)>& fn) {
+    for (size_t i = 0; i < n; ++i) {
+        submit([&fn, i] { fn(i); });
+    }
+    wait();
+}
+
+bool ThreadPool::popOrSteal(size_t self, std::function<void()>& task) {
+    {
+        Queue& own = *queues_[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t i = 1; i < queues_.size(); ++i) {
+        Queue& victim = *queues_[(self + i) % queues_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(size_t self) {
+    for (;;) {
+        {
+            // Claim a queued task before searching, so exactly one worker
+            // goes looking for each one
+            std::unique_lock<std::mutex> lock(stateMutex_);
+            wakeCv_.wait(lock, [this] { return stopping_ || queued_ > 0; });
+            if (queued_ == 0) {
+                return;
+            }
+            --queued_;
+        }
+
+        std::function<void()> task;
+        while (!popOrSteal(self, task)) {
+            // Another worker took the task we were counted for; the one it
+            // was counted for is still reachable somewhere, so look again
+            std::this_thread::yield();
+        }
+
+        std::exception_ptr error;
+        try {
+            task();
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock(stateMutex_);
+        if (error && !firstError_) {
+            firstError_ = error;
+        }
+        if (--pending_ == 0) {
+            doneCv_.notify_all();
+        }
+    }
+}
+
+} // namespace compiler_sim
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "compiler_sim/TuningDatabase.h"
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <json/json.h>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+
+namespace compiler_sim {
+
+TuningDatabase::TuningDatabase(std::string path, std::string target)
+    : path_(std::move(path)), target_(std::move(target)) {
+    std::ifstream file(path_);
+    if (!file) {
+        return;
+    }
+    Json::CharReaderBuilder builder;
+    Json::Value root;
+    std::string errors;
+    if (!Json::parseFromStream(builder, file, &root, &errors) || !root.isObject() ||
+        root["target"].asString() != target_ || !root["entries"].isObject()) {
+        return;
+    }
+    
+    const Json::Value& entries = root["entries"];
+    for (const std::string& key : entries.getMemberNames()) {
+        const Json::Value& entry = entries[key];
+        const Json::Value& tile = entry["tile"];
+        if (!entry.isObject() || !tile.isArray() || tile.size() != 3) {
+            continue;
+        }
+        TuningConfig config;
+        config.tile = {tile[0].asUInt(), tile[1].asUInt(), tile[2].asUInt()};
+        config.fuse = entry["fuse"].asBool();
+        config.unrollFactor = entry["unroll_factor"].asInt();
+        config.cycles = entry["cycles"].asDouble();
+        entries_[key] = config;
+    }
+}
+
+bool TuningDatabase::lookup(const std::string& key, TuningConfig& config) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+        return false;
+    }
+    config = it->second;
+    return true;
+}
+
+void TuningDatabase::record(const std::string& key, const TuningConfig& config) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_[key] = config;
+}
+
+size_t TuningDatabase::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+bool TuningDatabase::save() const {
+    Json::Value root;
+    root["target"] = target_;
+    root["entries"] = Json::objectValue;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& [key, config] : entries_) {
+            Json::Value entry;
+            entry["tile"].append(config.tile.m);
+            entry["tile"].append(config.tile.n);
+            entry["tile"].append(config.tile.k);
+            entry["fuse"] = config.fuse;
+            entry["unroll_factor"] = config.unrollFactor;
+            entry["cycles"] = config.cycles;
+            root["entries"][key] = entry;
+        }
+    }
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "  ";
+    
+    // Unique per process and thread, so concurrent savers never collide
+    std::string temp = path_ + ".tmp." + std::to_string(::getpid()) + "." +
+                       std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    std::ofstream file(temp);
+    file << Json::writeString(builder, root);
+    file.close();
+    std::error_code error;
+    if (!file) {
+        std::filesystem::remove(temp, error);
+        return false;
+    }
+    std::filesystem::rename(temp, path_, error);
+    if (error) {
+        std::filesystem::remove(temp, error);
+        return false;
+    }
+    return true;
+}
+
+std::string describeTuningTarget(const DeviceInfo& device, const CostModelParams& params) {
+    std::ostringstream out;
+    out << device.describe() << " flops=" << params.flopsPerCycle
+        << " bytes=" << params.bytesPerCycle << " launch=" << params.launchCycles
+        << " memory_latency=" << params.memoryLatencyCycles
+        << " alu_latency=" << params.aluLatencyCycles
+        << " loop_overhead=" << params.loopOverheadCycles;
+    return out.str();
+}
+
+} // namespace compiler_sim
\ No newline at end of file
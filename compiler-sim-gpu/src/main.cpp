@@ -3,10 +3,28 @@
 #include <memory>
 #include <vector>
 #include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <filesystem>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include "compiler_sim/BatchCompile.h"
 #include "compiler_sim/IRNode.h"
+#include "compiler_sim/IRModule.h"
+#include "compiler_sim/IRBytecode.h"
+#include "compiler_sim/KernelPlan.h"
 #include "compiler_sim/PassManager.h"
+#include "compiler_sim/PassProfiler.h"
 #include "compiler_sim/DebugInfo.h"
 #include "compiler_sim/SymbolTable.h"
+#include "compiler_sim/ThreadPool.h"
+#include "compiler_sim/CompileServer.h"
+#include "compiler_sim/TuningDatabase.h"
 
 using namespace compiler_sim;
 
@@ -15,80 +33,610 @@ struct CLIOptions {
     bool emitIR = false;
     bool debug = false;
     bool simulateGPU = false;
+    bool traceIR = false;
     std::string outputTrace = "trace.json";
+    std::string emitBytecode;
+    std::string loadBytecode;
+    size_t numThreads = 0;
+    std::string cacheDir;
+    bool timePasses = false;
+    std::string batch;
+    std::string server;
+    std::string connect;
+    bool autotune = false;
+    std::string tuningDb = "tuning_db.json";
+    std::string precision;
+    std::vector<std::string> keepF32;
+    bool halfAccumulate = false;
 };
 
 CLIOptions parseArgs(int argc, char* argv[]) {
     CLIOptions options;
     
-    if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <input.dsl> [options]\n";
-        std::cerr << "Options:\n";
-        std::cerr << "  --emit-ir       Emit IR after each pass\n";
-        std::cerr << "  --debug         Enable debug output\n";
-        std::cerr << "  --simulate-gpu  Run GPU simulation\n";
-        std::cerr << "  --trace <file>  Output trace file (default: trace.json)\n";
-        exit(1);
-    }
-    
-    options.inputFile = argv[1];
-    
-    for (int i = 2; i < argc; i++) {
+    for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--emit-ir") == 0) {
             options.emitIR = true;
         } else if (strcmp(argv[i], "--debug") == 0) {
             options.debug = true;
         } else if (strcmp(argv[i], "--simulate-gpu") == 0) {
             options.simulateGPU = true;
+        } else if (strcmp(argv[i], "--trace-ir") == 0) {
+            options.traceIR = true;
+        } else if (strcmp(argv[i], "--time-passes") == 0) {
+            options.timePasses = true;
+        } else if (strcmp(argv[i], "--autotune") == 0) {
+            options.autotune = true;
+        } else if (strcmp(argv[i], "--half-accumulate") == 0) {
+            options.halfAccumulate = true;
+        } else if (strcmp(argv[i], "--precision") == 0 && i + 1 < argc) {
+            options.precision = argv[++i];
+            if (options.precision != "f16" && options.precision != "bf16") {
+                std::cerr << "Error: --precision takes f16 or bf16\n";
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "--keep-f32") == 0 && i + 1 < argc) {
+            options.keepF32.push_back(argv[++i]);
+        } else if (strcmp(argv[i], "--tuning-db") == 0 && i + 1 < argc) {
+            options.tuningDb = argv[++i];
         } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
             options.outputTrace = argv[++i];
+        } else if (strcmp(argv[i], "--emit-bc") == 0 && i + 1 < argc) {
+            options.emitBytecode = argv[++i];
+        } else if (strcmp(argv[i], "--load-bc") == 0 && i + 1 < argc) {
+            options.loadBytecode = argv[++i];
+        } else if (strcmp(argv[i], "--cache-dir") == 0 && i + 1 < argc) {
+            options.cacheDir = argv[++i];
+        } else if (strcmp(argv[i], "--server") == 0 && i + 1 < argc) {
+            options.server = argv[++i];
+        } else if (strcmp(argv[i], "--connect") == 0 && i + 1 < argc) {
+            options.connect = argv[++i];
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            options.batch = argv[++i];
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.numThreads = std::stoul(argv[++i]);
+        } else if (options.inputFile.empty() && argv[i][0] != '-') {
+            options.inputFile = argv[i];
         }
     }
     
+    if (options.inputFile.empty() && options.loadBytecode.empty() && options.batch.empty() &&
+        options.server.empty()) {
+        std::cerr << "Usage: " << argv[0] << " <input.dsl> [options]\n";
+        std::cerr << "       " << argv[0] << " --load-bc <module.csbc> [options]\n";
+        std::cerr << "       " << argv[0] << " --batch <list-file|dir> [options]\n";
+        std::cerr << "       " << argv[0] << " --server <socket> [options]\n";
+        std::cerr << "       " << argv[0] << " --connect <socket> <input.dsl> [options]\n";
+        std::cerr << "Options:\n";
+        std::cerr << "  --emit-ir         Emit IR after each pass\n";
+        std::cerr << "  --debug           Enable debug output\n";
+        std::cerr << "  --simulate-gpu    Run GPU simulation\n";
+        std::cerr << "  --trace <file>    Output trace file (default: trace.json)\n";
+        std::cerr << "  --trace-ir        Include the IR after each pass in the trace\n";
+        std::cerr << "  --emit-bc <file>  Write the lowered module as binary IR\n";
+        std::cerr << "  --load-bc <file>  Load a lowered module instead of compiling\n";
+        std::cerr << "  --threads <n>     Threads for per-function passes, or batch workers\n";
+        std::cerr << "                    (default: all cores)\n";
+        std::cerr << "  --batch <input>   Compile every .dsl in a directory, or every path\n";
+        std::cerr << "                    listed in a file; one trace per input goes to\n";
+        std::cerr << "                    the --trace directory (default: traces)\n";
+        std::cerr << "  --server <socket> Serve compile requests on a Unix socket\n";
+        std::cerr << "  --connect <socket> Compile through a running server\n";
+        std::cerr << "  --cache-dir <dir> Reuse pass results cached in <dir>\n";
+        std::cerr << "  --time-passes     Print time, hardware and heap counters per pass\n";
+        std::cerr << "  --autotune        Search tiles, fusion and unroll factors per kernel\n";
+        std::cerr << "  --tuning-db <file> Tuning results to reuse and extend\n";
+        std::cerr << "                    (default: tuning_db.json)\n";
+        std::cerr << "  --precision <t>   Lower f32 compute and activations to f16 or bf16\n";
+        std::cerr << "  --keep-f32 <name> Keep an op or tensor in f32 (repeatable)\n";
+        std::cerr << "  --half-accumulate Accumulate matmul and softmax in the lower type\n";
+        exit(1);
+    }
+    
     return options;
 }
 
 // Simple DSL parser (mock implementation)
-std::vector<std::shared_ptr<IRNode>> parseDSL(const std::string& filename) {
-    std::vector<std::shared_ptr<IRNode>> nodes;
-    
+void parseDSL(const std::string& filename, IRModule& module) {
     // For demonstration, create a simple matmul operation
     if (filename.find("matmul.dsl") != std::string::npos) {
-        auto tensorA = createTensor("A", {1024, 512}, "f32");
-        auto tensorB = createTensor("B", {512, 256}, "f32");
-        auto tensorC = createTensor("C", {1024, 256}, "f32");
+        auto* tensorA = createTensor(module, "A", {1024, 512}, "f32");
+        auto* tensorB = createTensor(module, "B", {512, 256}, "f32");
+        auto* tensorC = createTensor(module, "C", {1024, 256}, "f32");
         
-        auto matmul = createMatmul("matmul_op", tensorA, tensorB);
+        auto* matmul = createMatmul(module, "matmul_op", tensorA, tensorB);
         matmul->addOutput(tensorC);
         
-        nodes.push_back(tensorA);
-        nodes.push_back(tensorB);
-        nodes.push_back(tensorC);
-        nodes.push_back(matmul);
+        module.append(tensorA);
+        module.append(tensorB);
+        module.append(tensorC);
+        module.append(matmul);
+    } else if (filename.find("transformer.dsl") != std::string::npos) {
+        // One attention head over [batch, seq_len, hidden]; the result
+        // types of the ops are left to shape inference
+        auto* input = createTensor(module, "input", {32, 512, 768}, "f32");
+        auto* wq = createTensor(module, "Wq", {768, 768}, "f32");
+        auto* wk = createTensor(module, "Wk", {768, 768}, "f32");
+        auto* wv = createTensor(module, "Wv", {768, 768}, "f32");
+        auto* q = createTensor(module, "Q", {32, 512, 768}, "f32");
+        auto* k = createTensor(module, "K", {32, 512, 768}, "f32");
+        auto* v = createTensor(module, "V", {32, 512, 768}, "f32");
+        auto* scores = createTensor(module, "scores", {32, 512, 512}, "f32");
+        auto* attention = createTensor(module, "attention", {32, 512, 512}, "f32");
+        auto* output = createTensor(module, "output", {32, 512, 768}, "f32");
+        for (IRNode* tensor : {input, wq, wk, wv, q, k, v, scores, attention, output}) {
+            module.append(tensor);
+        }
+        
+        auto compute = [&](OpType type, const std::string& name,
+                           std::initializer_list<const IRNode*> operands, IRNode* result) {
+            IRNode* node = module.createNode(type, name);
+            for (const IRNode* operand : operands) {
+                node->addInput(operand);
+            }
+            if (result) {
+                node->addOutput(result);
+            }
+            module.append(node);
+            return node;
+        };
+        IRNode* qProj = compute(OpType::MATMUL, "q_proj", {input, wq}, q);
+        IRNode* kProj = compute(OpType::MATMUL, "k_proj", {input, wk}, k);
+        IRNode* vProj = compute(OpType::MATMUL, "v_proj", {input, wv}, v);
+        IRNode* kT = compute(OpType::TRANSPOSE, "k_t", {kProj}, nullptr);
+        IRNode* qk = compute(OpType::MATMUL, "qk", {qProj, kT}, scores);
+        IRNode* factor = createConstant(module, "inv_sqrt_d", 0.125f);
+        module.append(factor);
+        IRNode* scaled = compute(OpType::SCALE, "scaled", {qk, factor}, scores);
+        IRNode* probs = compute(OpType::SOFTMAX, "probs", {scaled}, attention);
+        compute(OpType::MATMUL, "attn_out", {probs, vProj}, output);
+    }
+}
+
+// Types are checked and constants folded first, then cleanup leaves later
+// passes and memory planning only live, distinct ops. With --precision,
+// compute is lowered next so layouts and tiles are chosen for the final
+// element types. Layouts are fixed before tiling, since a transposed
+// operand changes what a tile costs. With a database, kernels are then
+// autotuned and the later passes follow the attributes it sets.
+void addPipeline(PassManager& passManager, const CLIOptions& options,
+                 TuningDatabase* tuningDb, size_t tuneThreads) {
+    passManager.addPass(createShapeInferencePass());
+    passManager.addPass(createConstantFoldingPass());
+    passManager.addPass(createCSEPass());
+    passManager.addPass(createDCEPass());
+    if (!options.precision.empty()) {
+        PrecisionPolicy policy;
+        policy.target = parseDataType(options.precision);
+        policy.f32Accumulate = !options.halfAccumulate;
+        policy.pinned.insert(options.keepF32.begin(), options.keepF32.end());
+        passManager.addPass(createMixedPrecisionPass(policy));
+    }
+    passManager.addPass(createLayoutAssignmentPass());
+    if (tuningDb) {
+        passManager.addPass(createAutotunePass(*tuningDb, DeviceInfo(), CostModelParams(),
+                                               tuneThreads));
+    }
+    passManager.addPass(createLoopUnrollingPass(4));
+    passManager.addPass(createTensorFusionPass());
+    passManager.addPass(createLoopTilingPass());
+    passManager.addPass(createMemoryMapPass());
+}
+
+std::unique_ptr<TuningDatabase> openTuningDatabase(const CLIOptions& options) {
+    if (!options.autotune) {
+        return nullptr;
+    }
+    return std::make_unique<TuningDatabase>(
+        options.tuningDb, describeTuningTarget(DeviceInfo(), CostModelParams()));
+}
+
+void saveTuningDatabase(const TuningDatabase& tuningDb) {
+    if (tuningDb.save()) {
+        std::cout << "Tuning database: " << tuningDb.size() << " entries written to "
+                  << tuningDb.getPath() << "\n";
+    } else {
+        std::cerr << "Warning: cannot write tuning database " << tuningDb.getPath() << "\n";
+    }
+}
+
+// Launches of the planned matmul kernels, the memory the plan places and
+// the estimated cost, for the compiled body and each function
+std::string simulationReport(const IRModule& module) {
+    std::ostringstream report;
+    uint64_t memoryBytes = 0;
+    auto addUnit = [&](const IRModule& unit) {
+        uint64_t unitBytes = 0;
+        for (ValueId id : unit.getBody()) {
+            const IRNode* node = unit.getNode(id);
+            MatmulLaunch launch;
+            if (node->getType() == OpType::MATMUL && getMatmulLaunch(*node, launch)) {
+                report << "Kernel launch: " << formatLaunch(launch) << " (" << node->getName()
+                       << ", " << launch.sharedBytes << " bytes shared)\n";
+            } else if (node->getType() == OpType::ALLOC && node->hasAttribute("memory_offset")) {
+                unitBytes = std::max<uint64_t>(
+                    unitBytes, node->getAttribute<int64_t>("memory_offset") +
+                                   node->getAttribute<int64_t>("memory_size"));
+            }
+        }
+        memoryBytes += unitBytes;
+    };
+    addUnit(module);
+    for (const auto& function : module.getFunctions()) {
+        addUnit(*function);
+    }
+    report << std::fixed << std::setprecision(2);
+    report << "Memory allocated: " << memoryBytes / double(1 << 20) << "MB\n";
+    report << "Estimated cost: " << std::setprecision(0) << estimateModuleCost(module)
+           << " cycles\n";
+    return report.str();
+}
+
+// A pipeline and context kept warm across every input one thread
+// compiles, so passes are built and common names interned only once
+struct CompileWorker {
+    IRContext context;
+    PassManager passManager;
+};
+
+std::vector<std::unique_ptr<CompileWorker>> createWorkers(const CLIOptions& options,
+                                                          size_t numWorkers,
+                                                          TuningDatabase* tuningDb) {
+    std::vector<std::unique_ptr<CompileWorker>> workers;
+    for (size_t w = 0; w < numWorkers; ++w) {
+        auto worker = std::make_unique<CompileWorker>();
+        // Inputs are already spread over the workers
+        worker->passManager.setNumThreads(1);
+        // As for a single input, the IR is traced only with --debug
+        worker->passManager.setCaptureIR(options.debug && options.traceIR);
+        worker->passManager.setCompileCache(options.cacheDir);
+        addPipeline(worker->passManager, options, tuningDb, 1);
+        workers.push_back(std::move(worker));
+    }
+    return workers;
+}
+
+size_t defaultWorkers(const CLIOptions& options) {
+    return options.numThreads ? options.numThreads
+                              : std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Compiles many inputs on a fixed number of workers
+int runBatch(const CLIOptions& options) {
+    namespace fs = std::filesystem;
+    using Clock = std::chrono::steady_clock;
+    
+    std::vector<std::string> inputs;
+    try {
+        inputs = collectBatchInputs(options.batch);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    if (inputs.empty()) {
+        std::cerr << "Error: no inputs in " << options.batch << "\n";
+        return 1;
     }
     
-    return nodes;
+    // --trace names a directory here; its file default makes no sense
+    fs::path traceDir = options.outputTrace == "trace.json" ? "traces" : options.outputTrace;
+    std::error_code error;
+    fs::create_directories(traceDir, error);
+    if (error) {
+        std::cerr << "Error: cannot create " << traceDir << ": " << error.message() << "\n";
+        return 1;
+    }
+    std::vector<std::string> traceNames = batchTraceNames(inputs);
+    
+    size_t numWorkers = std::min(defaultWorkers(options), inputs.size());
+    std::unique_ptr<TuningDatabase> tuningDb = openTuningDatabase(options);
+    std::vector<std::unique_ptr<CompileWorker>> workers =
+        createWorkers(options, numWorkers, tuningDb.get());
+    
+    std::vector<double> latencyMs(inputs.size(), 0.0);
+    std::vector<std::string> errors(inputs.size());
+    std::atomic<size_t> next{0};
+    
+    auto runWorker = [&](size_t w) {
+        CompileWorker& worker = *workers[w];
+        for (size_t i = next++; i < inputs.size(); i = next++) {
+            auto start = Clock::now();
+            try {
+                if (!fs::exists(inputs[i])) {
+                    throw std::runtime_error("no such file");
+                }
+                IRModule module(worker.context);
+                parseDSL(inputs[i], module);
+                worker.passManager.resetDebugInfo();
+                worker.passManager.runPasses(module);
+            } catch (const std::exception& e) {
+                errors[i] = e.what();
+            }
+            latencyMs[i] = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            if (errors[i].empty()) {
+                worker.passManager.getDebugInfo().exportTrace((traceDir / traceNames[i]).string());
+            }
+        }
+    };
+    
+    auto batchStart = Clock::now();
+    ThreadPool pool(numWorkers);
+    pool.parallelFor(numWorkers, runWorker);
+    double wallSeconds = std::chrono::duration<double>(Clock::now() - batchStart).count();
+    
+    size_t failures = 0;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        if (!errors[i].empty()) {
+            std::cerr << "Error: " << inputs[i] << ": " << errors[i] << "\n";
+            ++failures;
+        }
+    }
+    
+    // Percentiles over every input, failed ones included
+    std::vector<double> sorted = latencyMs;
+    std::sort(sorted.begin(), sorted.end());
+    
+    std::cout << "=== Batch Summary ===\n";
+    std::cout << "Files:      " << inputs.size() << " (" << failures << " failed)\n";
+    std::cout << "Workers:    " << numWorkers << "\n";
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Wall time:  " << wallSeconds * 1000.0 << " ms\n";
+    std::cout << "Throughput: " << inputs.size() / wallSeconds << " files/sec\n";
+    std::cout << "Latency:    p50 " << nearestRankPercentile(sorted, 50) << " ms, p99 "
+              << nearestRankPercentile(sorted, 99) << " ms\n";
+    std::cout << "Traces written to: " << traceDir.string() << "\n";
+    if (tuningDb) {
+        saveTuningDatabase(*tuningDb);
+    }
+    return failures ? 1 : 0;
+}
+
+// Handles one server request:
+//   {"input": name, "source": text, "emit_ir", "debug", "trace_ir",
+//    "simulate_gpu": bools}
+// streaming back "ir" messages (the input and the IR after each pass),
+// then "trace", "simulation" and "result" as requested. The mock parser
+// only looks at the input name; the source is carried for a real one.
+void compileRequest(CompileWorker& worker, const Json::Value& request,
+                    const CompileServer::Reply& reply) {
+    using Clock = std::chrono::steady_clock;
+    const std::string input = request["input"].asString();
+    const bool emitIR = request["emit_ir"].asBool();
+    const bool traceIR = request["debug"].asBool() && request["trace_ir"].asBool();
+    
+    auto start = Clock::now();
+    IRModule module(worker.context);
+    parseDSL(input, module);
+    
+    auto sendIR = [&](const std::string& stage, const std::string& ir) {
+        Json::Value message;
+        message["type"] = "ir";
+        message["stage"] = stage;
+        message["ir"] = ir;
+        reply(message);
+    };
+    if (emitIR) {
+        sendIR("Input", module.toString());
+    }
+    
+    PassManager& passManager = worker.passManager;
+    passManager.resetDebugInfo();
+    passManager.setCaptureIR(emitIR || traceIR);
+    passManager.runPasses(module);
+    double compileMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    
+    const DebugInfo& debugInfo = passManager.getDebugInfo();
+    if (emitIR) {
+        for (const PassTrace& trace : debugInfo.getPassTraces()) {
+            sendIR("After " + trace.passName, trace.irAfter);
+        }
+    }
+    if (request["debug"].asBool()) {
+        Json::Value trace = debugInfo.toJson();
+        if (!traceIR) {
+            // Captured only for --emit-ir
+            for (Json::Value& pass : trace["passes"]) {
+                pass.removeMember("ir_after");
+            }
+        }
+        Json::Value message;
+        message["type"] = "trace";
+        message["trace"] = trace;
+        reply(message);
+    }
+    if (request["simulate_gpu"].asBool()) {
+        Json::Value message;
+        message["type"] = "simulation";
+        message["report"] = simulationReport(module);
+        reply(message);
+    }
+    Json::Value result;
+    result["type"] = "result";
+    result["compile_time_ms"] = compileMs;
+    reply(result);
+}
+
+CompileServer* activeServer = nullptr;
+
+extern "C" void stopActiveServer(int) {
+    if (activeServer) {
+        activeServer->stop();
+    }
+}
+
+// Keeps one warm worker per server thread until SIGINT or SIGTERM
+int runServer(const CLIOptions& options) {
+    size_t numWorkers = defaultWorkers(options);
+    std::unique_ptr<TuningDatabase> tuningDb = openTuningDatabase(options);
+    std::vector<std::unique_ptr<CompileWorker>> workers =
+        createWorkers(options, numWorkers, tuningDb.get());
+    std::vector<CompileWorker*> idle;
+    for (auto& worker : workers) {
+        idle.push_back(worker.get());
+    }
+    std::mutex idleMutex;
+    std::condition_variable idleCv;
+    
+    CompileServer server(options.server, numWorkers,
+                         [&](const Json::Value& request, const CompileServer::Reply& reply) {
+        CompileWorker* worker;
+        {
+            std::unique_lock<std::mutex> lock(idleMutex);
+            idleCv.wait(lock, [&] { return !idle.empty(); });
+            worker = idle.back();
+            idle.pop_back();
+        }
+        try {
+            compileRequest(*worker, request, reply);
+            // Saved as it grows, so a killed server loses nothing
+            if (tuningDb) {
+                tuningDb->save();
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(idleMutex);
+            idle.push_back(worker);
+            idleCv.notify_one();
+            throw;
+        }
+        std::lock_guard<std::mutex> lock(idleMutex);
+        idle.push_back(worker);
+        idleCv.notify_one();
+    });
+    
+    try {
+        server.listen();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    activeServer = &server;
+    std::signal(SIGINT, stopActiveServer);
+    std::signal(SIGTERM, stopActiveServer);
+    std::cout << "Listening on " << options.server << " with " << numWorkers
+              << " workers\n" << std::flush;
+    server.serve();
+    activeServer = nullptr;
+    std::cout << "Server stopped\n";
+    return 0;
+}
+
+// Thin client: sends the input to a server and prints what comes back
+// the way a local compile would
+int runClient(const CLIOptions& options) {
+    std::ifstream file(options.inputFile);
+    if (!file) {
+        std::cerr << "Error: cannot read " << options.inputFile << "\n";
+        return 1;
+    }
+    std::ostringstream source;
+    source << file.rdbuf();
+    
+    Json::Value request;
+    request["input"] = options.inputFile;
+    request["source"] = source.str();
+    request["emit_ir"] = options.emitIR;
+    request["debug"] = options.debug;
+    request["trace_ir"] = options.traceIR;
+    request["simulate_gpu"] = options.simulateGPU;
+    
+    std::cout << "Processing: " << options.inputFile << " via " << options.connect << "\n\n";
+    bool failed = false;
+    try {
+        sendCompileRequest(options.connect, request, [&](const Json::Value& message) {
+            const std::string type = message["type"].asString();
+            if (type == "ir") {
+                std::cout << "\n=== " << message["stage"].asString() << " ===\n"
+                          << message["ir"].asString() << "\n";
+            } else if (type == "trace") {
+                Json::Value root;
+                root["trace"] = message["trace"];
+                Json::StreamWriterBuilder builder;
+                builder["indentation"] = "  ";
+                std::ofstream out(options.outputTrace);
+                out << Json::writeString(builder, root);
+                std::cout << "Debug trace written to: " << options.outputTrace << "\n";
+            } else if (type == "simulation") {
+                std::cout << "\n=== GPU Simulation ===\n" << message["report"].asString();
+            } else if (type == "result") {
+                std::cout << "Server compile time: " << message["compile_time_ms"].asDouble()
+                          << " ms\n";
+            } else if (type == "error") {
+                std::cerr << "Error: " << message["message"].asString() << "\n";
+                failed = true;
+            }
+        });
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return failed ? 1 : 0;
 }
 
 int main(int argc, char* argv[]) {
     auto options = parseArgs(argc, argv);
     
     std::cout << "Compiler-Sim-GPU v1.0.0\n";
-    std::cout << "Processing: " << options.inputFile << "\n\n";
-    
-    // Parse input DSL
-    auto irNodes = parseDSL(options.inputFile);
+    if (!options.batch.empty()) {
+        return runBatch(options);
+    }
+    if (!options.server.empty()) {
+        return runServer(options);
+    }
+    if (!options.connect.empty()) {
+        return runClient(options);
+    }
     
-    // Create pass manager
+    IRModule module;
     PassManager passManager(options.emitIR, options.debug);
+    passManager.setCaptureIR(options.debug && options.traceIR);
+    passManager.setNumThreads(options.numThreads);
+    passManager.setCompileCache(options.cacheDir);
+    const PassProfiler* profiler = nullptr;
+    if (options.timePasses) {
+        auto instrumentation = std::make_unique<PassProfiler>();
+        profiler = instrumentation.get();
+        passManager.addInstrumentation(std::move(instrumentation));
+    }
     
-    // Register passes
-    passManager.addPass(createLoopUnrollingPass(4));
-    passManager.addPass(createTensorFusionPass());
-    passManager.addPass(createMemoryMapPass());
+    if (!options.loadBytecode.empty()) {
+        // Bytecode holds an already lowered module, so the pipeline is skipped
+        std::cout << "Loading: " << options.loadBytecode << "\n\n";
+        try {
+            readModule(BytecodeReader(options.loadBytecode), module);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            return 1;
+        }
+    } else {
+        std::cout << "Processing: " << options.inputFile << "\n\n";
+        
+        // Parse input DSL
+        parseDSL(options.inputFile, module);
+        
+        // Register passes
+        std::unique_ptr<TuningDatabase> tuningDb = openTuningDatabase(options);
+        addPipeline(passManager, options, tuningDb.get(), options.numThreads);
+        
+        // Run compilation pipeline
+        passManager.runPasses(module);
+        if (tuningDb) {
+            saveTuningDatabase(*tuningDb);
+        }
+        
+        if (profiler) {
+            std::cout << "=== Pass Timing ===\n";
+            if (!profiler->hasHardwareCounters()) {
+                std::cout << "Hardware counters unavailable: "
+                          << profiler->getUnavailableReason() << "\n";
+            }
+            printPassTimings(passManager.getDebugInfo(), std::cout);
+            std::cout << "\n";
+        }
+    }
     
-    // Run compilation pipeline
-    passManager.runPasses(irNodes);
+    if (!options.emitBytecode.empty()) {
+        writeBytecodeFile(module, options.emitBytecode);
+        std::cout << "Bytecode written to: " << options.emitBytecode << "\n";
+    }
     
     // Export debug trace
     if (options.debug) {
@@ -99,10 +647,7 @@ int main(int argc, char* argv[]) {
     // GPU simulation
     if (options.simulateGPU) {
         std::cout << "\n=== GPU Simulation ===\n";
-        // Mock GPU simulation would go here
-        std::cout << "Kernel launch: matmul_kernel<<<(32,32), (32,32)>>>\n";
-        std::cout << "Memory allocated: 6MB\n";
-        std::cout << "Estimated execution time: 2.3ms\n";
+        std::cout << simulationReport(module);
     }
     
     return 0;
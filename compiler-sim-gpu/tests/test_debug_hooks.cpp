@@ -1,8 +1,15 @@
 #include <iostream>
 #include <cassert>
 #include <fstream>
+#include "compiler_sim/BatchCompile.h"
 #include "compiler_sim/DebugInfo.h"
 #include "compiler_sim/IRNode.h"
+#include "compiler_sim/IRModule.h"
+#include "compiler_sim/PassManager.h"
+#include "compiler_sim/PassProfiler.h"
+#include <sstream>
+#include <filesystem>
+#include <unistd.h>
 
 using namespace compiler_sim;
 
@@ -40,11 +47,14 @@ void testPassTracing() {
     debug.endPass("IR after TestPass");
     
     // Export and verify
-    debug.exportTrace("test_trace.json");
+    std::string path = (std::filesystem::temp_directory_path() /
+                        ("compiler-sim-trace-test-" + std::to_string(::getpid()) + ".json")).string();
+    debug.exportTrace(path);
     
-    std::ifstream file("test_trace.json");
+    std::ifstream file(path);
     assert(file.good());
     file.close();
+    std::filesystem::remove(path);
     
     std::cout << "✓ Pass tracing test passed\n";
 }
@@ -66,6 +76,157 @@ void testMemoryMapping() {
     std::cout << "✓ Memory mapping test passed\n";
 }
 
+void testIRCapture() {
+    std::cout << "Testing per-pass IR capture...\n";
+    
+    auto runPipeline = [](bool capture) {
+        IRModule module;
+        module.append(createTensor(module, "A", {128, 64}));
+        
+        PassManager pm;
+        pm.setCaptureIR(capture);
+        pm.addPass(createMemoryMapPass());
+        pm.runPasses(module);
+        return pm.getDebugInfo().toJson();
+    };
+    
+    // Off by default: the trace carries no IR text
+    auto plain = runPipeline(false);
+    assert(plain["passes"].size() == 1);
+    assert(!plain["passes"][0].isMember("ir_after"));
+    
+    // Requested: the IR after the pass is recorded
+    auto traced = runPipeline(true);
+    std::string ir = traced["passes"][0]["ir_after"].asString();
+    assert(ir.find("%A = alloc") != std::string::npos);
+    assert(ir.find("memory_offset = 0") != std::string::npos);
+    
+    std::cout << "✓ Per-pass IR capture test passed\n";
+}
+
+// Logs hook calls as "<tag>:before:<pass>" and "<tag>:after:<pass>"
+class RecordingInstrumentation : public PassInstrumentation {
+public:
+    RecordingInstrumentation(std::string tag, std::vector<std::string>& log)
+        : tag_(std::move(tag)), log_(log) {}
+    
+    void beforePass(const Pass& pass, const IRModule&) override {
+        log_.push_back(tag_ + ":before:" + pass.getName());
+    }
+    
+    void afterPass(const Pass& pass, const IRModule&, DebugInfo& debugInfo) override {
+        // The pass's trace is complete by now
+        assert(debugInfo.getPassTraces().back().passName == pass.getName());
+        log_.push_back(tag_ + ":after:" + pass.getName());
+    }
+    
+private:
+    std::string tag_;
+    std::vector<std::string>& log_;
+};
+
+void testPassInstrumentation() {
+    std::cout << "Testing pass instrumentation...\n";
+    
+    // Hooks nest: later instrumentations run inside earlier ones
+    {
+        IRModule module;
+        module.append(createTensor(module, "A", {128, 64}));
+        
+        std::vector<std::string> log;
+        PassManager pm;
+        pm.addInstrumentation(std::make_unique<RecordingInstrumentation>("outer", log));
+        pm.addInstrumentation(std::make_unique<RecordingInstrumentation>("inner", log));
+        pm.addPass(createTensorFusionPass());
+        pm.addPass(createMemoryMapPass());
+        pm.runPasses(module);
+        
+        std::vector<std::string> expected = {
+            "outer:before:TensorFusionPass", "inner:before:TensorFusionPass",
+            "inner:after:TensorFusionPass", "outer:after:TensorFusionPass",
+            "outer:before:MemoryMapPass", "inner:before:MemoryMapPass",
+            "inner:after:MemoryMapPass", "outer:after:MemoryMapPass",
+        };
+        assert(log == expected);
+    }
+    
+    // The profiler's counters land in the trace whether or not perf works
+    IRModule module;
+    for (int i = 0; i < 64; i++) {
+        module.append(createTensor(module, "t" + std::to_string(i), {128, 64}));
+    }
+    auto profiler = std::make_unique<PassProfiler>();
+    bool hardware = profiler->hasHardwareCounters();
+    assert(hardware || !profiler->getUnavailableReason().empty());
+    
+    PassManager pm;
+    pm.addInstrumentation(std::move(profiler));
+    pm.addPass(createMemoryMapPass());
+    pm.runPasses(module);
+    
+    auto json = pm.getDebugInfo().toJson();
+    const Json::Value& counters = json["passes"][0]["counters"];
+    assert(counters["allocations"].asUInt64() > 0);
+    assert(counters["bytes_allocated"].asUInt64() > 0);
+    assert(counters.isMember("peak_heap_bytes"));
+    assert(counters.isMember("cycles") == hardware);
+    
+    std::ostringstream table;
+    printPassTimings(pm.getDebugInfo(), table);
+    assert(table.str().find("MemoryMapPass") != std::string::npos);
+    assert(table.str().find("Total") != std::string::npos);
+    
+    std::cout << "✓ Pass instrumentation test passed\n";
+}
+
+void testBatchHelpers() {
+    std::cout << "Testing batch helpers...\n";
+    
+    namespace fs = std::filesystem;
+    fs::path dir = fs::temp_directory_path() /
+                   ("compiler-sim-batch-test-" + std::to_string(::getpid()));
+    fs::remove_all(dir);
+    fs::create_directories(dir / "nested");
+    for (const char* name : {"mlp.dsl", "attn.dsl", "notes.txt", "nested/deep.dsl"}) {
+        std::ofstream(dir / name) << "matmul\n";
+    }
+    
+    // A directory gives its own .dsl files in name order
+    std::vector<std::string> inputs = collectBatchInputs(dir.string());
+    assert(inputs.size() == 2);
+    assert(inputs[0] == (dir / "attn.dsl").string());
+    assert(inputs[1] == (dir / "mlp.dsl").string());
+    
+    // A list keeps its order and skips blank and comment lines
+    fs::path list = dir / "inputs.txt";
+    std::ofstream(list) << "# models\n  b/attn.dsl \r\n\n\ta/attn.dsl\nmlp.dsl\n";
+    inputs = collectBatchInputs(list.string());
+    assert(inputs == std::vector<std::string>({"b/attn.dsl", "a/attn.dsl", "mlp.dsl"}));
+    
+    bool threw = false;
+    try {
+        collectBatchInputs((dir / "missing.txt").string());
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    fs::remove_all(dir);
+    
+    // Repeated stems are told apart by position
+    std::vector<std::string> names = batchTraceNames(inputs);
+    assert(names == std::vector<std::string>(
+                        {"attn.0.trace.json", "attn.1.trace.json", "mlp.trace.json"}));
+    
+    std::vector<double> latencies = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    assert(nearestRankPercentile(latencies, 50) == 5);
+    assert(nearestRankPercentile(latencies, 99) == 10);
+    assert(nearestRankPercentile(latencies, 0) == 1);
+    assert(nearestRankPercentile({4.5}, 99) == 4.5);
+    assert(nearestRankPercentile({}, 50) == 0);
+    
+    std::cout << "✓ Batch helpers test passed\n";
+}
+
 int main(int argc, char* argv[]) {
     if (argc > 1 && std::string(argv[1]) == "--test-debug") {
         std::cout << "Running debug hook tests...\n\n";
@@ -73,6 +234,9 @@ int main(int argc, char* argv[]) {
         testSymbolTable();
         testPassTracing();
         testMemoryMapping();
+        testIRCapture();
+        testPassInstrumentation();
+        testBatchHelpers();
         
         std::cout << "\nAll debug hook tests passed! ✓\n";
     }
@@ -1,24 +1,31 @@
 #include <iostream>
 #include <cassert>
+#include <cmath>
 #include "compiler_sim/IRNode.h"
+#include "compiler_sim/IRModule.h"
+#include "compiler_sim/IRBytecode.h"
 #include "compiler_sim/PassManager.h"
+#include <functional>
 
 using namespace compiler_sim;
 
 void testBasicIRCreation() {
     std::cout << "Testing basic IR creation...\n";
     
-    auto tensorA = createTensor("A", {512, 512}, "f32");
+    IRModule module;
+    auto* tensorA = createTensor(module, "A", {512, 512}, "f32");
     assert(tensorA->getName() == "A");
     assert(tensorA->getType() == OpType::ALLOC);
-    assert(tensorA->getAttribute<std::vector<int>>("shape")[0] == 512);
+    assert(tensorA->getTensorType()->getShape()[0] == 512);
     
-    auto tensorB = createTensor("B", {512, 512}, "f32");
-    auto matmul = createMatmul("matmul_op", tensorA, tensorB);
+    auto* tensorB = createTensor(module, "B", {512, 512}, "f32");
+    auto* matmul = createMatmul(module, "matmul_op", tensorA, tensorB);
     
     assert(matmul->getInputs().size() == 2);
-    assert(matmul->getInputs()[0] == tensorA);
-    assert(matmul->getInputs()[1] == tensorB);
+    assert(matmul->getInputs()[0] == tensorA->getId());
+    assert(matmul->getInputs()[1] == tensorB->getId());
+    assert(matmul->getInput(0) == tensorA);
+    assert(matmul->getInput(1) == tensorB);
     
     std::cout << "✓ Basic IR creation test passed\n";
 }
@@ -26,12 +33,15 @@ void testBasicIRCreation() {
 void testIRCloning() {
     std::cout << "Testing IR cloning...\n";
     
-    auto original = createTensor("original", {1024, 768}, "f16");
+    IRModule module;
+    auto* original = createTensor(module, "original", {1024, 768}, "f16");
     original->setAttribute("custom_attr", 42);
     original->setDebugLocation(10, 5);
     
-    auto cloned = original->clone();
+    auto* cloned = original->clone();
     
+    assert(cloned != original);
+    assert(cloned->getId() != original->getId());
     assert(cloned->getName() == original->getName());
     assert(cloned->getType() == original->getType());
     assert(cloned->getAttribute<int>("custom_attr") == 42);
@@ -43,28 +53,697 @@ void testIRCloning() {
 void testPassManager() {
     std::cout << "Testing pass manager...\n";
     
-    std::vector<std::shared_ptr<IRNode>> nodes;
-    nodes.push_back(createTensor("A", {1024, 512}));
-    nodes.push_back(createTensor("B", {512, 256}));
+    IRModule module;
+    auto* tensorA = createTensor(module, "A", {1024, 512});
+    auto* tensorB = createTensor(module, "B", {512, 256});
+    module.append(tensorA);
+    module.append(tensorB);
     
     PassManager pm(false, false);
     pm.addPass(createMemoryMapPass());
     
-    size_t originalSize = nodes.size();
-    pm.runPasses(nodes);
+    size_t originalSize = module.getBody().size();
+    pm.runPasses(module);
+    assert(module.getBody().size() == originalSize);
     
     // Verify memory offsets were added
-    assert(nodes[0]->hasAttribute("memory_offset"));
-    assert(nodes[1]->hasAttribute("memory_offset"));
+    assert(tensorA->hasAttribute("memory_offset"));
+    assert(tensorB->hasAttribute("memory_offset"));
     
     // Verify offsets are different
-    int offset1 = nodes[0]->getAttribute<int>("memory_offset");
-    int offset2 = nodes[1]->getAttribute<int>("memory_offset");
+    int64_t offset1 = tensorA->getAttribute<int64_t>("memory_offset");
+    int64_t offset2 = tensorB->getAttribute<int64_t>("memory_offset");
     assert(offset1 != offset2);
     
     std::cout << "✓ Pass manager test passed\n";
 }
 
+void testArenaStorage() {
+    std::cout << "Testing arena storage...\n";
+    
+    IRModule module;
+    
+    // Span several slabs so slab growth is exercised
+    const int count = 3 * IRModule::kSlabSize + 7;
+    std::vector<IRNode*> created;
+    for (int i = 0; i < count; i++) {
+        created.push_back(createTensor(module, "t" + std::to_string(i), {i + 1}));
+    }
+    assert(module.getNumNodes() == static_cast<size_t>(count));
+    
+    // Ids are dense and nodes never move after allocation
+    for (int i = 0; i < count; i++) {
+        assert(created[i]->getId() == static_cast<ValueId>(i));
+        assert(module.getNode(i) == created[i]);
+        assert(created[i]->getName() == "t" + std::to_string(i));
+    }
+    
+    // Nodes within a slab are laid out contiguously
+    assert(created[1] == created[0] + 1);
+    
+    auto* matmul = createMatmul(module, "mm", created[0], created[count - 1]);
+    assert(matmul->getInput(1)->getName() == "t" + std::to_string(count - 1));
+    
+    std::cout << "✓ Arena storage test passed\n";
+}
+
+void testAttributeStorage() {
+    std::cout << "Testing attribute storage...\n";
+    
+    IRContext context;
+    IRModule moduleA(context);
+    IRModule moduleB(context);
+    
+    // Keys are interned once per context and shared between modules
+    AttrKey shapeKey = context.getAttrKey("shape");
+    assert(context.getAttrKey("shape") == shapeKey);
+    assert(context.lookupAttrKey("not_interned") == kInvalidAttrKey);
+    
+    auto* a = moduleA.createNode(OpType::BLOCK, "A");
+    auto* b = moduleB.createNode(OpType::BLOCK, "B");
+    a->setAttribute(shapeKey, std::vector<int>{64, 32});
+    b->setAttribute("shape", std::vector<int>{16});
+    a->setAttribute("dtype", std::string("f32"));
+    a->setAttribute("size", 2048);
+    assert(a->hasAttribute(shapeKey));
+    assert(b->getAttribute<std::vector<int>>(shapeKey)[0] == 16);
+    
+    // Reference accessor hands out the stored vector without copying
+    const auto& shape = a->getAttribute<std::vector<int>>(shapeKey);
+    assert(&shape == &a->getAttribute<std::vector<int>>("shape"));
+    assert(shape.size() == 2 && shape[1] == 32);
+    
+    // Overwriting keeps a single entry; extra keys spill past inline storage
+    a->setAttribute("custom", 1);
+    a->setAttribute("custom", 2);
+    a->setAttribute("extra_0", 3);
+    a->setAttribute("extra_1", 4.5f);
+    assert(a->getAttribute<int>("custom") == 2);
+    assert(a->getAttribute<float>("extra_1") == 4.5f);
+    assert(a->getAttributes().size() == 6);
+    
+    // Entries stay sorted by key so lookups can stop early
+    const auto& attrs = a->getAttributes();
+    for (size_t i = 1; i < attrs.size(); i++) {
+        assert(attrs[i - 1].key < attrs[i].key);
+    }
+    
+    // Unknown keys are reported rather than silently interned
+    bool threw = false;
+    try {
+        a->getAttribute<int>("missing");
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    assert(context.lookupAttrKey("missing") == kInvalidAttrKey);
+    
+    std::cout << "✓ Attribute storage test passed\n";
+}
+
+void testTensorTypes() {
+    std::cout << "Testing tensor types...\n";
+    
+    IRContext context;
+    IRModule module(context);
+    
+    // Identical shape/dtype/layout yields the same uniqued type
+    auto* a = createTensor(module, "A", {1024, 512}, "f32");
+    auto* b = createTensor(module, "B", {1024, 512}, "f32");
+    auto* c = createTensor(module, "C", {1024, 512}, "f16");
+    assert(a->getTensorType() == b->getTensorType());
+    assert(a->getTensorType() != c->getTensorType());
+    assert(context.getTensorType({1024, 512}, DataType::F32, Layout::COL_MAJOR) !=
+           a->getTensorType());
+    
+    assert(a->getTensorType()->getNumElements() == 1024 * 512);
+    assert(a->getTensorType()->getByteSize() == 1024 * 512 * 4);
+    assert(c->getTensorType()->getByteSize() == 1024 * 512 * 2);
+    
+    // Large activations no longer overflow 32-bit element counts
+    auto* big = createTensor(module, "big", {256, 4096, 8192}, "f32");
+    assert(big->getTensorType()->getNumElements() == 256LL * 4096 * 8192);
+    assert(big->getTensorType()->getByteSize() == 256ULL * 4096 * 8192 * 4);
+    
+    // Matmul derives its result type, including batched operands
+    auto* input = createTensor(module, "input", {32, 512, 768});
+    auto* weight = createTensor(module, "Wq", {768, 256});
+    auto* q = createMatmul(module, "Q", input, weight);
+    assert(q->getTensorType() == context.getTensorType({32, 512, 256}, DataType::F32));
+    assert(q->toString().find("tensor<32x512x256xf32>") != std::string::npos);
+    
+    // Control nodes carry no tensor type
+    assert(module.createNode(OpType::LOOP, "loop")->getTensorType() == nullptr);
+    
+    bool threw = false;
+    try {
+        createTensor(module, "bad", {4}, "f8");
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+    
+    std::cout << "✓ Tensor types test passed\n";
+}
+
+void testUseDefChains() {
+    std::cout << "Testing use-def chains...\n";
+    
+    IRModule module;
+    auto* a = createTensor(module, "A", {64, 64});
+    auto* b = createTensor(module, "B", {64, 64});
+    auto* c = createTensor(module, "C", {64, 64});
+    auto* matmul = createMatmul(module, "mm", a, b);
+    matmul->addOutput(c);
+    auto* add = module.createNode(OpType::ADD, "add");
+    add->addInput(matmul).addInput(a);
+    for (IRNode* node : {a, b, c, matmul, add}) {
+        module.append(node);
+    }
+    
+    // Inputs and outputs both count as uses
+    assert(a->getUsers().size() == 2);
+    assert(b->hasOneUse() && b->getUsers()[0] == matmul->getId());
+    assert(c->hasOneUse() && c->getUsers()[0] == matmul->getId());
+    assert(matmul->hasOneUse() && add->useEmpty());
+    
+    // Rewiring a single operand moves exactly one use
+    add->setInput(1, b->getId());
+    assert(a->hasOneUse());
+    assert(b->getUsers().size() == 2);
+    
+    // replaceAllUsesWith redirects every use to the replacement
+    auto* other = createMatmul(module, "mm2", b, a);
+    matmul->replaceAllUsesWith(other);
+    assert(matmul->useEmpty());
+    assert(add->getInputs()[0] == other->getId());
+    assert(other->hasOneUse() && other->getUsers()[0] == add->getId());
+    
+    // Values with remaining uses cannot be erased
+    bool threw = false;
+    try {
+        b->erase();
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw && !b->isErased());
+    
+    // Erasing drops the node's own uses; compact removes it from the body
+    matmul->erase();
+    assert(matmul->isErased());
+    assert(a->hasOneUse() && c->useEmpty());
+    module.compact();
+    assert(module.getBody().size() == 4);
+    for (ValueId id : module.getBody()) {
+        assert(id != matmul->getId());
+    }
+    
+    // Clones register their own uses
+    auto* cloned = add->clone();
+    assert(other->getUsers().size() == 2);
+    assert(b->getUsers().size() == 3);
+    (void)cloned;
+    
+    std::cout << "✓ Use-def chains test passed\n";
+}
+
+void testBytecodeRoundTrip() {
+    std::cout << "Testing bytecode round trip...\n";
+    
+    IRModule module;
+    auto* a = createTensor(module, "A", {128, 64});
+    auto* b = createTensor(module, "B", {64, 32}, "f16");
+    auto* c = createTensor(module, "C", {128, 32});
+    auto* matmul = createMatmul(module, "mm", a, b);
+    matmul->addOutput(c);
+    matmul->setAttribute("tile", std::vector<int>{16, 16});
+    matmul->setAttribute("scale", 0.5f);
+    matmul->setAttribute("memory_offset", int64_t(1) << 40);
+    matmul->setAttribute("fused_ops", std::string("matmul_add"));
+    matmul->setDebugLocation(3, 7);
+    auto* dead = createTensor(module, "dead", {4});
+    for (IRNode* node : {a, b, dead, c, matmul}) {
+        module.append(node);
+    }
+    dead->erase();
+    
+    std::vector<char> data = writeBytecode(module);
+    BytecodeReader reader(data.data(), data.size());
+    assert(reader.getVersion() == bc::kVersion);
+    assert(reader.getNumNodes() == 4);
+    
+    // Records can be inspected without materializing the module
+    const bc::NodeRecord& record = reader.getNodeRecord(3);
+    assert(reader.getString(record.name) == "mm");
+    assert(reader.getInputs(record).size == 2);
+    
+    IRModule loaded;
+    readModule(reader, loaded);
+    module.compact();
+    assert(loaded.toString() == module.toString());
+    
+    IRNode* mm = loaded.getNode(loaded.getBody()[3]);
+    assert(mm->getAttribute<int64_t>("memory_offset") == int64_t(1) << 40);
+    assert(mm->getAttribute<float>("scale") == 0.5f);
+    assert(mm->getInput(1)->getTensorType()->getDataType() == DataType::F16);
+    assert(mm->getInput(0)->hasOneUse() && mm->getOutput(0)->hasOneUse());
+    
+    // Malformed input is rejected up front
+    std::vector<char> corrupt = data;
+    corrupt[0] = 'X';
+    bool threw = false;
+    try {
+        BytecodeReader bad(corrupt.data(), corrupt.size());
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    
+    threw = false;
+    try {
+        BytecodeReader bad(data.data(), data.size() - 8);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    
+    std::cout << "✓ Bytecode round trip test passed\n";
+}
+
+void testDeepClone() {
+    std::cout << "Testing deep clone...\n";
+    
+    IRModule module;
+    auto* a = createTensor(module, "A", {32, 16});
+    auto* b = createTensor(module, "B", {16, 8});
+    auto* mm = createMatmul(module, "mm", a, b);
+    mm->setAttribute("tile", std::vector<int>{8, 8});
+    // a is reached along two paths but must be cloned once
+    auto* add = module.createNode(OpType::ADD, "add");
+    add->addInput(mm).addInput(a);
+    for (IRNode* node : {a, b, mm, add}) {
+        module.append(node);
+    }
+    
+    // Cloning a root pulls in its whole operand graph
+    IRModule dest;
+    IRMapping mapping;
+    IRNode* addClone = add->cloneInto(dest, mapping);
+    assert(dest.getNumNodes() == 4 && mapping.size() == 4);
+    IRNode* mmClone = addClone->getInput(0);
+    assert(mmClone->getName() == "mm");
+    assert(mmClone->getInput(0) == addClone->getInput(1));
+    assert(mmClone->getInput(0)->getUsers().size() == 2);
+    assert(mmClone->getAttribute<std::vector<int>>("tile")[1] == 8);
+    assert(mmClone->getTensorType()->toString() == "tensor<32x8xf32>");
+    
+    // Already mapped values are reused rather than cloned again
+    assert(mm->cloneInto(dest, mapping) == mmClone);
+    assert(dest.getNumNodes() == 4);
+    
+    // The clone is independent of the original
+    mmClone->setAttribute("tile", std::vector<int>{4, 4});
+    assert(mm->getAttribute<std::vector<int>>("tile")[0] == 8);
+    assert(a->getUsers().size() == 2);
+    
+    // Whole-module clone within the same context
+    IRModule copy(module.getContext());
+    IRMapping copyMapping;
+    module.cloneInto(copy, copyMapping);
+    assert(copy.toString() == module.toString());
+    
+    // Same-module clone with remapped operands
+    IRMapping remap;
+    remap.map(a->getId(), b->getId());
+    IRNode* addCopy = add->clone(remap);
+    assert(addCopy->getInputs()[0] == mm->getId());
+    assert(addCopy->getInputs()[1] == b->getId());
+    assert(remap.lookup(add->getId()) == addCopy->getId());
+    
+    std::cout << "✓ Deep clone test passed\n";
+}
+
+void testModuleSnapshot() {
+    std::cout << "Testing module snapshots...\n";
+    
+    IRModule module;
+    std::vector<IRNode*> nodes;
+    for (int i = 0; i < 300; ++i) {
+        nodes.push_back(createTensor(module, "t" + std::to_string(i), {64}));
+        module.append(nodes.back());
+    }
+    auto* add = module.createNode(OpType::ADD, "add");
+    add->addInput(nodes[0]).addInput(nodes[1]);
+    module.append(add);
+    std::string before = module.toString();
+    
+    auto snapshot = module.snapshot();
+    assert(snapshot->getNumSavedNodes() == 0);
+    
+    // Only one snapshot may be active at a time
+    bool threw = false;
+    try {
+        module.snapshot();
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    
+    // Modify, rewire, erase and create nodes
+    nodes[5]->setAttribute("memory_offset", int64_t(256));
+    auto* mul = module.createNode(OpType::MUL, "mul");
+    mul->addInput(nodes[0]).addInput(nodes[2]);
+    add->replaceAllUsesWith(mul);
+    add->erase();
+    module.append(mul);
+    module.compact();
+    assert(module.toString() != before);
+    
+    // Only the touched nodes were copied
+    assert(snapshot->getNumSavedNodes() == 5);
+    
+    module.restore(*snapshot);
+    assert(!snapshot->isActive());
+    assert(module.toString() == before);
+    assert(module.getNumNodes() == 301);
+    assert(!add->isErased());
+    assert(nodes[0]->hasOneUse() && nodes[2]->useEmpty());
+    assert(!nodes[5]->hasAttribute("memory_offset"));
+    
+    // Dropping a snapshot keeps the current state
+    {
+        auto committed = module.snapshot();
+        nodes[7]->setAttribute("memory_offset", int64_t(512));
+    }
+    assert(nodes[7]->hasAttribute("memory_offset"));
+    module.snapshot();
+    
+    std::cout << "✓ Module snapshot test passed\n";
+}
+
+void testNameInterning() {
+    std::cout << "Testing interned node names...\n";
+    
+    IRModule module;
+    IRContext& context = module.getContext();
+    auto* a = createTensor(module, "x", {8});
+    auto* b = createTensor(module, "x", {8});
+    // Same string, same handle
+    assert(a->getNameId() == b->getNameId());
+    assert(a->getNameId() == context.lookupIdentifier("x"));
+    assert(context.lookupIdentifier("never_used") == kInvalidNameId);
+    
+    // Derived nodes reuse a handle without building strings
+    size_t numIdentifiers = context.getNumIdentifiers();
+    auto* c = module.createNode(OpType::ADD, a->getNameId());
+    c->addInput(a).addInput(b);
+    // An existing node already owns "x_2", so the printer skips it
+    auto* d = createTensor(module, "x_2", {8});
+    auto* e = module.createNode(OpType::MUL, a->getNameId());
+    e->addInput(c).addInput(d);
+    assert(context.getNumIdentifiers() == numIdentifiers + 1);
+    for (IRNode* node : {a, b, c, d, e}) {
+        module.append(node);
+    }
+    
+    // Names are made unique only when the module is printed
+    std::string ir = module.toString();
+    assert(ir.find("%x = alloc") != std::string::npos);
+    assert(ir.find("%x_1 = alloc") != std::string::npos);
+    assert(ir.find("%x_3 = add(%x, %x_1)") != std::string::npos);
+    assert(ir.find("%x_2 = alloc") != std::string::npos);
+    assert(ir.find("%x_4 = mul(%x_3, %x_2)") != std::string::npos);
+    
+    // A standalone node prints its interned name
+    assert(c->toString().rfind("%x = add(%x, %x)", 0) == 0);
+    
+    std::cout << "✓ Interned node names test passed\n";
+}
+
+void testModuleFunctions() {
+    std::cout << "Testing module functions...\n";
+    
+    IRModule module;
+    module.append(createTensor(module, "global", {8}));
+    for (const char* name : {"layer0", "layer1"}) {
+        IRModule& function = module.addFunction(name);
+        auto* a = createTensor(function, "A", {16, 8});
+        auto* b = createTensor(function, "B", {8, 4});
+        function.append(a);
+        function.append(b);
+        function.append(createMatmul(function, "mm", a, b));
+    }
+    
+    // Functions share the context but not node storage
+    IRModule* layer1 = module.getFunction("layer1");
+    assert(layer1 && layer1->getParent() == &module);
+    assert(&layer1->getContext() == &module.getContext());
+    assert(layer1->getNumNodes() == 3 && module.getNumNodes() == 1);
+    assert(!module.getFunction("layer2"));
+    
+    bool threw = false;
+    try {
+        module.addFunction("layer0");
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    
+    std::string text = module.toString();
+    assert(text.find("func @layer0 {") != std::string::npos);
+    assert(text.find("func @layer1 {") < text.size());
+    
+    // Functions survive a bytecode round trip
+    std::vector<char> data = writeBytecode(module);
+    BytecodeReader reader(data.data(), data.size());
+    assert(reader.getNumFunctions() == 3);
+    IRModule loaded;
+    readModule(reader, loaded);
+    assert(loaded.getFunctions().size() == 2);
+    assert(loaded.toString() == text);
+    
+    std::cout << "✓ Module functions test passed\n";
+}
+
+void testShapeInference() {
+    std::cout << "Testing shape inference...\n";
+    
+    // Attention scores: a batched matmul against a transpose, scaled and
+    // normalized, written to an output declared without a type
+    IRModule module;
+    auto* q = createTensor(module, "Q", {8, 128, 64});
+    auto* k = createTensor(module, "K", {8, 128, 64});
+    auto* w = createTensor(module, "W", {64, 32});
+    auto* bias = createTensor(module, "bias", {32});
+    auto* probsOut = module.createNode(OpType::ALLOC, "probs_out");
+    auto* kT = module.createNode(OpType::TRANSPOSE, "k_t");
+    kT->addInput(k);
+    auto* scores = module.createNode(OpType::MATMUL, "scores");
+    scores->addInput(q).addInput(kT);
+    auto* factor = createConstant(module, "factor", 0.125f);
+    auto* scaled = module.createNode(OpType::SCALE, "scaled");
+    scaled->addInput(scores).addInput(factor);
+    auto* probs = module.createNode(OpType::SOFTMAX, "probs");
+    probs->addInput(scaled).addOutput(probsOut);
+    // A 3-D by 2-D matmul broadcasts the weights over the batch, and the
+    // bias over the rows; a stale hand-written type is replaced
+    auto* proj = module.createNode(OpType::MATMUL, "proj");
+    proj->addInput(q).addInput(w);
+    proj->setTensorType(module.getContext().getTensorType({128, 32}, DataType::F32));
+    auto* biased = module.createNode(OpType::ADD, "biased");
+    biased->addInput(proj).addInput(bias);
+    for (IRNode* node : {q, k, w, bias, probsOut, kT, scores, factor, scaled, probs, proj, biased}) {
+        module.append(node);
+    }
+    
+    PassManager pm;
+    pm.addPass(createShapeInferencePass());
+    pm.runPasses(module);
+    
+    auto shapeOf = [](const IRNode* node) { return node->getTensorType()->getShape(); };
+    assert(shapeOf(kT) == std::vector<int64_t>({8, 64, 128}));
+    assert(shapeOf(scores) == std::vector<int64_t>({8, 128, 128}));
+    assert(scaled->getTensorType() == scores->getTensorType());
+    assert(probs->getTensorType() == scores->getTensorType());
+    assert(probsOut->getTensorType() == scores->getTensorType());
+    assert(shapeOf(proj) == std::vector<int64_t>({8, 128, 32}));
+    assert(biased->getTensorType() == proj->getTensorType());
+    assert(module.toString().find("%probs_out = alloc : tensor<8x128x128xf32>") !=
+           std::string::npos);
+    
+    // Contracting dimensions must agree, and outputs must match what is
+    // written to them
+    auto fails = [](const std::function<void(IRModule&)>& build) {
+        IRModule bad;
+        build(bad);
+        PassManager badPm;
+        badPm.addPass(createShapeInferencePass());
+        try {
+            badPm.runPasses(bad);
+        } catch (const std::runtime_error&) {
+            return true;
+        }
+        return false;
+    };
+    assert(fails([](IRModule& bad) {
+        auto* a = createTensor(bad, "a", {4, 8});
+        auto* b = createTensor(bad, "b", {4, 8});
+        bad.append(a);
+        bad.append(b);
+        bad.append(createMatmul(bad, "mm", a, b));
+    }));
+    assert(fails([](IRModule& bad) {
+        auto* a = createTensor(bad, "a", {4, 8});
+        auto* b = createTensor(bad, "b", {8, 2});
+        auto* c = createTensor(bad, "c", {4, 8});
+        auto* mm = createMatmul(bad, "mm", a, b);
+        mm->addOutput(c);
+        for (IRNode* node : {a, b, c, mm}) {
+            bad.append(node);
+        }
+    }));
+    assert(fails([](IRModule& bad) {
+        auto* a = createTensor(bad, "a", {3, 4});
+        auto* b = createTensor(bad, "b", {5, 4});
+        auto* sum = bad.createNode(OpType::ADD, "sum");
+        sum->addInput(a).addInput(b);
+        for (IRNode* node : {a, b, sum}) {
+            bad.append(node);
+        }
+    }));
+    
+    std::cout << "✓ Shape inference test passed\n";
+}
+
+void testConstantFolding() {
+    std::cout << "Testing constant folding...\n";
+    
+    IRModule module;
+    auto* x = createTensor(module, "x", {16, 32});
+    // (2 + 3) * 0.5 folds to 2.5
+    auto* two = createConstant(module, "two", 2.0f);
+    auto* three = createConstant(module, "three", 3.0f);
+    auto* half = createConstant(module, "half", 0.5f);
+    auto* sum = module.createNode(OpType::ADD, "sum");
+    sum->addInput(two).addInput(three);
+    sum->setTensorType(two->getTensorType());
+    auto* product = module.createNode(OpType::MUL, "product");
+    product->addInput(sum).addInput(half);
+    product->setTensorType(two->getTensorType());
+    // scale(scale(x, 2.5), 0.5) becomes one scale by 1.25
+    auto* first = createScale(module, "first", x, product);
+    auto* second = createScale(module, "second", first, half);
+    // Two swaps of the last dimensions cancel
+    auto* t1 = createTranspose(module, "t1", second);
+    auto* t2 = createTranspose(module, "t2", t1);
+    auto* out = createSoftmax(module, "out", t2);
+    for (IRNode* node : {x, two, three, half, sum, product, first, second, t1, t2, out}) {
+        module.append(node);
+    }
+    
+    PassManager pm;
+    pm.addPass(createConstantFoldingPass());
+    pm.runPasses(module);
+    
+    // The softmax reads one scale of x by a folded constant
+    IRNode* scale = out->getInput(0);
+    assert(scale->getType() == OpType::SCALE);
+    assert(scale->getInput(0) == x);
+    IRNode* factor = scale->getInput(1);
+    assert(factor->getType() == OpType::CONSTANT);
+    assert(factor->getAttribute<float>("value") == 1.25f);
+    assert(factor->getName() == "second_factor");
+    assert(t1->isErased() && t2->isErased() && first->isErased());
+    
+    // An inner scale or transpose that writes a tensor still writes it
+    IRModule written;
+    auto* wx = createTensor(written, "X", {16, 32});
+    auto* wt = createTensor(written, "T", {16, 32});
+    auto* wu = createTensor(written, "U", {16, 32});
+    auto* wv = createTensor(written, "V", {32, 16});
+    auto* wtwo = createConstant(written, "two", 2.0f);
+    auto* wthree = createConstant(written, "three", 3.0f);
+    auto* s1 = createScale(written, "s1", wx, wtwo);
+    s1->addOutput(wt);
+    auto* s2 = createScale(written, "s2", s1, wthree);
+    s2->addOutput(wu);
+    auto* w1 = createTranspose(written, "w1", wx);
+    w1->addOutput(wv);
+    auto* w2 = createTranspose(written, "w2", w1);
+    auto* wuse = createSoftmax(written, "use", w2);
+    for (IRNode* node : {wx, wt, wu, wv, wtwo, wthree, s1, s2, w1, w2, wuse}) {
+        written.append(node);
+    }
+    PassManager writtenPm;
+    writtenPm.addPass(createConstantFoldingPass());
+    writtenPm.runPasses(written);
+    assert(!s1->isErased() && s1->getOutputs()[0] == wt->getId());
+    assert(!w1->isErased() && w1->getOutputs()[0] == wv->getId());
+    assert(wuse->getInput(0) == wx);
+    const IRNode* folded = nullptr;
+    for (ValueId id : written.getBody()) {
+        const IRNode* node = written.getNode(id);
+        if (node->getType() == OpType::SCALE && node->getInput(0) == wx && node != s1) {
+            folded = node;
+        }
+    }
+    assert(folded && folded->getOutputs()[0] == wu->getId());
+    assert(folded->getInput(1)->getAttribute<float>("value") == 6.0f);
+    
+    // Transposes that do not cancel compose into one
+    IRModule cube;
+    auto* y = createTensor(cube, "y", {2, 3, 4});
+    auto* r1 = createTranspose(cube, "r1", y, {1, 2, 0});
+    auto* r2 = createTranspose(cube, "r2", r1);
+    auto* use = createSoftmax(cube, "use", r2);
+    for (IRNode* node : {y, r1, r2, use}) {
+        cube.append(node);
+    }
+    PassManager cubePm;
+    cubePm.addPass(createConstantFoldingPass());
+    cubePm.runPasses(cube);
+    IRNode* composed = use->getInput(0);
+    assert(composed->getInput(0) == y);
+    assert(composed->getAttribute<std::vector<int>>("perm") == std::vector<int>({1, 0, 2}));
+    assert(composed->getTensorType()->getShape() == std::vector<int64_t>({3, 2, 4}));
+    
+    // A folded cast rounds as the runtime cast would
+    IRModule casts;
+    auto* tenth = createConstant(casts, "tenth", 0.1f);
+    auto* large = createConstant(casts, "large", 70000.0f);
+    auto* h16 = createCast(casts, "h16", tenth, DataType::F16);
+    auto* b16 = createCast(casts, "b16", tenth, DataType::BF16);
+    auto* inf16 = createCast(casts, "inf16", large, DataType::F16);
+    // The widening cast writes W, so it stays when the pair cancels
+    auto* z = createTensor(casts, "z", {16, 32}, "f16");
+    auto* wide = createTensor(casts, "W", {16, 32});
+    auto* widen = createCast(casts, "widen", z, DataType::F32);
+    widen->addOutput(wide);
+    auto* narrow = createCast(casts, "narrow", widen, DataType::F16);
+    auto* castUse = createSoftmax(casts, "use", narrow);
+    std::vector<IRNode*> readers;
+    for (IRNode* cast : {h16, b16, inf16}) {
+        auto* reader = createSoftmax(casts, cast->getName() + "_use", cast);
+        readers.push_back(reader);
+    }
+    for (IRNode* node : {tenth, large, h16, b16, inf16, z, wide, widen, narrow, castUse}) {
+        casts.append(node);
+    }
+    for (IRNode* reader : readers) {
+        casts.append(reader);
+    }
+    PassManager castPm;
+    castPm.addPass(createConstantFoldingPass());
+    castPm.runPasses(casts);
+    assert(readers[0]->getInput(0)->getAttribute<float>("value") == 0.0999755859375f);
+    assert(readers[1]->getInput(0)->getAttribute<float>("value") == 0.10009765625f);
+    assert(std::isinf(readers[2]->getInput(0)->getAttribute<float>("value")));
+    assert(castUse->getInput(0) == z);
+    assert(!widen->isErased() && widen->getOutputs()[0] == wide->getId());
+    
+    std::cout << "✓ Constant folding test passed\n";
+}
+
 int main(int argc, char* argv[]) {
     if (argc > 1 && std::string(argv[1]) == "--test-ir") {
         std::cout << "Running IR lowering tests...\n\n";
@@ -72,6 +751,17 @@ int main(int argc, char* argv[]) {
         testBasicIRCreation();
         testIRCloning();
         testPassManager();
+        testArenaStorage();
+        testAttributeStorage();
+        testTensorTypes();
+        testUseDefChains();
+        testBytecodeRoundTrip();
+        testDeepClone();
+        testModuleSnapshot();
+        testNameInterning();
+        testModuleFunctions();
+        testShapeInference();
+        testConstantFolding();
         
         std::cout << "\nAll IR lowering tests passed! ✓\n";
     }